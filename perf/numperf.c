@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * microbenchmarks for integer parsing and generation, over a few kinds
+ * of integer commonly found in JSON: 64 bit ids, millisecond
+ * timestamps and small counters.
+ */
+
+#include <yajl/yajl_parse.h>
+#include <yajl/yajl_gen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/time.h>
+static double mygettime(void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + (now.tv_usec / 1000000.0);
+}
+#else
+#define _WIN32 1
+#include <windows.h>
+static double mygettime(void) {
+    long long tval;
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    tval = ft.dwHighDateTime;
+    tval <<=32;
+    tval |= ft.dwLowDateTime;
+    return tval / 10000000.00;
+}
+#endif
+
+#define NUM_INTEGERS 100000
+#define RUN_TIME_SECS 1
+
+/* a simple deterministic generator, so runs are comparable */
+static unsigned long long g_seed = 88172645463325252ULL;
+
+static unsigned long long
+next_random(void)
+{
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 7;
+    g_seed ^= g_seed << 17;
+    return g_seed;
+}
+
+static long long
+make_id(void)
+{
+    return (long long) (next_random() >> 1);
+}
+
+static long long
+make_timestamp(void)
+{
+    /* milliseconds, somewhere in 2001 - 2033 */
+    return 1000000000000LL + (long long) (next_random() % 1000000000000ULL);
+}
+
+static long long
+make_counter(void)
+{
+    return (long long) (next_random() % 1000);
+}
+
+static const struct {
+    const char * name;
+    long long (*make)(void);
+} kinds[] = {
+    { "ids", make_id },
+    { "timestamps", make_timestamp },
+    { "counters", make_counter },
+};
+
+static long long g_sum;
+
+static int
+on_integer(void * ctx, long long i)
+{
+    (void) ctx;
+    g_sum += i;
+    return 1;
+}
+
+static yajl_callbacks callbacks = {
+    NULL, NULL, on_integer, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+static void
+bench(const char * name, const long long * values)
+{
+    yajl_gen g;
+    const unsigned char * json;
+    size_t jsonLen;
+    double start, elapsed;
+    long long runs;
+    int i;
+
+    /* generation */
+    g = yajl_gen_alloc(NULL);
+    start = mygettime();
+    for (runs = 0; (elapsed = mygettime() - start) < RUN_TIME_SECS; runs++) {
+        yajl_gen_clear(g);
+        yajl_gen_reset(g, NULL);
+        yajl_gen_array_open(g);
+        for (i = 0; i < NUM_INTEGERS; i++) yajl_gen_integer(g, values[i]);
+        yajl_gen_array_close(g);
+    }
+    printf("%-12s generate: %6.1f ns/integer\n", name,
+           elapsed * 1e9 / ((double) runs * NUM_INTEGERS));
+
+    /* parsing, of what we just generated */
+    yajl_gen_get_buf(g, &json, &jsonLen);
+    start = mygettime();
+    for (runs = 0; (elapsed = mygettime() - start) < RUN_TIME_SECS; runs++) {
+        yajl_handle h = yajl_alloc(&callbacks, NULL, NULL);
+        if (yajl_parse(h, json, jsonLen) != yajl_status_ok ||
+            yajl_complete_parse(h) != yajl_status_ok)
+        {
+            fprintf(stderr, "parse error\n");
+            exit(1);
+        }
+        yajl_free(h);
+    }
+    printf("%-12s parse:    %6.1f ns/integer\n", name,
+           elapsed * 1e9 / ((double) runs * NUM_INTEGERS));
+
+    yajl_gen_free(g);
+}
+
+int
+main(void)
+{
+    long long * values;
+    size_t k;
+    int i;
+
+    values = (long long *) malloc(NUM_INTEGERS * sizeof(long long));
+
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        for (i = 0; i < NUM_INTEGERS; i++) {
+            values[i] = kinds[k].make();
+            if (i % 2) values[i] = -values[i];
+        }
+        bench(kinds[k].name, values);
+    }
+
+    free(values);
+    return (g_sum == 42);
+}
@@ -46,8 +46,55 @@ static double mygettime(void) {
 
 #define PARSE_TIME_SECS 3
 
+/* each document concatenated into a single buffer, for -w */
+static unsigned char ** g_whole;
+
+static void
+make_whole_documents(void)
+{
+    int i;
+
+    g_whole = (unsigned char **) malloc(num_docs() * sizeof(unsigned char *));
+    for (i = 0; i < num_docs(); i++) {
+        const char ** d;
+        size_t off = 0;
+
+        g_whole[i] = (unsigned char *) malloc(doc_size(i));
+        for (d = get_doc(i); *d; d++) {
+            memcpy(g_whole[i] + off, *d, strlen(*d));
+            off += strlen(*d);
+        }
+    }
+}
+
+/* for -s, the handle being parsed with and its nesting depth */
+static yajl_handle g_skipHand;
+static int g_skipDepth;
+
+/* skip every object and array nested in the top level one */
+static int
+skip_start(void * ctx)
+{
+    (void) ctx;
+    if (++g_skipDepth > 1) yajl_skip_value(g_skipHand);
+    return 1;
+}
+
+static int
+skip_end(void * ctx)
+{
+    (void) ctx;
+    g_skipDepth--;
+    return 1;
+}
+
+static yajl_callbacks g_skipCallbacks = {
+    NULL, NULL, NULL, NULL, NULL, NULL,
+    skip_start, NULL, skip_end, skip_start, skip_end
+};
+
 static int
-run(int validate_utf8)
+run(int validate_utf8, int whole, size_t chunk, int skip)
 {
     long long times = 0; 
     double starttime;
@@ -63,18 +110,46 @@ run(int validate_utf8)
         }
 
         for (i = 0; i < 100; i++) {
-            yajl_handle hand = yajl_alloc(NULL, NULL, NULL);
+            yajl_handle hand = yajl_alloc(skip ? &g_skipCallbacks : NULL,
+                                          NULL, NULL);
             yajl_status stat;        
             const char ** d;
 
             yajl_config(hand, yajl_dont_validate_strings, validate_utf8 ? 0 : 1);
-
-            for (d = get_doc(times % num_docs()); *d; d++) {
-                stat = yajl_parse(hand, (unsigned char *) *d, strlen(*d));
-                if (stat != yajl_status_ok) break;
+            g_skipHand = hand;
+            g_skipDepth = 0;
+
+            if (chunk) {
+                int n = times % num_docs();
+                size_t off, len = doc_size(n);
+                d = get_doc(n);
+                for (off = 0, stat = yajl_status_ok;
+                     off < len && stat == yajl_status_ok; off += chunk)
+                {
+                    stat = yajl_parse(hand, g_whole[n] + off,
+                                      len - off < chunk ? len - off : chunk);
+                }
+                if (stat == yajl_status_ok) stat = yajl_complete_parse(hand);
+                if (stat != yajl_status_ok) {
+                    fprintf(stderr, "parse error in document %d\n", n);
+                    return 1;
+                }
+            } else if (whole) {
+                int n = times % num_docs();
+                d = get_doc(n);
+                stat = yajl_parse_buffer(hand, g_whole[n], doc_size(n));
+                if (stat != yajl_status_ok) {
+                    fprintf(stderr, "parse error in document %d\n", n);
+                    return 1;
+                }
+            } else {
+                for (d = get_doc(times % num_docs()); *d; d++) {
+                    stat = yajl_parse(hand, (unsigned char *) *d, strlen(*d));
+                    if (stat != yajl_status_ok) break;
+                }
+
+                stat = yajl_complete_parse(hand);
             }
-            
-            stat = yajl_complete_parse(hand);
 
             if (stat != yajl_status_ok) {
                 unsigned char * str =
@@ -104,7 +179,13 @@ run(int validate_utf8)
         avg_doc_size /= num_docs();
 
         throughput = (times * avg_doc_size) / (now - starttime);
-        
+
+        /* per byte cost is easier to compare across chunk sizes */
+        if (chunk) {
+            printf("Chunks of %lu bytes: %.3f ns/byte\n",
+                   (unsigned long) chunk, 1e9 / throughput);
+        }
+
         while (*(units + 1) && throughput > 1024) {
             throughput /= 1024;
             units++;
@@ -117,18 +198,48 @@ run(int validate_utf8)
 }
 
 int
-main(void)
+main(int argc, char ** argv)
 {
     int rv = 0;
+    int whole = 0;
+    int skip = 0;
+    size_t chunk = 0;
+    int a;
+
+    for (a = 1; a < argc; a++) {
+        if (!strcmp(argv[a], "-w")) {
+            whole = 1;
+        } else if (!strcmp(argv[a], "-s")) {
+            skip = 1;
+        } else if (!strcmp(argv[a], "-b") && a + 1 < argc &&
+                   atoi(argv[a + 1]) > 0)
+        {
+            chunk = (size_t) atoi(argv[++a]);
+        } else {
+            break;
+        }
+    }
+
+    if (a < argc || (whole && chunk)) {
+        fprintf(stderr, "usage: %s [-s] [-w | -b <size>]\n"
+                "   -w  parse each document with a single call to "
+                "yajl_parse_buffer\n"
+                "   -b  feed each document to yajl_parse in chunks of "
+                "<size> bytes\n"
+                "   -s  skip everything nested below the top level value "
+                "with yajl_skip_value\n", argv[0]);
+        return 1;
+    }
+
+    if (whole || chunk) make_whole_documents();
 
     printf("-- speed tests determine parsing throughput given %d different sample documents --\n",
            num_docs());
 
     printf("With UTF8 validation:\n");
-    rv = run(1);
+    rv = run(1, whole, chunk, skip);
     if (rv != 0) return rv;
     printf("Without UTF8 validation:\n");
-    rv = run(0);
+    rv = run(0, whole, chunk, skip);
     return rv;
 }
-
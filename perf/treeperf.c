@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * time yajl_tree_parse() + yajl_tree_free() over the perftest documents
+ * and a few synthetic ones, with the tree allocated on the heap, in an
+ * arena, and in an arena with strings kept in the input or numbers left
+ * unconverted, and compare that with yajl_tape_parse().  then time key
+ * lookups in a large object, with and without a hash table over its keys,
+ * and yajl_parse_parallel() over newline delimited records.
+ */
+
+#include <yajl/yajl_parallel.h>
+#include <yajl/yajl_tape.h>
+#include <yajl/yajl_tree.h>
+#include <yajl/yajl_parse.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "documents.h"
+
+#ifndef WIN32
+#include <sys/time.h>
+static double mygettime(void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + (now.tv_usec / 1000000.0);
+}
+#else
+#define _WIN32 1
+#include <windows.h>
+static double mygettime(void) {
+    long long tval;
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    tval = ft.dwHighDateTime;
+    tval <<=32;
+    tval |= ft.dwLowDateTime;
+    return tval / 10000000.00;
+}
+#endif
+
+#define RUN_TIME_SECS 1
+
+/* in situ runs parse a fresh copy of the text each time, the copy is
+ * included in their time */
+static double
+run(const char * text, unsigned int options, int insitu)
+{
+    double start, elapsed;
+    long long runs;
+    char err[256];
+    size_t len = strlen(text);
+    unsigned char * copy = malloc(len);
+
+    start = mygettime();
+    for (runs = 0; (elapsed = mygettime() - start) < RUN_TIME_SECS; runs++) {
+        yajl_val v;
+
+        if (insitu) {
+            memcpy(copy, text, len);
+            v = yajl_tree_parse_insitu(copy, len, options, yajl_allow_comments,
+                                       NULL, err, sizeof(err));
+        } else {
+            v = yajl_tree_parse_options(text, options, err, sizeof(err));
+        }
+        if (v == NULL) {
+            fprintf(stderr, "parse error: %s\n", err);
+            exit(1);
+        }
+        if (insitu || (options & yajl_tree_arena)) yajl_tree_free_root(v);
+        else yajl_tree_free(v);
+    }
+    free(copy);
+
+    return elapsed * 1e6 / (double) runs;
+}
+
+static void
+bench(const char * name, const char * text)
+{
+    double heap = run(text, 0, 0);
+    double arena = run(text, yajl_tree_arena, 0);
+    double insitu = run(text, yajl_tree_arena, 1);
+
+    printf("%-16s %9lu bytes  heap: %9.1f us  arena: %9.1f us  (%.2fx)"
+           "  + in situ: %9.1f us  (%.2fx)\n",
+           name, (unsigned long) strlen(text), heap, arena, heap / arena,
+           insitu, heap / insitu);
+}
+
+/* numbers left unconverted until they're looked at, which they aren't */
+static void
+bench_lazy(const char * name, const char * text)
+{
+    double eager = run(text, yajl_tree_arena, 0);
+    double lazy = run(text, yajl_tree_arena | yajl_tree_lazy_numbers, 0);
+
+    printf("%-16s %9lu bytes  arena: %9.1f us  + lazy numbers: %9.1f us"
+           "  (%.2fx)\n",
+           name, (unsigned long) strlen(text), eager, lazy, eager / lazy);
+}
+
+/* a tape against the fastest tree */
+static void
+bench_tape(const char * name, const char * text)
+{
+    double start, elapsed;
+    long long runs;
+    char err[256];
+    size_t len = strlen(text);
+    double arena = run(text, yajl_tree_arena, 0);
+    double tape;
+
+    start = mygettime();
+    for (runs = 0; (elapsed = mygettime() - start) < RUN_TIME_SECS; runs++) {
+        yajl_tape t = yajl_tape_parse((const unsigned char *) text, len,
+                                      yajl_allow_comments, NULL,
+                                      err, sizeof(err));
+        if (t == NULL) {
+            fprintf(stderr, "parse error: %s\n", err);
+            exit(1);
+        }
+        yajl_tape_free(t);
+    }
+    tape = elapsed * 1e6 / (double) runs;
+
+    printf("%-16s %9lu bytes  arena: %9.1f us  tape: %9.1f us  (%.2fx)\n",
+           name, (unsigned long) len, arena, tape, arena / tape);
+}
+
+/* 10k small records, roughly 10 values each */
+static char *
+make_records(void)
+{
+    size_t len = 0;
+    char * text = malloc(1024 * 1024);
+    int i;
+
+    len += sprintf(text + len, "[");
+    for (i = 0; i < 10000; i++) {
+        len += sprintf(text + len,
+                       "%s{\"id\":%d,\"name\":\"user%d\",\"active\":%s,"
+                       "\"score\":%d.%02d,\"tags\":[\"a\",\"b\"],"
+                       "\"parent\":null}",
+                       i ? "," : "", i, i, (i % 3) ? "true" : "false",
+                       i % 100, i % 97);
+    }
+    sprintf(text + len, "]");
+    return text;
+}
+
+/* a flat array of 1M integers */
+static char *
+make_array(void)
+{
+    size_t len = 0;
+    char * text = malloc(8 * 1024 * 1024);
+    int i;
+
+    len += sprintf(text + len, "[");
+    for (i = 0; i < 1000000; i++)
+        len += sprintf(text + len, "%s%d", i ? "," : "", i);
+    sprintf(text + len, "]");
+    return text;
+}
+
+#define LOOKUP_KEYS 300
+
+/* ns per lookup of each of the keys of a LOOKUP_KEYS key object */
+static double
+run_lookup(const char * text, unsigned int options, int hashed)
+{
+    yajl_val obj = yajl_tree_parse_options(text, options, NULL, 0);
+    const char * path[] = { NULL, NULL };
+    unsigned int hashes[LOOKUP_KEYS];
+    char keys[LOOKUP_KEYS][16];
+    double start, elapsed;
+    long long runs, found = 0;
+    int i;
+
+    for (i = 0; i < LOOKUP_KEYS; i++) {
+        sprintf(keys[i], "field_%d", i);
+        hashes[i] = yajl_tree_key_hash(keys[i], strlen(keys[i]));
+    }
+
+    start = mygettime();
+    for (runs = 0; (elapsed = mygettime() - start) < RUN_TIME_SECS; runs++) {
+        for (i = 0; i < LOOKUP_KEYS; i++) {
+            if (hashed) {
+                found += yajl_tree_object_get(obj, keys[i], strlen(keys[i]),
+                                              hashes[i]) != NULL;
+            } else {
+                path[0] = keys[i];
+                found += yajl_tree_get(obj, path, yajl_t_any) != NULL;
+            }
+        }
+    }
+    yajl_tree_free(obj);
+
+    if (found != runs * LOOKUP_KEYS) {
+        fprintf(stderr, "lookup failed\n");
+        exit(1);
+    }
+    return elapsed * 1e9 / (double) (runs * LOOKUP_KEYS);
+}
+
+static void
+bench_lookup(void)
+{
+    char * text = malloc(LOOKUP_KEYS * 32);
+    size_t len = 0;
+    int i;
+
+    len += sprintf(text + len, "{");
+    for (i = 0; i < LOOKUP_KEYS; i++)
+        len += sprintf(text + len, "%s\"field_%d\":%d", i ? "," : "", i, i);
+    sprintf(text + len, "}");
+
+    printf("lookup in a %d key object, ns per key:\n", LOOKUP_KEYS);
+    printf("  yajl_tree_get          %9.1f\n", run_lookup(text, 0, 0));
+    printf("  yajl_tree_get, hashed  %9.1f\n",
+           run_lookup(text, yajl_tree_hash_keys, 0));
+    printf("  yajl_tree_object_get   %9.1f\n",
+           run_lookup(text, yajl_tree_hash_keys, 1));
+    free(text);
+}
+
+static int
+count_record(void * ctx, size_t offset, size_t len, yajl_val doc,
+             const char * error)
+{
+    if (doc == NULL) {
+        fprintf(stderr, "parse error: %s\n", error);
+        exit(1);
+    }
+    ++*(size_t *) ctx;
+    return 1;
+}
+
+/* MB/s parsing 200k newline delimited records, one tree each */
+static double
+run_parallel(const char * text, size_t len, unsigned int threads,
+             unsigned int options)
+{
+    double start, elapsed;
+    long long runs;
+    size_t count = 0;
+
+    start = mygettime();
+    for (runs = 0; (elapsed = mygettime() - start) < RUN_TIME_SECS; runs++) {
+        yajl_parse_parallel((const unsigned char *) text, len, threads,
+                            options, yajl_tree_arena, 0, count_record,
+                            &count);
+    }
+    return (double) len * runs / elapsed / (1024 * 1024);
+}
+
+static void
+bench_parallel(void)
+{
+    char * text = malloc(200000 * 128);
+    size_t len = 0;
+    unsigned int threads;
+    int i;
+
+    for (i = 0; i < 200000; i++) {
+        len += sprintf(text + len,
+                       "{\"id\":%d,\"name\":\"user%d\",\"active\":%s,"
+                       "\"score\":%d.%02d,\"tags\":[\"a\",\"b\"],"
+                       "\"parent\":null}\n",
+                       i, i, (i % 3) ? "true" : "false", i % 100, i % 97);
+    }
+
+    printf("200k ndjson records, MB/s:\n");
+    for (threads = 1; threads <= 8; threads *= 2) {
+        printf("  %u thread%s  ordered: %7.1f  unordered: %7.1f\n", threads,
+               threads > 1 ? "s" : " ",
+               run_parallel(text, len, threads, yajl_parallel_ordered),
+               run_parallel(text, len, threads, 0));
+    }
+    free(text);
+}
+
+int
+main(void)
+{
+    char * text;
+    int d;
+
+    for (d = 0; d < num_docs(); d++) {
+        const char ** chunk;
+        char name[32];
+        size_t len = 0;
+
+        text = malloc(doc_size(d) + 1);
+        for (chunk = get_doc(d); *chunk; chunk++) {
+            memcpy(text + len, *chunk, strlen(*chunk));
+            len += strlen(*chunk);
+        }
+        text[len] = 0;
+
+        sprintf(name, "document %d", d);
+        bench(name, text);
+        free(text);
+    }
+
+    text = make_records();
+    bench("10k records", text);
+    bench_tape("10k records", text);
+    free(text);
+
+    text = make_array();
+    bench("1M integers", text);
+    bench_lazy("1M integers", text);
+    bench_tape("1M integers", text);
+    free(text);
+
+    bench_lookup();
+    bench_parallel();
+
+    return 0;
+}
@@ -53,7 +53,11 @@ extern "C" {
         /** returned from yajl_gen_string() when the yajl_gen_validate_utf8
          *  option is enabled and an invalid was passed by client code.
          */
-        yajl_gen_invalid_string
+        yajl_gen_invalid_string,
+        /** writing to the file descriptor set with yajl_gen_output_fd
+         *  failed, errno says why.  The generator is left in its error
+         *  state. */
+        yajl_gen_write_error
     } yajl_gen_status;
 
     /** an opaque handle to a generator */
@@ -82,6 +86,10 @@ extern "C" {
          * yajl_print_t prototype while the context argument is a
          * void * of your choosing.
          *
+         * Output is collected and handed to the function in blocks of up
+         * to 64 KiB: when a block fills up, when a document is complete,
+         * and on yajl_gen_flush() and yajl_gen_free().
+         *
          * example:
          *   yajl_gen_config(g, yajl_gen_print_callback, myFunc, myVoidPtr);
          */
@@ -98,7 +106,42 @@ extern "C" {
          * iterest of saving bytes.  Setting this flag will cause YAJL to
          * always escape '/' in generated JSON strings.
          */
-        yajl_gen_escape_solidus = 0x10
+        yajl_gen_escape_solidus = 0x10,
+        /**
+         * By default yajl_gen_double() writes the shortest number that
+         * reads back as the same double (0.1 comes out as 0.1).  Set
+         * this to an int from 1 to 17 to round to that many significant
+         * digits instead, or to 0 to go back to the default.  Numbers
+         * which would round past the largest double keep the shortest
+         * form, so the output always reads back.
+         *
+         * example:
+         *   yajl_gen_config(g, yajl_gen_double_precision, 6);
+         */
+        yajl_gen_double_precision = 0x20,
+        /**
+         * Write generated json straight to a file descriptor, an int,
+         * rather than to the internal buffer or a print callback.  Output
+         * is collected in a few large buffers, which are written out
+         * together with writev() once yajl_gen_flush_threshold bytes are
+         * waiting, when a document is complete, and on yajl_gen_flush()
+         * and yajl_gen_free().  Strings of 64 KiB or more aren't copied,
+         * they're written out along with what's waiting.
+         *
+         * The descriptor should block, it's not closed by the generator.
+         * When a write fails the call that caused it returns
+         * yajl_gen_write_error, and so does yajl_gen_flush().
+         *
+         * example:
+         *   yajl_gen_config(g, yajl_gen_output_fd, STDOUT_FILENO);
+         */
+        yajl_gen_output_fd = 0x40,
+        /**
+         * How many bytes of output, an int, are collected for
+         * yajl_gen_output_fd before they're written out.  The default is
+         * 256 KiB, and no more than 960 KiB are ever collected.
+         */
+        yajl_gen_flush_threshold = 0x80
     } yajl_gen_option;
 
     /** allow the modification of generator options subsequent to handle
@@ -145,6 +188,11 @@ extern "C" {
                                               const unsigned char ** buf,
                                               size_t * len);
 
+    /** hand any output collected for the print callback over to it, or
+     *  write it to the file descriptor, see yajl_gen_print_callback and
+     *  yajl_gen_output_fd.  Otherwise there's nothing to do. */
+    YAJL_API yajl_gen_status yajl_gen_flush(yajl_gen hand);
+
     /** clear yajl's output buffer, but maintain all internal generation
      *  state.  This function will not "reset" the generator state, and is
      *  intended to enable incremental JSON outputing. */
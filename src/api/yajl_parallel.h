@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * \file yajl_parallel.h
+ *
+ * Parses a buffer holding many JSON documents, such as newline delimited
+ * JSON, on several threads at once.  Each document is parsed into a tree
+ * of its own and handed to a callback:
+ *
+ * \code
+ * static int got(void * ctx, size_t offset, size_t len, yajl_val doc,
+ *                const char * error)
+ * {
+ *     if (doc == NULL) fprintf(stderr, "at %zu: %s\n", offset, error);
+ *     else ...
+ *     return 1;
+ * }
+ *
+ * yajl_parse_parallel(text, textLen, 0, yajl_parallel_ordered, 0, 0, got,
+ *                     NULL);
+ * \endcode
+ *
+ * The buffer is cut into pieces after newlines which lie outside of any
+ * document, so a document which spans lines is kept whole.  Documents on
+ * a single line, separated by spaces, can't be split up between threads
+ * but are still parsed, and delivered, one by one.  An error in one
+ * document doesn't stop the others being parsed.
+ */
+
+#ifndef YAJL_PARALLEL_H
+#define YAJL_PARALLEL_H 1
+
+#include <yajl/yajl_common.h>
+#include <yajl/yajl_parse.h>
+#include <yajl/yajl_tree.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Options for \em yajl_parse_parallel, to be or'd together. */
+typedef enum {
+    /** Deliver the documents in the order they appear in the text.
+     *  Otherwise each is delivered as soon as it has been parsed. */
+    yajl_parallel_ordered = 0x01
+} yajl_parallel_option;
+
+/** called with each document.
+ *  \param offset  where the document starts in the text.
+ *  \param len     the length of the document's text.
+ *  \param doc     the document, or \c NULL if it didn't parse.  It's
+ *                 freed once the callback returns.
+ *  \param error   \c NULL, or a description of why the document didn't
+ *                 parse.
+ *  \returns zero to stop delivering documents.
+ */
+typedef int (*yajl_parallel_callback)(void * ctx, size_t offset, size_t len,
+                                      yajl_val doc, const char * error);
+
+/**
+ * Parse the documents in a buffer on several threads.
+ *
+ * The callback is called from the threads doing the parsing, but never
+ * from two at once, so it needn't be thread safe.  Like
+ * \em yajl_tree_parse_buf, comments aren't allowed, and here they can't
+ * be: they could hide the quotes the buffer is split by.
+ *
+ * \param text           the documents, which must stay put until this
+ *                       returns.
+ * \param len            the length of the text in bytes.
+ * \param threads        how many threads to parse on, or zero for one
+ *                       for each processor.  Without thread support
+ *                       everything happens on the calling thread.
+ * \param options        Zero or more \em yajl_parallel_option values
+ *                       or'd together.
+ * \param tree_options   Zero or more \em yajl_tree_option values or'd
+ *                       together, for each document's tree.
+ * \param parse_options  Zero or more of \c yajl_dont_validate_strings, see
+ *                       \em yajl_config.
+ * \param callback       called with each document.
+ * \param ctx            passed to the callback.
+ *
+ * \returns \c yajl_status_ok once every document has been delivered,
+ *          \c yajl_status_client_canceled if the callback stopped it, or
+ *          \c yajl_status_error if memory ran out.
+ */
+YAJL_API yajl_status yajl_parse_parallel(const unsigned char * text,
+                                         size_t len,
+                                         unsigned int threads,
+                                         unsigned int options,
+                                         unsigned int tree_options,
+                                         unsigned int parse_options,
+                                         yajl_parallel_callback callback,
+                                         void * ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* YAJL_PARALLEL_H */
@@ -37,7 +37,10 @@ extern "C" {
         yajl_status_client_canceled,
         /** An error occured during the parse.  Call yajl_get_error for
          *  more information about the encountered error */
-        yajl_status_error
+        yajl_status_error,
+        /** the parse stopped once the budget set with yajl_yield_budget
+         *  was spent, call yajl_resume to carry on */
+        yajl_status_yield
     } yajl_status;
 
     /** attain a human readable, english, string for an error */
@@ -125,7 +128,8 @@ extern "C" {
          * When set the parser will verify that all strings in JSON input are
          * valid UTF8 and will emit a parse error if this is not so.  When set,
          * this option makes parsing slightly more expensive (~7% depending
-         * on processor and compiler in use)
+         * on processor and compiler in use, and about 10% on text that is
+         * mostly multibyte characters)
          *
          * example:
          *   yajl_config(h, yajl_dont_validate_strings, 1); // disable utf8 checking
@@ -156,7 +160,23 @@ extern "C" {
          * yajl will enter an error state (premature EOF).  Setting this
          * flag suppresses that check and the corresponding error.
          */
-        yajl_allow_partial_values = 0x10
+        yajl_allow_partial_values = 0x10,
+        /**
+         * Bound the work done by a single call to yajl_parse(),
+         * yajl_parse_buffer() or yajl_resume().  Once this many bytes of
+         * the chunk have been consumed, the parser stops at the next
+         * token boundary and returns yajl_status_yield, with
+         * yajl_get_bytes_consumed() reporting how far into the chunk it
+         * got.  yajl_resume() then carries on with the rest of the same
+         * chunk, which must stay put until it's done.
+         *
+         * arguments: the budget in bytes as an int, zero (the default)
+         * for no limit.
+         *
+         * example:
+         *   yajl_config(h, yajl_yield_budget, 64 * 1024);
+         */
+        yajl_yield_budget = 0x20
     } yajl_option;
 
     /** allow the modification of parser options subsequent to handle
@@ -177,6 +197,34 @@ extern "C" {
                                     const unsigned char * jsonText,
                                     size_t jsonTextLength);
 
+    /** Parse a complete json text which is entirely in memory.  This is
+     *  equivalent to yajl_parse() followed by yajl_complete_parse(), and
+     *  calls the same callbacks.  Where the text is indented with long
+     *  runs of whitespace, yajl indexes it a block at a time so the lexer
+     *  can hop over them.  Elsewhere, judged from a sample of each 32KiB
+     *  of text, it doesn't bother, and the text is lexed just as
+     *  yajl_parse() would.
+     *
+     *  jsonText may follow earlier calls to yajl_parse(), in which case
+     *  it's taken as the last chunk of the stream.
+     *
+     *  \param hand - a handle to the json parser allocated with yajl_alloc
+     *  \param jsonText - a pointer to the UTF8 json text to be parsed
+     *  \param jsonTextLength - the length, in bytes, of input text
+     */
+    YAJL_API yajl_status yajl_parse_buffer(yajl_handle hand,
+                                           const unsigned char * jsonText,
+                                           size_t jsonTextLength);
+
+    /** Carry on with a parse which returned yajl_status_yield, from
+     *  where it stopped in the same chunk.  This may yield again, and
+     *  must be repeated until it doesn't before any other text is
+     *  parsed.  Returns yajl_status_ok if there's nothing to resume.
+     *
+     *  \param hand - a handle to the json parser allocated with yajl_alloc
+     */
+    YAJL_API yajl_status yajl_resume(yajl_handle hand);
+
     /** Parse any remaining buffered json.
      *  Since yajl is a stream-based parser, without an explicit end of
      *  input, yajl sometimes can't decide if content at the end of the
@@ -202,6 +250,48 @@ extern "C" {
                                             const unsigned char * jsonText,
                                             size_t jsonTextLength);
 
+    /** skip a value without calling back for anything inside it.  This
+     *  may be called from within a callback:
+     *
+     *   - yajl_map_key: the key's value is skipped entirely, the next
+     *     callback is for the following key or the end of the map.
+     *   - yajl_start_map or yajl_start_array: the contents of the map or
+     *     array are skipped, the next callback is its yajl_end_map or
+     *     yajl_end_array.
+     *
+     *  Called from any other callback it has no effect.
+     *
+     *  Skipped text is scanned only for quotes and brackets.  Escapes
+     *  are not decoded, numbers are not converted and strings are not
+     *  checked for valid UTF8, which makes skipping much quicker than
+     *  parsing.  In turn, a skipped value is only checked for balanced
+     *  brackets and terminated strings, so malformed JSON inside it may
+     *  go unnoticed.
+     */
+    YAJL_API void yajl_skip_value(yajl_handle hand);
+
+    /** only call back for the parts of the JSON text selected by a path.
+     *  The path is a JSON Pointer (RFC 6901), such as "/items/0/name",
+     *  where a step of "*" matches any key or array index.  Paths may be
+     *  added until parsing begins, and a value is wanted if any of them
+     *  selects it.
+     *
+     *  Once a path has been added, the callbacks describe the text cut
+     *  down to the selected values and the objects and arrays leading to
+     *  them, which is still well formed JSON.  An object or array which
+     *  a path leads into is kept even if nothing in it turns out to be
+     *  selected, so a path with a "*" may leave some empty ones behind.
+     *
+     *  Unwanted map entries and nested objects and arrays are skipped as
+     *  by yajl_skip_value(), and other unwanted values are lexed but get
+     *  no callbacks.  As with yajl_skip_value(), errors inside skipped
+     *  values may go unnoticed.
+     *
+     *  \returns zero if the path is malformed, if 64 paths were added
+     *           already, or if parsing has begun, non-zero otherwise.
+     */
+    YAJL_API int yajl_add_path_filter(yajl_handle hand, const char * path);
+
     /**
      * get the amount of data consumed from the last chunk passed to YAJL.
      *
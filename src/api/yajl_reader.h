@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * \file yajl_reader.h
+ *
+ * A pull interface to the parser.  Rather than being called back, the
+ * client asks for one event at a time with \em yajl_reader_next, which
+ * lets a deserializer be written as straight line code:
+ *
+ * \code
+ * yajl_reader r = yajl_reader_alloc(0, NULL);
+ * const unsigned char * v;
+ * size_t len;
+ * yajl_event e;
+ *
+ * yajl_reader_feed(r, text, textLen);
+ * yajl_reader_finish(r);
+ * while ((e = yajl_reader_next(r, &v, &len)) > yajl_event_error) {
+ *     ...
+ * }
+ * yajl_reader_free(r);
+ * \endcode
+ *
+ * Text may also be fed a chunk at a time, whenever \em yajl_reader_next
+ * reports \c yajl_event_need_more.
+ */
+
+#ifndef YAJL_READER_H
+#define YAJL_READER_H 1
+
+#include <yajl/yajl_common.h>
+#include <yajl/yajl_parse.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** an opaque handle to a reader */
+typedef struct yajl_reader_t * yajl_reader;
+
+/** what \em yajl_reader_next found */
+typedef enum {
+    /** all the text fed so far has been read, feed some more with
+     *  \em yajl_reader_feed or say there's no more with
+     *  \em yajl_reader_finish */
+    yajl_event_need_more = 0,
+    /** the end of the text was reached, after \em yajl_reader_finish */
+    yajl_event_end,
+    /** the text isn't valid JSON, see \em yajl_reader_get_error */
+    yajl_event_error,
+    /** the value is "null" */
+    yajl_event_null,
+    /** the value is "true" or "false" */
+    yajl_event_boolean,
+    /** the value is the number as it appears in the text */
+    yajl_event_number,
+    /** the value is the string, with escapes decoded */
+    yajl_event_string,
+    /** the value is the key, with escapes decoded */
+    yajl_event_map_key,
+    yajl_event_start_map,
+    yajl_event_end_map,
+    yajl_event_start_array,
+    yajl_event_end_array
+} yajl_event;
+
+/** allocate a reader
+ *  \param parse_options  Zero or more of the \em yajl_option values or'd
+ *                        together, see \em yajl_config.
+ *  \param afs            Memory allocation functions, or \c NULL to use
+ *                        malloc and friends.
+ */
+YAJL_API yajl_reader yajl_reader_alloc(unsigned int parse_options,
+                                       yajl_alloc_funcs * afs);
+
+/** free a reader */
+YAJL_API void yajl_reader_free(yajl_reader r);
+
+/** give the reader the next chunk of text.  The text must stay put until
+ *  \em yajl_reader_next reports \c yajl_event_need_more, and should only
+ *  be given once it has. */
+YAJL_API void yajl_reader_feed(yajl_reader r, const unsigned char * text,
+                               size_t len);
+
+/** say that all of the text has been fed */
+YAJL_API void yajl_reader_finish(yajl_reader r);
+
+/** read the next event.
+ *
+ *  For scalars and keys, \em value and \em len are set to a view of the
+ *  value, which isn't null terminated and stays valid until the next
+ *  call.  They are set to NULL and 0 for other events.
+ */
+YAJL_API yajl_event yajl_reader_next(yajl_reader r,
+                                     const unsigned char ** value,
+                                     size_t * len);
+
+/** skip over a value without reading it, as \em yajl_skip_value does:
+ *  after \c yajl_event_map_key the key's value is skipped, and after
+ *  \c yajl_event_start_map or \c yajl_event_start_array the next event
+ *  is the matching end. */
+YAJL_API void yajl_reader_skip(yajl_reader r);
+
+/** get an error string describing a \c yajl_event_error, see
+ *  \em yajl_get_error.  Free it with \em yajl_reader_free_error. */
+YAJL_API unsigned char * yajl_reader_get_error(yajl_reader r, int verbose);
+
+/** free an error returned from \em yajl_reader_get_error */
+YAJL_API void yajl_reader_free_error(yajl_reader r, unsigned char * str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* YAJL_READER_H */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * \file yajl_tape.h
+ *
+ * Parses JSON data into a compact, read only "tape".
+ *
+ * A tape is an alternative to the tree of yajl_tree.h.  The whole
+ * document lives in a single allocation: an array of 64 bit words, one
+ * or two per value in document order, followed by the text of its
+ * strings.  Objects and arrays record where they end, so a value can be
+ * skipped without looking inside it.  That makes a tape cheaper to build
+ * and quicker to walk than a tree, at the price of being read only.
+ *
+ * Values are referred to by their position on the tape, a size_t.  The
+ * root of the document is at position 0, and \c YAJL_TAPE_NONE stands for
+ * no value at all.  Within an object, keys and values alternate: a key is
+ * a string, and the position after it is its value.
+ *
+ * Iterating over an array:
+ *
+ * \code
+ * size_t v;
+ * for (v = yajl_tape_first(t, array); v != YAJL_TAPE_NONE;
+ *      v = yajl_tape_next(t, v)) { ... }
+ * \endcode
+ *
+ * and over an object:
+ *
+ * \code
+ * size_t k, v;
+ * for (k = yajl_tape_first(t, object); k != YAJL_TAPE_NONE;
+ *      k = yajl_tape_next(t, v)) {
+ *     v = yajl_tape_next(t, k);
+ *     ...
+ * }
+ * \endcode
+ */
+
+#ifndef YAJL_TAPE_H
+#define YAJL_TAPE_H 1
+
+#include <yajl/yajl_common.h>
+#include <yajl/yajl_tree.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A parsed document, see \em yajl_tape_parse */
+typedef struct yajl_tape_s * yajl_tape;
+
+/** The position of no value */
+#define YAJL_TAPE_NONE ((size_t) -1)
+
+/**
+ * Parse a buffer into a tape.
+ *
+ * \param input              Pointer to the utf8 JSON text.
+ * \param input_len          Length of the JSON text in bytes.
+ * \param parse_options      Zero or more of \c yajl_allow_comments,
+ *                           \c yajl_dont_validate_strings and
+ *                           \c yajl_allow_trailing_garbage or'd together,
+ *                           see \em yajl_config.
+ * \param afs                Memory allocation functions, or \c NULL to use
+ *                           malloc and friends.
+ * \param error_buffer       Pointer to a buffer in which an error message
+ *                           will be stored if the parse fails, or \c NULL.
+ * \param error_buffer_size  Size of the memory area pointed to by
+ *                           \em error_buffer.
+ *
+ * \returns the tape, to be freed with \em yajl_tape_free, or NULL on
+ * error.
+ */
+YAJL_API yajl_tape yajl_tape_parse(const unsigned char * input,
+                                   size_t input_len,
+                                   unsigned int parse_options,
+                                   yajl_alloc_funcs * afs,
+                                   char * error_buffer,
+                                   size_t error_buffer_size);
+
+/** Free a tape.  Passing NULL is valid and results in a no-op. */
+YAJL_API void yajl_tape_free(yajl_tape t);
+
+/** The type of the value at \em v: yajl_t_string, yajl_t_number,
+ *  yajl_t_object, yajl_t_array, yajl_t_true, yajl_t_false or
+ *  yajl_t_null. */
+YAJL_API yajl_type yajl_tape_type(yajl_tape t, size_t v);
+
+/** Get the text of a string or key, which is null terminated.  Its length
+ *  is stored in \em len unless that's NULL.  Returns NULL if \em v isn't
+ *  a string. */
+YAJL_API const char * yajl_tape_get_string(yajl_tape t, size_t v,
+                                           size_t * len);
+
+/** Non-zero if \em v is a number with neither fraction nor exponent that
+ *  fits a long long. */
+YAJL_API int yajl_tape_is_integer(yajl_tape t, size_t v);
+
+/** The value of an integer, see \em yajl_tape_is_integer.  Zero if \em v
+ *  isn't one. */
+YAJL_API long long yajl_tape_get_integer(yajl_tape t, size_t v);
+
+/** The value of a number as a double.  Zero if \em v isn't a number. */
+YAJL_API double yajl_tape_get_double(yajl_tape t, size_t v);
+
+/** The number of elements of an array or of key-value pairs of an
+ *  object, zero for anything else. */
+YAJL_API size_t yajl_tape_len(yajl_tape t, size_t v);
+
+/** The first element of an array or the first key of an object, or
+ *  \c YAJL_TAPE_NONE if it's empty or \em v isn't either. */
+YAJL_API size_t yajl_tape_first(yajl_tape t, size_t v);
+
+/** The value following \em v in its array or object, or
+ *  \c YAJL_TAPE_NONE if \em v is the last.  Objects and arrays are
+ *  skipped in one step. */
+YAJL_API size_t yajl_tape_next(yajl_tape t, size_t v);
+
+/** The value of a key in an object, found by comparing it with each key
+ *  in turn.  The key needn't be null terminated.  Returns the value of
+ *  its first occurrence, or \c YAJL_TAPE_NONE. */
+YAJL_API size_t yajl_tape_object_get(yajl_tape t, size_t obj,
+                                     const char * key, size_t len);
+
+/** The element at \em index of an array, or \c YAJL_TAPE_NONE. */
+YAJL_API size_t yajl_tape_array_get(yajl_tape t, size_t array,
+                                    size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* YAJL_TAPE_H */
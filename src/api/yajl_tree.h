@@ -96,6 +96,35 @@ struct yajl_val_s
     } u;
 };
 
+/** Options which alter how \em yajl_tree_parse_options builds the tree,
+ *  to be or'd together. */
+typedef enum {
+    /** Allocate the tree from a few large blocks of memory rather than
+     *  allocating every value, string and array separately.  Parsing is
+     *  faster, and \em yajl_tree_free_root releases the whole tree at
+     *  once.  None of its values may be passed to \em yajl_tree_free. */
+    yajl_tree_arena = 0x01,
+    /** Build a hash table over the keys of every object with at least
+     *  \c YAJL_TREE_HASH_MIN keys, so that \em yajl_tree_get and
+     *  \em yajl_tree_object_get find a key in constant time instead of
+     *  comparing it with each key in turn. */
+    yajl_tree_hash_keys = 0x02,
+    /** Keep only the text of numbers while parsing, and convert a number
+     *  to \c long \c long and \c double the first time it's looked at
+     *  through \em yajl_tree_get_integer or \em yajl_tree_get_double (or
+     *  \em yajl_tree_convert_number).  Until then, the \em i, \em d and
+     *  \em flags members of the number are zero, so the \c YAJL_IS_INTEGER
+     *  and \c YAJL_IS_DOUBLE macros, which only read them, are false.
+     *  Since converting a number changes it, such a tree shouldn't be read
+     *  from several threads at once. */
+    yajl_tree_lazy_numbers = 0x04
+} yajl_tree_option;
+
+/** Objects with fewer keys than this don't get a hash table from
+ *  \c yajl_tree_hash_keys, a linear scan is quick enough for them. */
+#define YAJL_TREE_HASH_MIN 16
+
+
 /**
  * Parse a string.
  *
@@ -121,15 +150,92 @@ struct yajl_val_s
 YAJL_API yajl_val yajl_tree_parse (const char *input,
                                    char *error_buffer, size_t error_buffer_size);
 
+/**
+ * Parse a string, with options.
+ *
+ * Like \em yajl_tree_parse, which is \em yajl_tree_parse_options with no
+ * options set.
+ *
+ * \param options  Zero or more \em yajl_tree_option values or'd together.
+ */
+YAJL_API yajl_val yajl_tree_parse_options (const char *input,
+                                           unsigned int options,
+                                           char *error_buffer,
+                                           size_t error_buffer_size);
+
+/**
+ * Parse a buffer.
+ *
+ * Like \em yajl_tree_parse_options, but the input is given by its length
+ * rather than terminated by a null, so a document can be parsed where it
+ * lies inside a larger buffer.  The input isn't modified and isn't needed
+ * once this returns.
+ *
+ * \param input          Pointer to the utf8 JSON text.
+ * \param input_len      Length of the JSON text in bytes.
+ * \param options        Zero or more \em yajl_tree_option values or'd
+ *                       together.
+ * \param parse_options  Zero or more of \c yajl_allow_comments,
+ *                       \c yajl_dont_validate_strings and
+ *                       \c yajl_allow_trailing_garbage or'd together, see
+ *                       \em yajl_config.  Unlike \em yajl_tree_parse,
+ *                       comments are only allowed when asked for.  Other
+ *                       parser options are ignored.
+ * \param afs            Memory allocation functions for the parser and the
+ *                       tree, or \c NULL to use malloc and friends.  A tree
+ *                       allocated with \em afs is released as a whole, by
+ *                       passing its root to \em yajl_tree_free_root.
+ */
+YAJL_API yajl_val yajl_tree_parse_buf (const unsigned char *input,
+                                       size_t input_len,
+                                       unsigned int options,
+                                       unsigned int parse_options,
+                                       yajl_alloc_funcs *afs,
+                                       char *error_buffer,
+                                       size_t error_buffer_size);
+
+/**
+ * Parse a buffer in place.
+ *
+ * Like \em yajl_tree_parse_buf, but rather than copying them, the tree's
+ * strings and object keys are kept in \em input, which must outlive the
+ * tree.  Each is terminated by overwriting its closing quote with a null,
+ * and escaped ones are decoded over their escaped form.  Numbers are still
+ * copied.  Whether or not the parse succeeds, \em input is left modified,
+ * and for that reason error messages don't quote it.  The tree is released
+ * by passing its root to \em yajl_tree_free_root.
+ */
+YAJL_API yajl_val yajl_tree_parse_insitu (unsigned char *input,
+                                          size_t input_len,
+                                          unsigned int options,
+                                          unsigned int parse_options,
+                                          yajl_alloc_funcs *afs,
+                                          char *error_buffer,
+                                          size_t error_buffer_size);
 
 /**
  * Free a parse tree returned by "yajl_tree_parse".
  *
+ * Trees parsed with the \c yajl_tree_arena option, with allocation
+ * functions passed to \em yajl_tree_parse_buf, or in place, are freed with
+ * \em yajl_tree_free_root instead.
+ *
  * \param v Pointer to a JSON value returned by "yajl_tree_parse". Passing NULL
  * is valid and results in a no-op.
  */
 YAJL_API void yajl_tree_free (yajl_val v);
 
+/**
+ * Free a tree parsed with the \c yajl_tree_arena option, with allocation
+ * functions passed to \em yajl_tree_parse_buf, or by
+ * \em yajl_tree_parse_insitu.  Such a tree is released as a whole, and
+ * only through its root.
+ *
+ * \param root The value returned by the parse. Passing NULL is valid and
+ * results in a no-op.
+ */
+YAJL_API void yajl_tree_free_root (yajl_val root);
+
 /**
  * Access a nested value inside a tree.
  *
@@ -139,13 +245,113 @@ YAJL_API void yajl_tree_free (yajl_val v);
  *
  * \returns a pointer to the found value, or NULL if we came up empty.
  *
- * Future Ideas:  it'd be nice to move path to a string and implement support for
- * a teeny tiny micro language here, so you can extract array elements, do things
- * like .first and .last, even .length.  Inspiration from JSONPath and css selectors?
- * No it wouldn't be fast, but that's not what this API is about.
+ * To extract array elements, or to look up the same path in many trees, use
+ * a JSON Pointer compiled by \em yajl_path_compile instead.
  */
 YAJL_API yajl_val yajl_tree_get(yajl_val parent, const char ** path, yajl_type type);
 
+/**
+ * Hash an object key, for \em yajl_tree_object_get.
+ *
+ * \param key  The key, which needn't be null terminated.
+ * \param len  Length of the key in bytes.
+ */
+YAJL_API unsigned int yajl_tree_key_hash(const char * key, size_t len);
+
+/**
+ * Look up a key in an object.
+ *
+ * Meant for hot loops, where the same keys are looked up in many objects:
+ * hash each key once with \em yajl_tree_key_hash and pass the hash here.
+ * Objects with a hash table (see \c yajl_tree_hash_keys) find the key
+ * without comparing it to the others.
+ *
+ * \param obj   The object to look in.
+ * \param key   The key, which needn't be null terminated.
+ * \param len   Length of the key in bytes.
+ * \param hash  yajl_tree_key_hash(key, len)
+ *
+ * \returns the value of the first occurence of the key, or NULL if \em obj
+ * isn't an object or doesn't have the key.
+ */
+YAJL_API yajl_val yajl_tree_object_get(yajl_val obj, const char * key,
+                                       size_t len, unsigned int hash);
+
+/** A compiled JSON Pointer, see \em yajl_path_compile */
+typedef struct yajl_path_s * yajl_path;
+
+/**
+ * Compile a JSON Pointer (RFC 6901), such as "/users/0/name".
+ *
+ * The result can be evaluated against any number of trees with
+ * \em yajl_tree_get_compiled, which then needn't allocate or parse
+ * anything.  "~0" and "~1" in a reference token stand for "~" and "/".
+ * The empty pointer refers to the whole document.
+ *
+ * \param pointer            The JSON Pointer, null terminated.
+ * \param error_buffer       Pointer to a buffer in which an error message
+ *                           will be stored if \em pointer isn't valid, or
+ *                           \c NULL.
+ * \param error_buffer_size  Size of the memory area pointed to by
+ *                           \em error_buffer.
+ *
+ * \returns the compiled path, to be freed with \em yajl_path_free, or NULL
+ * if \em pointer isn't valid or memory ran out.
+ */
+YAJL_API yajl_path yajl_path_compile(const char * pointer,
+                                     char * error_buffer,
+                                     size_t error_buffer_size);
+
+/** Free a path returned by \em yajl_path_compile.  Passing NULL is valid
+ *  and results in a no-op. */
+YAJL_API void yajl_path_free(yajl_path path);
+
+/**
+ * Access a nested value inside a tree by a compiled JSON Pointer.
+ *
+ * Like \em yajl_tree_get, except that a reference token also selects an
+ * element of an array when it's a decimal index ("0", "17", but not "01").
+ *
+ * \param parent the node the pointer is relative to.
+ * \param path the compiled pointer.
+ * \param type the yajl_type of the object you seek, or yajl_t_any if any
+ * will do.
+ *
+ * \returns a pointer to the found value, or NULL if we came up empty.
+ */
+YAJL_API yajl_val yajl_tree_get_compiled(yajl_val parent, yajl_path path,
+                                         yajl_type type);
+
+/**
+ * Convert a number parsed with \c yajl_tree_lazy_numbers, setting its
+ * \em i, \em d and \em flags members as \em yajl_tree_parse would have.
+ * Numbers whose \em flags are already set are left alone, so each is
+ * converted once.
+ *
+ * \returns \em v
+ */
+YAJL_API yajl_val yajl_tree_convert_number(yajl_val v);
+
+/**
+ * Get the integer value of a number, converting it first if it was parsed
+ * with \c yajl_tree_lazy_numbers.  The conversion is kept, the macros
+ * below see it from then on.
+ *
+ * \param v  The value.
+ * \param i  Where to store the integer, or \c NULL.
+ *
+ * \returns non-zero if \em v is a number which fits in a \c long \c long.
+ */
+YAJL_API int yajl_tree_get_integer(yajl_val v, long long * i);
+
+/**
+ * Get the double value of a number, converting it first if it was parsed
+ * with \c yajl_tree_lazy_numbers, like \em yajl_tree_get_integer.
+ *
+ * \returns non-zero if \em v is a number within the range of a \c double.
+ */
+YAJL_API int yajl_tree_get_double(yajl_val v, double * d);
+
 /* Various convenience macros to check the type of a `yajl_val` */
 #define YAJL_IS_STRING(v) (((v) != NULL) && ((v)->type == yajl_t_string))
 #define YAJL_IS_NUMBER(v) (((v) != NULL) && ((v)->type == yajl_t_number))
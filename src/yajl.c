@@ -38,6 +38,9 @@ yajl_status_to_string(yajl_status stat)
         case yajl_status_error:
             statStr = "parse error";
             break;
+        case yajl_status_yield:
+            statStr = "parse budget spent";
+            break;
     }
     return statStr;
 }
@@ -71,7 +74,15 @@ yajl_alloc(const yajl_callbacks * callbacks,
     hand->lexer = NULL; 
     hand->bytesConsumed = 0;
     hand->decodeBuf = yajl_buf_alloc(&(hand->alloc));
+    hand->decodeInPlace = 0;
     hand->flags	    = 0;
+    hand->skipRequest = 0;
+    hand->yieldRequest = 0;
+    hand->budget = 0;
+    hand->resumeText = NULL;
+    hand->resumeLen = 0;
+    hand->resumeFinish = 0;
+    hand->filter = NULL;
     yajl_bs_init(hand->stateStack, &(hand->alloc));
     yajl_bs_push(hand->stateStack, yajl_state_start);
 
@@ -94,6 +105,12 @@ yajl_config(yajl_handle h, yajl_option opt, ...)
             if (va_arg(ap, int)) h->flags |= opt;
             else h->flags &= ~opt;
             break;
+        case yajl_yield_budget: {
+            int budget = va_arg(ap, int);
+            if (budget >= 0) h->budget = (size_t) budget;
+            else rv = 0;
+            break;
+        }
         default:
             rv = 0;
     }
@@ -107,6 +124,7 @@ yajl_free(yajl_handle handle)
 {
     yajl_bs_free(handle->stateStack);
     yajl_buf_free(handle->decodeBuf);
+    if (handle->filter) yajl_filter_free(handle->filter);
     if (handle->lexer) {
         yajl_lex_free(handle->lexer);
         handle->lexer = NULL;
@@ -114,12 +132,28 @@ yajl_free(yajl_handle handle)
     YA_FREE(&(handle->alloc), handle);
 }
 
+/* run the parser over what's left of the chunk set up by yajl_parse() or
+ * yajl_parse_buffer(), forgetting it unless the budget runs out again */
+static yajl_status
+yajl_continue(yajl_handle hand)
+{
+    yajl_status status;
+
+    status = yajl_do_continue(hand, hand->resumeText, hand->resumeLen);
+    if (status == yajl_status_yield) return status;
+
+    hand->resumeText = NULL;
+    if (hand->resumeFinish) {
+        yajl_lex_index_end(hand->lexer);
+        if (status == yajl_status_ok) status = yajl_do_finish(hand);
+    }
+    return status;
+}
+
 yajl_status
 yajl_parse(yajl_handle hand, const unsigned char * jsonText,
            size_t jsonTextLen)
 {
-    yajl_status status;
-
     /* lazy allocation of the lexer */
     if (hand->lexer == NULL) {
         hand->lexer = yajl_lex_alloc(&(hand->alloc),
@@ -127,10 +161,44 @@ yajl_parse(yajl_handle hand, const unsigned char * jsonText,
                                      !(hand->flags & yajl_dont_validate_strings));
     }
 
-    status = yajl_do_parse(hand, jsonText, jsonTextLen);
-    return status;
+    /* a yielded yajl_parse_buffer() that was never resumed */
+    if (hand->resumeText && hand->resumeFinish) {
+        yajl_lex_index_end(hand->lexer);
+    }
+
+    hand->resumeText = jsonText;
+    hand->resumeLen = jsonTextLen;
+    hand->resumeFinish = 0;
+    hand->bytesConsumed = 0;
+    return yajl_continue(hand);
+}
+
+yajl_status
+yajl_parse_buffer(yajl_handle hand, const unsigned char * jsonText,
+                  size_t jsonTextLen)
+{
+    if (hand->lexer == NULL) {
+        hand->lexer = yajl_lex_alloc(&(hand->alloc),
+                                     hand->flags & yajl_allow_comments,
+                                     !(hand->flags & yajl_dont_validate_strings));
+    }
+
+    /* the index stays in place until the text has been parsed, however
+     * many times the parse yields */
+    yajl_lex_index_begin(hand->lexer, jsonText, jsonTextLen);
+    hand->resumeText = jsonText;
+    hand->resumeLen = jsonTextLen;
+    hand->resumeFinish = 1;
+    hand->bytesConsumed = 0;
+    return yajl_continue(hand);
 }
 
+yajl_status
+yajl_resume(yajl_handle hand)
+{
+    if (hand->resumeText == NULL) return yajl_status_ok;
+    return yajl_continue(hand);
+}
 
 yajl_status
 yajl_complete_parse(yajl_handle hand)
@@ -157,6 +225,34 @@ yajl_get_error(yajl_handle hand, int verbose,
     return yajl_render_error_string(hand, jsonText, jsonTextLen, verbose);
 }
 
+void
+yajl_skip_value(yajl_handle hand)
+{
+    hand->skipRequest = 1;
+}
+
+int
+yajl_add_path_filter(yajl_handle hand, const char * path)
+{
+    int created = 0;
+
+    /* the selectors can't change under a parse */
+    if (hand->lexer != NULL) return 0;
+
+    if (hand->filter == NULL) {
+        hand->filter = yajl_filter_alloc(&(hand->alloc));
+        created = 1;
+    }
+    if (!yajl_filter_add(hand->filter, path)) {
+        if (created) {
+            yajl_filter_free(hand->filter);
+            hand->filter = NULL;
+        }
+        return 0;
+    }
+    return 1;
+}
+
 size_t
 yajl_get_bytes_consumed(yajl_handle hand)
 {
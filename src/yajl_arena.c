@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "yajl_arena.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define YAJL_ARENA_MIN_BLOCK 4096
+/* blocks double in size up to this, after which they stay put so a
+ * large document wastes at most this much at the end of its last block */
+#define YAJL_ARENA_MAX_BLOCK (1024 * 1024)
+
+/* the strictest alignment we need to honor */
+typedef union {
+    void * p;
+    long long l;
+    double d;
+} yajl_arena_align;
+
+#define YAJL_ARENA_ROUND(sz) \
+    (((sz) + sizeof(yajl_arena_align) - 1) & ~(sizeof(yajl_arena_align) - 1))
+
+typedef union yajl_arena_block_t {
+    union yajl_arena_block_t * next;
+    yajl_arena_align align;
+} yajl_arena_block;
+
+struct yajl_arena_t {
+    yajl_alloc_funcs alloc;
+    yajl_arena_block * blocks;
+    /* the unused part of the current block */
+    unsigned char * pos;
+    unsigned char * end;
+    size_t nextSize;
+};
+
+yajl_arena yajl_arena_alloc(const yajl_alloc_funcs * alloc, size_t sizeHint)
+{
+    yajl_arena a = YA_MALLOC(alloc, sizeof(struct yajl_arena_t));
+    if (a == NULL) return NULL;
+    memset((void *) a, 0, sizeof(struct yajl_arena_t));
+    a->alloc = *alloc;
+    a->nextSize = YAJL_ARENA_MIN_BLOCK;
+    while (a->nextSize < sizeHint && a->nextSize < YAJL_ARENA_MAX_BLOCK)
+        a->nextSize <<= 1;
+    return a;
+}
+
+void yajl_arena_free(yajl_arena a)
+{
+    yajl_arena_block * b, * next;
+
+    if (a == NULL) return;
+    for (b = a->blocks; b != NULL; b = next) {
+        next = b->next;
+        YA_FREE(&(a->alloc), b);
+    }
+    YA_FREE(&(a->alloc), a);
+}
+
+/* start a new block with room for at least size bytes */
+static int yajl_arena_grow(yajl_arena a, size_t size)
+{
+    yajl_arena_block * b;
+    size_t blockSize = a->nextSize;
+
+    if (blockSize < size) blockSize = size;
+
+    b = YA_MALLOC(&(a->alloc), sizeof(yajl_arena_block) + blockSize);
+    if (b == NULL) return 0;
+    b->next = a->blocks;
+    a->blocks = b;
+
+    a->pos = (unsigned char *) (b + 1);
+    a->end = a->pos + blockSize;
+
+    if (a->nextSize < YAJL_ARENA_MAX_BLOCK) a->nextSize <<= 1;
+
+    return 1;
+}
+
+void * yajl_arena_malloc(yajl_arena a, size_t size)
+{
+    unsigned char * p;
+
+    size = YAJL_ARENA_ROUND(size);
+
+    if ((size_t) (a->end - a->pos) < size && !yajl_arena_grow(a, size))
+        return NULL;
+
+    p = a->pos;
+    a->pos += size;
+    return p;
+}
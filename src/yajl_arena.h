@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __YAJL_ARENA_H__
+#define __YAJL_ARENA_H__
+
+#include "api/yajl_common.h"
+#include "yajl_alloc.h"
+
+/**
+ * yajl_arena is a bump allocator.  Memory is handed out from a chain of
+ * large blocks and is only ever given back all at once, when the arena
+ * is freed.  Allocations are aligned suitably for any of the types yajl
+ * stores (pointers, long long, double).
+ */
+typedef struct yajl_arena_t * yajl_arena;
+
+/* allocate a new arena.  sizeHint is the number of bytes the caller
+ * expects to allocate, it's used to size the first block.  returns NULL
+ * if out of memory. */
+yajl_arena yajl_arena_alloc(const yajl_alloc_funcs * alloc, size_t sizeHint);
+
+/* free the arena along with everything allocated from it */
+void yajl_arena_free(yajl_arena a);
+
+/* allocate size bytes, returns NULL if out of memory */
+void * yajl_arena_malloc(yajl_arena a, size_t size);
+
+#endif
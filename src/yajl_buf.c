@@ -79,6 +79,16 @@ void yajl_buf_append(yajl_buf buf, const void * data, size_t len)
     }
 }
 
+unsigned char * yajl_buf_extend(yajl_buf buf, size_t len)
+{
+    unsigned char * p;
+    yajl_buf_ensure_available(buf, len);
+    p = buf->data + buf->used;
+    buf->used += len;
+    buf->data[buf->used] = 0;
+    return p;
+}
+
 void yajl_buf_clear(yajl_buf buf)
 {
     buf->used = 0;
@@ -100,4 +110,5 @@ yajl_buf_truncate(yajl_buf buf, size_t len)
 {
     assert(len <= buf->used);
     buf->used = len;
+    if (buf->data) buf->data[buf->used] = 0;
 }
@@ -42,6 +42,11 @@ void yajl_buf_free(yajl_buf buf);
 /* append a number of bytes to the buffer */
 void yajl_buf_append(yajl_buf buf, const void * data, size_t len);
 
+/* grow the buffer by len bytes, to be filled in by the caller, getting a
+ * pointer to the first of them.  any not wanted can be given back with
+ * yajl_buf_truncate() */
+unsigned char * yajl_buf_extend(yajl_buf buf, size_t len);
+
 /* empty the buffer */
 void yajl_buf_clear(yajl_buf buf);
 
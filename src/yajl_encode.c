@@ -15,6 +15,7 @@
  */
 
 #include "yajl_encode.h"
+#include "yajl_simd.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -28,6 +29,24 @@ static void CharToHex(unsigned char c, char * hexBuf)
     hexBuf[1] = hexchar[c & 0x0F];
 }
 
+/* what follows the backslash when escaping a control character, 'u'
+ * being the \u00XX form */
+static const char escapeControl[32] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u'
+};
+
+/* it is not required to escape a solidus in JSON:
+ * read sec. 2.5: http://www.ietf.org/rfc/rfc4627.txt
+ * specifically, this production from the grammar:
+ *   unescaped = %x20-21 / %x23-5B / %x5D-10FFFF
+ */
+#define NEEDS_ESCAPE(c)                                         \
+    ((c) < 0x20 || (c) == '"' || (c) == '\\' ||                 \
+     ((c) == '/' && escape_solidus))
+
 void
 yajl_string_encode(const yajl_print_t print,
                    void * ctx,
@@ -37,42 +56,47 @@ yajl_string_encode(const yajl_print_t print,
 {
     size_t beg = 0;
     size_t end = 0;
-    char hexBuf[7];
-    hexBuf[0] = '\\'; hexBuf[1] = 'u'; hexBuf[2] = '0'; hexBuf[3] = '0';
-    hexBuf[6] = 0;
+    char escaped[6];
+    escaped[0] = '\\';
+    escaped[2] = '0'; escaped[3] = '0';
 
     while (end < len) {
-        const char * escaped = NULL;
-        switch (str[end]) {
-            case '\r': escaped = "\\r"; break;
-            case '\n': escaped = "\\n"; break;
-            case '\\': escaped = "\\\\"; break;
-            /* it is not required to escape a solidus in JSON:
-             * read sec. 2.5: http://www.ietf.org/rfc/rfc4627.txt
-             * specifically, this production from the grammar:
-             *   unescaped = %x20-21 / %x23-5B / %x5D-10FFFF
-             */
-            case '/': if (escape_solidus) escaped = "\\/"; break;
-            case '"': escaped = "\\\""; break;
-            case '\f': escaped = "\\f"; break;
-            case '\b': escaped = "\\b"; break;
-            case '\t': escaped = "\\t"; break;
-            default:
-                if ((unsigned char) str[end] < 32) {
-                    CharToHex(str[end], hexBuf + 4);
-                    escaped = hexBuf;
-                }
-                break;
+        size_t escLen = 2;
+        size_t run;
+        unsigned char c;
+
+        /* find the next byte needing an escape a block at a time, the
+         * scan stops at quotes, backslashes and control characters.  a
+         * solidus has to be looked for separately */
+        run = yajl_simd_string_scan(str + end, len - end, 0);
+        if (escape_solidus && run > 0) {
+            const void * solidus = memchr(str + end, '/', run);
+            if (solidus != NULL) {
+                run = (size_t) ((const unsigned char *) solidus - (str + end));
+            }
         }
-        if (escaped != NULL) {
-            print(ctx, (const char *) (str + beg), end - beg);
-            print(ctx, escaped, (unsigned int)strlen(escaped));
-            beg = ++end;
+        end += run;
+
+        /* then byte by byte through whatever's left over */
+        while (end < len && !NEEDS_ESCAPE(str[end])) end++;
+        if (end == len) break;
+
+        c = str[end];
+        if (c < 0x20) {
+            escaped[1] = escapeControl[c];
+            if (escaped[1] == 'u') {
+                CharToHex(c, escaped + 4);
+                escLen = 6;
+            }
         } else {
-            ++end;
+            escaped[1] = (char) c;
         }
+
+        if (end > beg) print(ctx, (const char *) (str + beg), end - beg);
+        print(ctx, escaped, escLen);
+        beg = ++end;
     }
-    print(ctx, (const char *) (str + beg), end - beg);
+    if (end > beg) print(ctx, (const char *) (str + beg), end - beg);
 }
 
 static void hexToDigit(unsigned int * val, const unsigned char * hex)
@@ -87,134 +111,153 @@ static void hexToDigit(unsigned int * val, const unsigned char * hex)
     }
 }
 
-static void Utf32toUtf8(unsigned int codepoint, char * utf8Buf) 
+/* write a code point out as UTF8, returning how many bytes it took */
+static size_t Utf32toUtf8(unsigned int codepoint, unsigned char * utf8Buf)
 {
     if (codepoint < 0x80) {
-        utf8Buf[0] = (char) codepoint;
-        utf8Buf[1] = 0;
+        utf8Buf[0] = (unsigned char) codepoint;
+        return 1;
     } else if (codepoint < 0x0800) {
-        utf8Buf[0] = (char) ((codepoint >> 6) | 0xC0);
-        utf8Buf[1] = (char) ((codepoint & 0x3F) | 0x80);
-        utf8Buf[2] = 0;
+        utf8Buf[0] = (unsigned char) ((codepoint >> 6) | 0xC0);
+        utf8Buf[1] = (unsigned char) ((codepoint & 0x3F) | 0x80);
+        return 2;
     } else if (codepoint < 0x10000) {
-        utf8Buf[0] = (char) ((codepoint >> 12) | 0xE0);
-        utf8Buf[1] = (char) (((codepoint >> 6) & 0x3F) | 0x80);
-        utf8Buf[2] = (char) ((codepoint & 0x3F) | 0x80);
-        utf8Buf[3] = 0;
+        utf8Buf[0] = (unsigned char) ((codepoint >> 12) | 0xE0);
+        utf8Buf[1] = (unsigned char) (((codepoint >> 6) & 0x3F) | 0x80);
+        utf8Buf[2] = (unsigned char) ((codepoint & 0x3F) | 0x80);
+        return 3;
     } else if (codepoint < 0x200000) {
-        utf8Buf[0] =(char)((codepoint >> 18) | 0xF0);
-        utf8Buf[1] =(char)(((codepoint >> 12) & 0x3F) | 0x80);
-        utf8Buf[2] =(char)(((codepoint >> 6) & 0x3F) | 0x80);
-        utf8Buf[3] =(char)((codepoint & 0x3F) | 0x80);
-        utf8Buf[4] = 0;
-    } else {
-        utf8Buf[0] = '?';
-        utf8Buf[1] = 0;
+        utf8Buf[0] = (unsigned char) ((codepoint >> 18) | 0xF0);
+        utf8Buf[1] = (unsigned char) (((codepoint >> 12) & 0x3F) | 0x80);
+        utf8Buf[2] = (unsigned char) (((codepoint >> 6) & 0x3F) | 0x80);
+        utf8Buf[3] = (unsigned char) ((codepoint & 0x3F) | 0x80);
+        return 4;
     }
+    utf8Buf[0] = '?';
+    return 1;
 }
 
-void yajl_string_decode(yajl_buf buf, const unsigned char * str,
-                        size_t len)
+size_t yajl_string_decode_to(unsigned char * out, const unsigned char * str,
+                             size_t len)
 {
     size_t beg = 0;
-    size_t end = 0;    
+    size_t end = 0;
+    size_t used = 0;
 
     while (end < len) {
-        if (str[end] == '\\') {
-            char utf8Buf[5];
-            const char * unescaped = "?";
-            yajl_buf_append(buf, str + beg, end - beg);
-            switch (str[++end]) {
-                case 'r': unescaped = "\r"; break;
-                case 'n': unescaped = "\n"; break;
-                case '\\': unescaped = "\\"; break;
-                case '/': unescaped = "/"; break;
-                case '"': unescaped = "\""; break;
-                case 'f': unescaped = "\f"; break;
-                case 'b': unescaped = "\b"; break;
-                case 't': unescaped = "\t"; break;
-                case 'u': {
-                    unsigned int codepoint = 0;
-                    hexToDigit(&codepoint, str + ++end);
-                    end+=3;
-                    /* check if this is a surrogate */
-                    if ((codepoint & 0xFC00) == 0xD800) {
-                        end++;
-                        if (str[end] == '\\' && str[end + 1] == 'u') {
-                            unsigned int surrogate = 0;
-                            hexToDigit(&surrogate, str + end + 2);
-                            codepoint =
-                                (((codepoint & 0x3F) << 10) | 
-                                 ((((codepoint >> 6) & 0xF) + 1) << 16) | 
-                                 (surrogate & 0x3FF));
-                            end += 5;
-                        } else {
-                            unescaped = "?";
-                            break;
-                        }
-                    }
-                    
-                    Utf32toUtf8(codepoint, utf8Buf);
-                    unescaped = utf8Buf;
-
-                    if (codepoint == 0) {
-                        yajl_buf_append(buf, unescaped, 1);
-                        beg = ++end;
-                        continue;
-                    }
+        /* find the next backslash a block at a time.  the scan also stops
+         * at quotes and control characters, which can only turn up here
+         * escaped, so the loop after it takes care of any stragglers */
+        end += yajl_simd_string_scan(str + end, len - end, 0);
+        while (end < len && str[end] != '\\') end++;
+
+        /* in place, nothing moves until the first escape */
+        if (end > beg) {
+            if (out + used != str + beg) {
+                memmove(out + used, str + beg, end - beg);
+            }
+            used += end - beg;
+        }
+        if (end == len) break;
 
-                    break;
+        switch (str[++end]) {
+            case 'r': out[used++] = '\r'; break;
+            case 'n': out[used++] = '\n'; break;
+            case '\\': out[used++] = '\\'; break;
+            case '/': out[used++] = '/'; break;
+            case '"': out[used++] = '"'; break;
+            case 'f': out[used++] = '\f'; break;
+            case 'b': out[used++] = '\b'; break;
+            case 't': out[used++] = '\t'; break;
+            case 'u': {
+                unsigned int codepoint = 0;
+                hexToDigit(&codepoint, str + end + 1);
+                end += 4;
+                /* check if this is a surrogate */
+                if ((codepoint & 0xFC00) == 0xD800) {
+                    if (end + 6 < len &&
+                        str[end + 1] == '\\' && str[end + 2] == 'u')
+                    {
+                        unsigned int surrogate = 0;
+                        hexToDigit(&surrogate, str + end + 3);
+                        codepoint =
+                            (((codepoint & 0x3F) << 10) |
+                             ((((codepoint >> 6) & 0xF) + 1) << 16) |
+                             (surrogate & 0x3FF));
+                        end += 6;
+                    } else {
+                        out[used++] = '?';
+                        break;
+                    }
                 }
-                default:
-                    assert("this should never happen" == NULL);
+
+                used += Utf32toUtf8(codepoint, out + used);
+                break;
             }
-            yajl_buf_append(buf, unescaped, (unsigned int)strlen(unescaped));
-            beg = ++end;
-        } else {
-            end++;
+            default:
+                assert("this should never happen" == NULL);
+                out[used++] = '?';
+                break;
         }
+        beg = ++end;
     }
-    yajl_buf_append(buf, str + beg, end - beg);
+
+    return used;
 }
 
-#define ADV_PTR s++; if (!(len--)) return 0;
+void yajl_string_decode(yajl_buf buf, const unsigned char * str,
+                        size_t len)
+{
+    /* decoding never makes a string longer, so room is made for it once
+     * and what's left over given back */
+    size_t used = yajl_buf_len(buf);
+    unsigned char * out = yajl_buf_extend(buf, len);
+
+    yajl_buf_truncate(buf, used + yajl_string_decode_to(out, str, len));
+}
 
 int yajl_string_validate_utf8(const unsigned char * s, size_t len)
 {
     if (!len) return 1;
     if (!s) return 0;
-    
-    while (len--) {
-        /* single byte */
+
+    while (len) {
+        size_t n, i;
+
+        /* skip what's strictly valid a block at a time.  the scan stops
+         * at quotes, backslashes and control characters, which are fine
+         * here, and at anything it can't vouch for, which gets the more
+         * lenient check below */
+        n = yajl_simd_utf8_scan(s, len);
+        s += n;
+        len -= n;
+        if (!len) break;
+
+        /* single byte.  step over ASCII by hand for a while, rather than
+         * starting a scan at every quote */
         if (*s <= 0x7f) {
-            /* noop */
-        }
-        /* two byte */ 
-        else if ((*s >> 5) == 0x6) {
-            ADV_PTR;
-            if (!((*s >> 6) == 0x2)) return 0;
+            size_t stop = len < YAJL_SIMD_BLOCK ? len : YAJL_SIMD_BLOCK;
+            for (n = 1; n < stop && s[n] <= 0x7f; n++) ;
+            s += n;
+            len -= n;
+            continue;
         }
+
+        /* two byte */
+        if ((*s >> 5) == 0x6) n = 1;
         /* three byte */
-        else if ((*s >> 4) == 0x0e) {
-            ADV_PTR;
-            if (!((*s >> 6) == 0x2)) return 0;
-            ADV_PTR;
-            if (!((*s >> 6) == 0x2)) return 0;
-        }
-        /* four byte */        
-        else if ((*s >> 3) == 0x1e) {
-            ADV_PTR;
-            if (!((*s >> 6) == 0x2)) return 0;
-            ADV_PTR;
-            if (!((*s >> 6) == 0x2)) return 0;
-            ADV_PTR;
-            if (!((*s >> 6) == 0x2)) return 0;
-        } else {
-            return 0;
+        else if ((*s >> 4) == 0x0e) n = 2;
+        /* four byte */
+        else if ((*s >> 3) == 0x1e) n = 3;
+        else return 0;
+
+        if (len <= n) return 0;
+        for (i = 1; i <= n; i++) {
+            if (!((s[i] >> 6) == 0x2)) return 0;
         }
-        
-        s++;
+        s += n + 1;
+        len -= n + 1;
     }
-    
+
     return 1;
 }
@@ -29,6 +29,11 @@ void yajl_string_encode(const yajl_print_t printer,
 void yajl_string_decode(yajl_buf buf, const unsigned char * str,
                         size_t length);
 
+/* decode the contents of a string into out, which has room for length
+ * bytes and may be str itself.  returns the decoded length */
+size_t yajl_string_decode_to(unsigned char * out, const unsigned char * str,
+                             size_t length);
+
 int yajl_string_validate_utf8(const unsigned char * s, size_t len);
 
 #endif
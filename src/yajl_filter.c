@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "yajl_filter.h"
+#include "yajl_buf.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define YAJL_FILTER_FRAMES_INC 16
+
+/* one step of a selector */
+typedef struct {
+    const char * key;
+    size_t len;
+    /* the array index the key spells, or (size_t) -1 */
+    size_t index;
+    int wild;
+} yajl_filter_step;
+
+typedef struct {
+    yajl_filter_step * steps;
+    size_t len;
+} yajl_filter_selector;
+
+/* an object or array that's been entered.  the frame at depth d matches
+ * its members against step d of its selectors */
+typedef struct {
+    /* the selectors which match the path so far, one bit each */
+    uint64_t mask;
+    /* the selectors which match the key whose value is next */
+    uint64_t keyMask;
+    /* the index of the next array element */
+    size_t index;
+    unsigned char isArray;
+    /* non-zero inside a selected value, where everything passes */
+    unsigned char pass;
+} yajl_filter_frame;
+
+struct yajl_filter_t {
+    yajl_filter_selector selectors[YAJL_FILTER_MAX];
+    size_t count;
+    /* non-zero if a selector selects the whole document */
+    int selectsRoot;
+    yajl_filter_frame * frames;
+    size_t depth;
+    size_t framesSize;
+    yajl_buf heldKey;
+    int holding;
+    yajl_alloc_funcs * alloc;
+};
+
+yajl_filter
+yajl_filter_alloc(yajl_alloc_funcs * alloc)
+{
+    yajl_filter f = (yajl_filter) YA_MALLOC(alloc,
+                                            sizeof(struct yajl_filter_t));
+    memset((void *) f, 0, sizeof(struct yajl_filter_t));
+    f->heldKey = yajl_buf_alloc(alloc);
+    f->alloc = alloc;
+    return f;
+}
+
+void
+yajl_filter_free(yajl_filter f)
+{
+    size_t i;
+    for (i = 0; i < f->count; i++) YA_FREE(f->alloc, f->selectors[i].steps);
+    if (f->frames) YA_FREE(f->alloc, f->frames);
+    yajl_buf_free(f->heldKey);
+    YA_FREE(f->alloc, f);
+}
+
+/* the array index spelt by a step: digits without a leading zero */
+static size_t
+yajl_filter_index(const char * key, size_t len)
+{
+    size_t i, index = 0;
+
+    if (len == 0 || (len > 1 && key[0] == '0')) return (size_t) -1;
+
+    for (i = 0; i < len; i++) {
+        if (key[i] < '0' || key[i] > '9' ||
+            index > ((size_t) -2 - (size_t) (key[i] - '0')) / 10)
+        {
+            return (size_t) -1;
+        }
+        index = index * 10 + (size_t) (key[i] - '0');
+    }
+    return index;
+}
+
+int
+yajl_filter_add(yajl_filter f, const char * pointer)
+{
+    yajl_filter_selector * sel;
+    size_t steps = 0, i;
+    const char * p;
+    char * key;
+
+    if (f->count == YAJL_FILTER_MAX) return 0;
+    if (*pointer != 0 && *pointer != '/') return 0;
+
+    for (p = pointer; *p != 0; p++) {
+        if (*p == '/') steps++;
+        else if (*p == '~' && p[1] != '0' && p[1] != '1') return 0;
+    }
+
+    if (steps == 0) {
+        f->selectsRoot = 1;
+        return 1;
+    }
+
+    /* the steps, followed by their unescaped keys */
+    sel = &f->selectors[f->count];
+    sel->len = steps;
+    sel->steps = (yajl_filter_step *)
+        YA_MALLOC(f->alloc, steps * sizeof(yajl_filter_step) +
+                            (size_t) (p - pointer));
+    key = (char *) (sel->steps + steps);
+
+    for (p = pointer, i = 0; i < steps; i++) {
+        yajl_filter_step * step = &sel->steps[i];
+        /* a step of just "*" matches any key or index */
+        const char * start = p + 1;
+
+        step->key = key;
+        for (p++; *p != 0 && *p != '/'; p++) {
+            if (*p == '~') *key++ = (*++p == '0') ? '~' : '/';
+            else *key++ = *p;
+        }
+        step->len = (size_t) (key - step->key);
+        step->wild = (p - start == 1 && *start == '*');
+        step->index = yajl_filter_index(step->key, step->len);
+    }
+
+    f->count++;
+    return 1;
+}
+
+yajl_filter_action
+yajl_filter_key(yajl_filter f, const unsigned char * key, size_t len)
+{
+    yajl_filter_frame * fr = &f->frames[f->depth - 1];
+    uint64_t m = 0;
+    size_t i;
+
+    if (fr->pass) return yajl_filter_pass;
+
+    for (i = 0; i < f->count; i++) {
+        const yajl_filter_step * step;
+
+        if (!(fr->mask & ((uint64_t) 1 << i))) continue;
+        step = &f->selectors[i].steps[f->depth - 1];
+        if (step->wild ||
+            (step->len == len && !memcmp(step->key, key, len)))
+        {
+            m |= (uint64_t) 1 << i;
+        }
+    }
+
+    fr->keyMask = m;
+    if (m == 0) return yajl_filter_drop;
+
+    yajl_buf_clear(f->heldKey);
+    yajl_buf_append(f->heldKey, key, len);
+    f->holding = 1;
+    return yajl_filter_hold;
+}
+
+int
+yajl_filter_value(yajl_filter f, int container)
+{
+    yajl_filter_frame * fr;
+    uint64_t m = 0, going = 0;
+    int pass = 0;
+    size_t i;
+
+    if (f->depth == 0) {
+        /* the root of a document */
+        pass = f->selectsRoot;
+        m = f->count == YAJL_FILTER_MAX ? ~(uint64_t) 0
+                                        : ((uint64_t) 1 << f->count) - 1;
+    } else {
+        fr = &f->frames[f->depth - 1];
+        if (fr->pass) {
+            pass = 1;
+        } else if (fr->isArray) {
+            for (i = 0; i < f->count; i++) {
+                const yajl_filter_step * step;
+
+                if (!(fr->mask & ((uint64_t) 1 << i))) continue;
+                step = &f->selectors[i].steps[f->depth - 1];
+                if (step->wild || step->index == fr->index) {
+                    m |= (uint64_t) 1 << i;
+                }
+            }
+        } else {
+            m = fr->keyMask;
+        }
+        if (fr->isArray) fr->index++;
+
+        /* a selector which ends here selects the value */
+        for (i = 0; i < f->count && !pass; i++) {
+            if ((m & ((uint64_t) 1 << i)) &&
+                f->selectors[i].len == f->depth)
+            {
+                pass = 1;
+            }
+        }
+    }
+
+    /* the selectors which go deeper */
+    for (i = 0; i < f->count; i++) {
+        if ((m & ((uint64_t) 1 << i)) && f->selectors[i].len > f->depth) {
+            going |= (uint64_t) 1 << i;
+        }
+    }
+
+    if (!pass && (!container || going == 0)) {
+        f->holding = 0;
+        return 0;
+    }
+
+    if (container) {
+        if (f->depth == f->framesSize) {
+            f->framesSize += YAJL_FILTER_FRAMES_INC;
+            f->frames = (yajl_filter_frame *)
+                YA_REALLOC(f->alloc, f->frames,
+                           f->framesSize * sizeof(yajl_filter_frame));
+        }
+        fr = &f->frames[f->depth++];
+        fr->mask = going;
+        fr->keyMask = 0;
+        fr->index = 0;
+        fr->isArray = (container == '[');
+        fr->pass = (unsigned char) pass;
+    }
+    return 1;
+}
+
+int
+yajl_filter_held_key(yajl_filter f, const unsigned char ** key, size_t * len)
+{
+    if (!f->holding) return 0;
+    f->holding = 0;
+    *key = yajl_buf_data(f->heldKey);
+    *len = yajl_buf_len(f->heldKey);
+    return 1;
+}
+
+void
+yajl_filter_end(yajl_filter f)
+{
+    if (f->depth > 0) f->depth--;
+}
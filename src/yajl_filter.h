@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The path filters of yajl_add_path_filter().  The filter follows the
+ * parser down the document, keeping for each open object or array the
+ * set of selectors whose leading steps match the path to it.  The parser
+ * asks it about every key and value, and only calls back for those on
+ * the way to, or inside, a selected value.
+ *
+ * Keys are held back until their value is known to be wanted, so that
+ * the callbacks always describe well formed JSON: the document cut down
+ * to the selected values and the objects and arrays around them.
+ */
+
+#ifndef __YAJL_FILTER_H__
+#define __YAJL_FILTER_H__
+
+#include "api/yajl_common.h"
+#include "yajl_alloc.h"
+
+typedef struct yajl_filter_t * yajl_filter;
+
+/* the most selectors one filter can hold */
+#define YAJL_FILTER_MAX 64
+
+/* allocate a new filter, selecting nothing */
+yajl_filter yajl_filter_alloc(yajl_alloc_funcs * alloc);
+
+/* free a filter */
+void yajl_filter_free(yajl_filter f);
+
+/* add a selector, a JSON pointer where a "*" step matches any key or
+ * index.  returns zero if it's malformed or the filter is full */
+int yajl_filter_add(yajl_filter f, const char * pointer);
+
+/* what to do with a map key */
+typedef enum {
+    /* skip the key and its value */
+    yajl_filter_drop = 0,
+    /* call back for the key now */
+    yajl_filter_pass,
+    /* the key is held until its value, see yajl_filter_held_key() */
+    yajl_filter_hold
+} yajl_filter_action;
+
+/* decide on the key of a map entry */
+yajl_filter_action yajl_filter_key(yajl_filter f, const unsigned char * key,
+                                   size_t len);
+
+/* decide on a value, given its first token: '{' or '[' for the start of
+ * a map or array, 0 for anything else.  returns non-zero if the value is
+ * wanted, in which case a map or array is entered and must be left with
+ * yajl_filter_end() */
+int yajl_filter_value(yajl_filter f, int container);
+
+/* the key held back for the value just accepted, if any.  returns zero
+ * when there's none */
+int yajl_filter_held_key(yajl_filter f, const unsigned char ** key,
+                         size_t * len);
+
+/* leave a map or array */
+void yajl_filter_end(yajl_filter f);
+
+#endif
@@ -17,12 +17,37 @@
 #include "api/yajl_gen.h"
 #include "yajl_buf.h"
 #include "yajl_encode.h"
+#include "yajl_number.h"
+#include "yajl_simd.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
 #include <stdarg.h>
+#include <errno.h>
+
+#if defined(_WIN32) || defined(WIN32)
+#include <io.h>
+struct iovec {
+    void * iov_base;
+    size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/* how much output is collected before it's handed to a print callback,
+ * and the size of each buffer in the ring for a file descriptor */
+#define YAJL_GEN_STAGE_SIZE (64 * 1024)
+
+/* the most buffers in the ring.  one more iovec than this is passed to
+ * writev, and POSIX only promises 16 */
+#define YAJL_GEN_RING_MAX 15
+
+/* the default yajl_gen_flush_threshold */
+#define YAJL_GEN_FLUSH_THRESHOLD (4 * YAJL_GEN_STAGE_SIZE)
 
 typedef enum {
     yajl_gen_start,
@@ -40,13 +65,241 @@ struct yajl_gen_t
     unsigned int flags;
     unsigned int depth;
     const char * indentString;
+    /* ",\n" followed by the indent string repeated for linesDepth levels,
+     * so that a line break and its indent are printed in one go, see
+     * yajl_gen_indent() */
+    char * lines;
+    unsigned int linesDepth;
+    size_t indentLen;
+    /* significant digits for doubles, 0 for the shortest round trip */
+    int doublePrecision;
     yajl_gen_state state[YAJL_MAX_DEPTH];
     yajl_print_t print;
     void * ctx; /* yajl_buf */
+    /* with a print callback, output is staged here and handed over a
+     * block at a time, see yajl_gen_stage() */
+    char * stage;
+    size_t staged;
+    yajl_print_t userPrint;
+    void * userCtx;
+    /* output for yajl_gen_output_fd is collected in the first ringUsed
+     * buffers of the ring, the last of which has filled bytes in it.  it's
+     * written out once flushThreshold bytes are waiting, or the ringLen
+     * buffers the threshold asks for are full */
+    int fd;
+    char * ring[YAJL_GEN_RING_MAX];
+    unsigned int ringLen;
+    unsigned int ringUsed;
+    size_t filled;
+    size_t flushThreshold;
+    /* errno from a write to fd which failed, after which output is
+     * dropped and the generator is in its error state */
+    int writeErrno;
     /* memory allocation routines */
     yajl_alloc_funcs alloc;
 };
 
+/* make room in lines for the current depth, returns zero if there's no
+ * memory for it */
+static int
+yajl_gen_grow_lines(yajl_gen g)
+{
+    unsigned int depth = g->linesDepth ? g->linesDepth * 2 : 8;
+    unsigned int i;
+    char * lines;
+
+    if (depth < g->depth) depth = g->depth;
+    if (depth > YAJL_MAX_DEPTH) depth = YAJL_MAX_DEPTH;
+
+    lines = (char *) YA_REALLOC(&(g->alloc), g->lines,
+                                2 + depth * g->indentLen);
+    if (lines == NULL) return 0;
+
+    lines[0] = ',';
+    lines[1] = '\n';
+    for (i = g->linesDepth; i < depth; i++) {
+        memcpy(lines + 2 + i * g->indentLen, g->indentString, g->indentLen);
+    }
+    g->lines = lines;
+    g->linesDepth = depth;
+    return 1;
+}
+
+/* print the indent for the current depth, preceded by ",\n" when from is
+ * 0, by "\n" when it's 1, and by nothing when it's 2 */
+static void
+yajl_gen_indent(yajl_gen g, size_t from)
+{
+    size_t len = 2 + g->depth * g->indentLen;
+
+    if ((g->lines == NULL || g->depth > g->linesDepth) &&
+        !yajl_gen_grow_lines(g))
+    {
+        unsigned int i;
+        if (from < 2) g->print(g->ctx, ",\n" + from, 2 - from);
+        for (i = 0; i < g->depth; i++) {
+            g->print(g->ctx, g->indentString, g->indentLen);
+        }
+        return;
+    }
+    if (len > from) g->print(g->ctx, g->lines + from, len - from);
+}
+
+/* the print function while a print callback is staged */
+static void
+yajl_gen_stage(void * ctx, const char * str, size_t len)
+{
+    yajl_gen g = (yajl_gen) ctx;
+
+    if (g->staged + len > YAJL_GEN_STAGE_SIZE) {
+        yajl_gen_flush(g);
+        /* too big to be worth copying */
+        if (len >= YAJL_GEN_STAGE_SIZE) {
+            g->userPrint(g->userCtx, str, len);
+            return;
+        }
+    }
+    memcpy(g->stage + g->staged, str, len);
+    g->staged += len;
+}
+
+static long
+yajl_gen_writev(int fd, struct iovec * iov, unsigned int n)
+{
+#if defined(_WIN32) || defined(WIN32)
+    (void) n;
+    return _write(fd, iov[0].iov_base, (unsigned int) iov[0].iov_len);
+#else
+    return (long) writev(fd, iov, (int) n);
+#endif
+}
+
+/* write out what's waiting in the ring, followed by len bytes at str */
+static void
+yajl_gen_fd_write(yajl_gen g, const char * str, size_t len)
+{
+    struct iovec iov[YAJL_GEN_RING_MAX + 1];
+    unsigned int n = 0, i = 0;
+
+    for (; n < g->ringUsed; n++) {
+        iov[n].iov_base = g->ring[n];
+        iov[n].iov_len = (n + 1 < g->ringUsed) ? YAJL_GEN_STAGE_SIZE
+                                               : g->filled;
+    }
+    if (len > 0) {
+        iov[n].iov_base = (void *) str;
+        iov[n].iov_len = len;
+        n++;
+    }
+    g->ringUsed = 0;
+    g->filled = 0;
+
+    while (i < n && !g->writeErrno) {
+        long w = yajl_gen_writev(g->fd, iov + i, n - i);
+        if (w < 0) {
+            if (errno != EINTR) g->writeErrno = errno;
+            continue;
+        } else if (w == 0 && iov[i].iov_len > 0) {
+            g->writeErrno = EIO;
+            continue;
+        }
+        /* what's left after a short write */
+        for (; i < n && (size_t) w >= iov[i].iov_len; i++) {
+            w -= (long) iov[i].iov_len;
+        }
+        if (i < n) {
+            iov[i].iov_base = (char *) iov[i].iov_base + w;
+            iov[i].iov_len -= (size_t) w;
+        }
+    }
+}
+
+/* the print function for yajl_gen_output_fd */
+static void
+yajl_gen_fd_print(void * ctx, const char * str, size_t len)
+{
+    yajl_gen g = (yajl_gen) ctx;
+
+    /* the usual case: it fits in the buffer being filled */
+    if (len <= YAJL_GEN_STAGE_SIZE - g->filled && g->ringUsed > 0) {
+        memcpy(g->ring[g->ringUsed - 1] + g->filled, str, len);
+        g->filled += len;
+        if ((g->ringUsed - 1) * YAJL_GEN_STAGE_SIZE + g->filled
+            >= g->flushThreshold)
+        {
+            yajl_gen_fd_write(g, NULL, 0);
+        }
+        return;
+    }
+
+    if (g->writeErrno) return;
+
+    /* too big to be worth copying, it goes out with what's waiting */
+    if (len >= YAJL_GEN_STAGE_SIZE) {
+        yajl_gen_fd_write(g, str, len);
+        return;
+    }
+
+    while (len > 0) {
+        size_t n;
+
+        if (g->ringUsed == 0 || g->filled == YAJL_GEN_STAGE_SIZE) {
+            if (g->ringUsed == g->ringLen) yajl_gen_fd_write(g, NULL, 0);
+            if (g->ring[g->ringUsed] == NULL) {
+                g->ring[g->ringUsed] = (char *) YA_MALLOC(&(g->alloc),
+                                                          YAJL_GEN_STAGE_SIZE);
+                if (g->ring[g->ringUsed] == NULL) {
+                    /* write out what there is and carry on without */
+                    if (g->ringUsed == 0) {
+                        yajl_gen_fd_write(g, str, len);
+                        return;
+                    }
+                    g->ringLen = g->ringUsed;
+                    continue;
+                }
+            }
+            g->ringUsed++;
+            g->filled = 0;
+        }
+
+        n = YAJL_GEN_STAGE_SIZE - g->filled;
+        if (n > len) n = len;
+        memcpy(g->ring[g->ringUsed - 1] + g->filled, str, n);
+        g->filled += n;
+        str += n;
+        len -= n;
+    }
+
+    if (g->ringUsed > 0 &&
+        (g->ringUsed - 1) * YAJL_GEN_STAGE_SIZE + g->filled
+        >= g->flushThreshold)
+    {
+        yajl_gen_fd_write(g, NULL, 0);
+    }
+}
+
+/* how many ring buffers the flush threshold needs */
+static void
+yajl_gen_size_ring(yajl_gen g)
+{
+    size_t n = (g->flushThreshold + YAJL_GEN_STAGE_SIZE - 1) /
+               YAJL_GEN_STAGE_SIZE;
+    g->ringLen = (unsigned int) (n > YAJL_GEN_RING_MAX ? YAJL_GEN_RING_MAX
+                                                       : n);
+}
+
+/* hand over whatever output the current print function is holding on to,
+ * before another takes its place */
+static void
+yajl_gen_release_output(yajl_gen g)
+{
+    if (g->print == (yajl_print_t)&yajl_buf_append) {
+        yajl_buf_free(g->ctx);
+    } else {
+        yajl_gen_flush(g);
+    }
+}
+
 int
 yajl_gen_config(yajl_gen g, yajl_gen_option opt, ...)
 {
@@ -64,6 +317,8 @@ yajl_gen_config(yajl_gen g, yajl_gen_option opt, ...)
         case yajl_gen_indent_string: {
             const char *indent = va_arg(ap, const char *);
             g->indentString = indent;
+            g->indentLen = strlen(indent);
+            g->linesDepth = 0;
             for (; *indent; indent++) {
                 if (*indent != '\n'
                     && *indent != '\v'
@@ -72,17 +327,60 @@ yajl_gen_config(yajl_gen g, yajl_gen_option opt, ...)
                     && *indent != '\r'
                     && *indent != ' ')
                 {
-                    g->indentString = NULL;
+                    g->indentString = "";
+                    g->indentLen = 0;
                     rv = 0;
                 }
             }
             break;
         }
+        case yajl_gen_double_precision: {
+            int precision = va_arg(ap, int);
+            if (precision < 0 || precision > 17) rv = 0;
+            else g->doublePrecision = precision;
+            break;
+        }
         case yajl_gen_print_callback:
-            yajl_buf_free(g->ctx);
+            yajl_gen_release_output(g);
             g->print = va_arg(ap, const yajl_print_t);
             g->ctx = va_arg(ap, void *);
+            if (g->stage == NULL) {
+                g->stage = (char *) YA_MALLOC(&(g->alloc),
+                                              YAJL_GEN_STAGE_SIZE);
+            }
+            /* without a stage, print straight to the callback */
+            if (g->stage != NULL) {
+                g->userPrint = g->print;
+                g->userCtx = g->ctx;
+                g->print = &yajl_gen_stage;
+                g->ctx = g;
+            }
             break;
+        case yajl_gen_output_fd: {
+            int fd = va_arg(ap, int);
+            if (fd < 0) {
+                rv = 0;
+                break;
+            }
+            yajl_gen_release_output(g);
+            g->fd = fd;
+            g->writeErrno = 0;
+            g->print = &yajl_gen_fd_print;
+            g->ctx = g;
+            break;
+        }
+        case yajl_gen_flush_threshold: {
+            int threshold = va_arg(ap, int);
+            if (threshold <= 0) {
+                rv = 0;
+                break;
+            }
+            /* the ring may get smaller */
+            if (g->print == &yajl_gen_fd_print) yajl_gen_flush(g);
+            g->flushThreshold = (size_t) threshold;
+            yajl_gen_size_ring(g);
+            break;
+        }
         default:
             rv = 0;
     }
@@ -121,6 +419,10 @@ yajl_gen_alloc(const yajl_alloc_funcs * afs)
     g->print = (yajl_print_t)&yajl_buf_append;
     g->ctx = yajl_buf_alloc(&(g->alloc));
     g->indentString = "    ";
+    g->indentLen = 4;
+    g->fd = -1;
+    g->flushThreshold = YAJL_GEN_FLUSH_THRESHOLD;
+    yajl_gen_size_ring(g);
 
     return g;
 }
@@ -136,29 +438,56 @@ yajl_gen_reset(yajl_gen g, const char * sep)
 void
 yajl_gen_free(yajl_gen g)
 {
+    unsigned int i;
+
     if (g->print == (yajl_print_t)&yajl_buf_append) yajl_buf_free((yajl_buf)g->ctx);
+    if (g->stage != NULL) {
+        yajl_gen_flush(g);
+        YA_FREE(&(g->alloc), g->stage);
+    }
+    if (g->lines != NULL) YA_FREE(&(g->alloc), g->lines);
+    if (g->print == &yajl_gen_fd_print) yajl_gen_flush(g);
+    for (i = 0; i < YAJL_GEN_RING_MAX && g->ring[i] != NULL; i++) {
+        YA_FREE(&(g->alloc), g->ring[i]);
+    }
     YA_FREE(&(g->alloc), g);
 }
 
+yajl_gen_status
+yajl_gen_flush(yajl_gen g)
+{
+    if (g->print == &yajl_gen_stage && g->staged > 0) {
+        g->userPrint(g->userCtx, g->stage, g->staged);
+        g->staged = 0;
+    } else if (g->print == &yajl_gen_fd_print) {
+        if (g->ringUsed > 0) yajl_gen_fd_write(g, NULL, 0);
+        if (g->writeErrno) {
+            errno = g->writeErrno;
+            return yajl_gen_write_error;
+        }
+    }
+    return yajl_gen_status_ok;
+}
+
+/* when beautifying, a separator comes with the next line's indent */
 #define INSERT_SEP \
     if (g->state[g->depth] == yajl_gen_map_key ||               \
         g->state[g->depth] == yajl_gen_in_array) {              \
-        g->print(g->ctx, ",", 1);                               \
-        if ((g->flags & yajl_gen_beautify)) g->print(g->ctx, "\n", 1);               \
+        if ((g->flags & yajl_gen_beautify)) yajl_gen_indent(g, 0); \
+        else g->print(g->ctx, ",", 1);                          \
     } else if (g->state[g->depth] == yajl_gen_map_val) {        \
         g->print(g->ctx, ":", 1);                               \
         if ((g->flags & yajl_gen_beautify)) g->print(g->ctx, " ", 1);                \
    }
 
+/* the indent of a first value, the others got theirs with INSERT_SEP */
 #define INSERT_WHITESPACE                                               \
-    if ((g->flags & yajl_gen_beautify)) {                                                    \
-        if (g->state[g->depth] != yajl_gen_map_val) {                   \
-            unsigned int _i;                                            \
-            for (_i=0;_i<g->depth;_i++)                                 \
-                g->print(g->ctx,                                        \
-                         g->indentString,                               \
-                         (unsigned int)strlen(g->indentString));        \
-        }                                                               \
+    if ((g->flags & yajl_gen_beautify) &&                               \
+        (g->state[g->depth] == yajl_gen_start ||                        \
+         g->state[g->depth] == yajl_gen_map_start ||                    \
+         g->state[g->depth] == yajl_gen_array_start))                   \
+    {                                                                   \
+        yajl_gen_indent(g, 2);                                          \
     }
 
 #define ENSURE_NOT_KEY \
@@ -201,19 +530,34 @@ yajl_gen_free(yajl_gen g)
             break;                                  \
     }                                               \
 
+/* a complete document is handed over whole, rather than being left on
+ * the stage until something follows it */
 #define FINAL_NEWLINE                                        \
-    if ((g->flags & yajl_gen_beautify) && g->state[g->depth] == yajl_gen_complete) \
-        g->print(g->ctx, "\n", 1);
+    if (g->state[g->depth] == yajl_gen_complete) {           \
+        if (g->flags & yajl_gen_beautify) g->print(g->ctx, "\n", 1); \
+        if (g->staged || g->ringUsed) yajl_gen_flush(g);     \
+    }
+
+/* a write to yajl_gen_output_fd failed, which puts the generator in its
+ * error state */
+#define ENSURE_WRITTEN                                       \
+    if (g->writeErrno) {                                     \
+        g->state[g->depth] = yajl_gen_error;                 \
+        errno = g->writeErrno;                               \
+        return yajl_gen_write_error;                         \
+    }
 
 yajl_gen_status
 yajl_gen_integer(yajl_gen g, long long int number)
 {
-    char i[32];
+    char i[YAJL_INTEGER_BUF_SIZE];
+    size_t len;
     ENSURE_VALID_STATE; ENSURE_NOT_KEY; INSERT_SEP; INSERT_WHITESPACE;
-    sprintf(i, "%lld", number);
-    g->print(g->ctx, i, (unsigned int)strlen(i));
+    len = yajl_format_integer(number, i);
+    g->print(g->ctx, i, (unsigned int)len);
     APPENDED_ATOM;
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -226,17 +570,16 @@ yajl_gen_integer(yajl_gen g, long long int number)
 yajl_gen_status
 yajl_gen_double(yajl_gen g, double number)
 {
-    char i[32];
+    char i[YAJL_DOUBLE_BUF_SIZE];
+    size_t len;
     ENSURE_VALID_STATE; ENSURE_NOT_KEY;
     if (isnan(number) || isinf(number)) return yajl_gen_invalid_number;
     INSERT_SEP; INSERT_WHITESPACE;
-    sprintf(i, "%.20g", number);
-    if (strspn(i, "0123456789-") == strlen(i)) {
-        strcat(i, ".0");
-    }
-    g->print(g->ctx, i, (unsigned int)strlen(i));
+    len = yajl_format_double(number, g->doublePrecision, i);
+    g->print(g->ctx, i, (unsigned int)len);
     APPENDED_ATOM;
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -247,6 +590,7 @@ yajl_gen_number(yajl_gen g, const char * s, size_t l)
     g->print(g->ctx, s, l);
     APPENDED_ATOM;
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -254,20 +598,34 @@ yajl_gen_status
 yajl_gen_string(yajl_gen g, const unsigned char * str,
                 size_t len)
 {
-    // if validation is enabled, check that the string is valid utf8
-    // XXX: This checking could be done a little faster, in the same pass as
-    // the string encoding
-    if (g->flags & yajl_gen_validate_utf8) {
-        if (!yajl_string_validate_utf8(str, len)) {
+    size_t clean = 0;
+
+    // if validation is enabled, check that the string is valid utf8.  The
+    // scan which does so also stops at the first character needing an
+    // escape, so what comes before it can be printed as it is
+    if ((g->flags & yajl_gen_validate_utf8) && len > 0) {
+        clean = yajl_simd_utf8_scan(str, len);
+        if (clean < len &&
+            !yajl_string_validate_utf8(str + clean, len - clean))
+        {
             return yajl_gen_invalid_string;
         }
+        // the scan doesn't stop at a solidus
+        if (g->flags & yajl_gen_escape_solidus) clean = 0;
     }
     ENSURE_VALID_STATE; INSERT_SEP; INSERT_WHITESPACE;
     g->print(g->ctx, "\"", 1);
-    yajl_string_encode(g->print, g->ctx, str, len, g->flags & yajl_gen_escape_solidus);
+    if (clean > 0) {
+        g->print(g->ctx, (const char *) str, clean);
+        str += clean;
+        len -= clean;
+    }
+    yajl_string_encode(g->print, g->ctx, str, len,
+                       g->flags & yajl_gen_escape_solidus);
     g->print(g->ctx, "\"", 1);
     APPENDED_ATOM;
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -278,6 +636,7 @@ yajl_gen_null(yajl_gen g)
     g->print(g->ctx, "null", strlen("null"));
     APPENDED_ATOM;
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -290,6 +649,7 @@ yajl_gen_bool(yajl_gen g, int boolean)
     g->print(g->ctx, val, (unsigned int)strlen(val));
     APPENDED_ATOM;
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -300,9 +660,10 @@ yajl_gen_map_open(yajl_gen g)
     INCREMENT_DEPTH;
 
     g->state[g->depth] = yajl_gen_map_start;
-    g->print(g->ctx, "{", 1);
-    if ((g->flags & yajl_gen_beautify)) g->print(g->ctx, "\n", 1);
+    if ((g->flags & yajl_gen_beautify)) g->print(g->ctx, "{\n", 2);
+    else g->print(g->ctx, "{", 1);
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -312,11 +673,11 @@ yajl_gen_map_close(yajl_gen g)
     ENSURE_VALID_STATE;
     DECREMENT_DEPTH;
 
-    if ((g->flags & yajl_gen_beautify)) g->print(g->ctx, "\n", 1);
+    if ((g->flags & yajl_gen_beautify)) yajl_gen_indent(g, 1);
     APPENDED_ATOM;
-    INSERT_WHITESPACE;
     g->print(g->ctx, "}", 1);
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -326,9 +687,10 @@ yajl_gen_array_open(yajl_gen g)
     ENSURE_VALID_STATE; ENSURE_NOT_KEY; INSERT_SEP; INSERT_WHITESPACE;
     INCREMENT_DEPTH;
     g->state[g->depth] = yajl_gen_array_start;
-    g->print(g->ctx, "[", 1);
-    if ((g->flags & yajl_gen_beautify)) g->print(g->ctx, "\n", 1);
+    if ((g->flags & yajl_gen_beautify)) g->print(g->ctx, "[\n", 2);
+    else g->print(g->ctx, "[", 1);
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
@@ -337,11 +699,11 @@ yajl_gen_array_close(yajl_gen g)
 {
     ENSURE_VALID_STATE;
     DECREMENT_DEPTH;
-    if ((g->flags & yajl_gen_beautify)) g->print(g->ctx, "\n", 1);
+    if ((g->flags & yajl_gen_beautify)) yajl_gen_indent(g, 1);
     APPENDED_ATOM;
-    INSERT_WHITESPACE;
     g->print(g->ctx, "]", 1);
     FINAL_NEWLINE;
+    ENSURE_WRITTEN;
     return yajl_gen_status_ok;
 }
 
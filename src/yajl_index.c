@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "yajl_index.h"
+#include "yajl_simd.h"
+
+#include <string.h>
+
+/* the number of 64 byte blocks in a window */
+#define YAJL_INDEX_BLOCKS 512
+
+/* whether a window is worth indexing is judged by its first few blocks.
+ * After this many windows in a row which weren't, the index is left
+ * alone for 2^YAJL_INDEX_MAX_BACKOFF windows at a time */
+#define YAJL_INDEX_SAMPLE 8
+#define YAJL_INDEX_MAX_BACKOFF 4
+
+struct yajl_index_t {
+    const unsigned char * text;
+    size_t len;
+    /* the current window covers the blocks from base up to scanned */
+    size_t base;
+    size_t scanned;
+    /* what we know about each block in the window, one bit per byte:
+     * the first byte after a run of whitespace, quotes which open and
+     * close strings, and the closing quotes of strings with escapes or
+     * control characters in them, or with non-ASCII characters to
+     * validate */
+    uint64_t * starts;
+    uint64_t * opens;
+    uint64_t * closes;
+    uint64_t * dirty;
+    uint64_t * nonASCII;
+    /* state carried from one block to the next: whether the first byte
+     * of the next block is escaped, whether it's inside a string (all
+     * ones if so), whether the last byte was whitespace, and whether the
+     * string that is open has seen escapes or non-ASCII characters */
+    uint64_t escaped;
+    uint64_t inString;
+    uint64_t afterSpace;
+    uint64_t dirtyCarry;
+    uint64_t nonASCIICarry;
+    /* of the first blocks of the window, the whitespace bytes that
+     * follow whitespace, and the runs of whitespace */
+    size_t hops;
+    size_t runs;
+    /* set when the window wasn't worth indexing.  Nothing is indexed
+     * before base, from where indexing starts afresh when asked */
+    unsigned int dormant;
+    /* how many windows in a row weren't worth indexing */
+    unsigned int sparse;
+    unsigned int validateUTF8;
+    yajl_alloc_funcs * alloc;
+};
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+static unsigned int yajl_ctz64(uint64_t x)
+{
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (unsigned int) i;
+}
+#elif defined(__GNUC__)
+#define yajl_ctz64(x) ((unsigned int) __builtin_ctzll(x))
+#else
+static unsigned int yajl_ctz64(uint64_t x)
+{
+    unsigned int i = 0;
+    while (!(x & 1)) { x >>= 1; i++; }
+    return i;
+}
+#endif
+
+/* only used on the few blocks which are sampled, see yajl_index_fill() */
+#if defined(__GNUC__)
+#define yajl_popcount64(x) ((unsigned int) __builtin_popcountll(x))
+#else
+static unsigned int yajl_popcount64(uint64_t x)
+{
+    unsigned int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+}
+#endif
+
+yajl_index
+yajl_index_alloc(yajl_alloc_funcs * alloc)
+{
+    yajl_index idx = (yajl_index) YA_MALLOC(alloc, sizeof(struct yajl_index_t));
+    memset((void *) idx, 0, sizeof(struct yajl_index_t));
+    idx->starts = (uint64_t *) YA_MALLOC(alloc, 5 * YAJL_INDEX_BLOCKS *
+                                                sizeof(uint64_t));
+    idx->opens = idx->starts + YAJL_INDEX_BLOCKS;
+    idx->closes = idx->opens + YAJL_INDEX_BLOCKS;
+    idx->dirty = idx->closes + YAJL_INDEX_BLOCKS;
+    idx->nonASCII = idx->dirty + YAJL_INDEX_BLOCKS;
+    idx->alloc = alloc;
+    return idx;
+}
+
+void
+yajl_index_free(yajl_index idx)
+{
+    YA_FREE(idx->alloc, idx->starts);
+    YA_FREE(idx->alloc, idx);
+}
+
+/* start indexing from off, which must lie between tokens or at the start
+ * of one */
+static void
+yajl_index_restart(yajl_index idx, size_t off)
+{
+    idx->base = idx->scanned = off;
+    idx->dormant = 0;
+    idx->escaped = 0;
+    idx->inString = 0;
+    /* where we start counts as the end of a run of whitespace */
+    idx->afterSpace = 1;
+    idx->dirtyCarry = 0;
+    idx->nonASCIICarry = 0;
+}
+
+void
+yajl_index_reset(yajl_index idx, const unsigned char * text, size_t len,
+                 unsigned int validateUTF8)
+{
+    idx->text = text;
+    idx->len = len;
+    idx->sparse = 0;
+    idx->validateUTF8 = validateUTF8;
+    yajl_index_restart(idx, 0);
+}
+
+/* find the bytes which are escaped by a backslash: those that follow an
+ * odd length run of backslashes.  Runs that start on an odd bit, added
+ * to the backslashes, carry out past their end onto the escaped byte, and
+ * then the parity of where each run ended tells us the rest. */
+static uint64_t
+yajl_index_escaped(uint64_t bslash, uint64_t * escapedNext)
+{
+    const uint64_t evenBits = 0x5555555555555555ULL;
+    uint64_t escape, followsEscape, oddStarts, sum, escaped;
+
+    if (!bslash) {
+        escaped = *escapedNext;
+        *escapedNext = 0;
+        return escaped;
+    }
+
+    escape = bslash & ~*escapedNext;
+    followsEscape = (escape << 1) | *escapedNext;
+    oddStarts = escape & ~evenBits & ~followsEscape;
+    sum = oddStarts + escape;
+    *escapedNext = sum < oddStarts;
+
+    return (evenBits ^ (sum << 1)) & followsEscape;
+}
+
+/* set every bit that has an odd number of set bits at or below it */
+static uint64_t
+yajl_index_prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/* find the closing quotes of strings which have any of the bits in mask
+ * set between their quotes.  Adding mask to the contents of the strings
+ * carries out of every such run of contents into the byte after it,
+ * which is the closing quote. */
+static uint64_t
+yajl_index_spans(uint64_t content, uint64_t mask, uint64_t * carry)
+{
+    uint64_t sum = content + mask;
+    uint64_t sum2 = sum + *carry;
+    *carry = (sum < content) | (sum2 < sum);
+    return sum2;
+}
+
+static void
+yajl_index_block(yajl_index idx, const unsigned char * text, size_t blk)
+{
+    yajl_simd_masks m;
+    uint64_t escaped, quotes, inString, content, spaces, closes, hops;
+
+    yajl_simd_classify(text, &m);
+
+    escaped = yajl_index_escaped(m.bslash, &idx->escaped);
+    quotes = m.quote & ~escaped;
+    /* set from an opening quote up to (but not including) its close */
+    inString = yajl_index_prefix_xor(quotes) ^ idx->inString;
+    idx->inString = 0 - (inString >> 63);
+    content = inString & ~quotes;
+    closes = quotes & ~inString;
+    idx->opens[blk] = quotes & inString;
+    idx->closes[blk] = closes;
+
+    spaces = m.space & ~content;
+    hops = (spaces << 1) | idx->afterSpace;
+    idx->starts[blk] = ~m.space & ~content & hops;
+    idx->afterSpace = spaces >> 63;
+    if (blk < YAJL_INDEX_SAMPLE) {
+        idx->hops += yajl_popcount64(spaces & hops);
+        idx->runs += yajl_popcount64(idx->starts[blk]);
+    }
+
+    idx->dirty[blk] = closes & yajl_index_spans(
+        content, (m.bslash | m.ctrl) & content, &idx->dirtyCarry);
+    idx->nonASCII[blk] = closes & yajl_index_spans(
+        content, idx->validateUTF8 ? m.high & content : 0,
+        &idx->nonASCIICarry);
+}
+
+/* move the window along to the blocks which follow it.  returns zero
+ * when there's nothing left to index, or the index has gone dormant. */
+static int
+yajl_index_fill(yajl_index idx)
+{
+    size_t blk, skip;
+
+    idx->base = idx->scanned;
+    if (idx->scanned >= idx->len) return 0;
+
+    idx->hops = idx->runs = 0;
+
+    for (blk = 0; blk < YAJL_INDEX_BLOCKS && idx->scanned < idx->len; blk++) {
+        if (idx->len - idx->scanned >= 64) {
+            yajl_index_block(idx, idx->text + idx->scanned, blk);
+        } else {
+            /* pad the tail with whitespace, which is never interesting */
+            unsigned char tail[64];
+            memset((void *) tail, ' ', sizeof(tail));
+            memcpy((void *) tail, (const void *) (idx->text + idx->scanned),
+                   idx->len - idx->scanned);
+            yajl_index_block(idx, tail, blk);
+        }
+        idx->scanned += 64;
+
+        /* hopping over whitespace is what the index buys the lexer,
+         * which scans strings about as quickly by itself.  That only pays
+         * for building the index where a good share of the text is
+         * whitespace, in runs longer than a lookup takes to skip.
+         * Otherwise the lexer is left on its own for a while, longer each
+         * time in a row. */
+        if (blk + 1 == YAJL_INDEX_SAMPLE) {
+            if (idx->hops * 4 < YAJL_INDEX_SAMPLE * 64 ||
+                idx->hops < 2 * idx->runs)
+            {
+                skip = ((size_t) 64 * YAJL_INDEX_BLOCKS) << idx->sparse;
+                if (idx->sparse < YAJL_INDEX_MAX_BACKOFF) idx->sparse++;
+                idx->dormant = 1;
+                idx->base = idx->scanned =
+                    (skip < idx->len - idx->base) ? idx->base + skip
+                                                  : idx->len;
+                return 0;
+            }
+            idx->sparse = 0;
+        }
+    }
+
+    return 1;
+}
+
+/* get the first offset at or after off with a bit set in masks (one of
+ * the arrays above), moving the window along as needed.  Returns the
+ * length of the text if there is no such offset, or how far it got if
+ * the index goes dormant. */
+static size_t
+yajl_index_next(yajl_index idx, size_t off, const uint64_t * masks)
+{
+    for (;;) {
+        while (off < idx->scanned) {
+            size_t rel = off - idx->base;
+            uint64_t bits = masks[rel >> 6] >> (rel & 63);
+            if (bits) {
+                off += yajl_ctz64(bits);
+                return off < idx->len ? off : idx->len;
+            }
+            off += 64 - (rel & 63);
+        }
+        if (!yajl_index_fill(idx)) return idx->dormant ? off : idx->len;
+    }
+}
+
+/* test the bit in masks for off, which must be in the window */
+#define yajl_index_test(idx, masks, off)                                \
+    ((masks)[((off) - (idx)->base) >> 6] >> (((off) - (idx)->base) & 63) & 1)
+
+size_t
+yajl_index_start(yajl_index idx)
+{
+    return idx->base;
+}
+
+size_t
+yajl_index_seek(yajl_index idx, size_t off)
+{
+    /* the window never moves backwards.  if we've been asked about
+     * something behind it, let the lexer do it the slow way */
+    if (off < idx->base) return off;
+    if (idx->dormant) yajl_index_restart(idx, off);
+    return yajl_index_next(idx, off, idx->starts);
+}
+
+size_t
+yajl_index_string_end(yajl_index idx, size_t off)
+{
+    size_t end, len;
+
+    if (off < idx->base) return 0;
+    if (idx->dormant) yajl_index_restart(idx, off);
+    while (off >= idx->scanned) {
+        if (!yajl_index_fill(idx)) return 0;
+    }
+
+    /* off must be an opening quote ... */
+    if (!yajl_index_test(idx, idx->opens, off)) return 0;
+
+    /* ... with a close */
+    end = yajl_index_next(idx, off + 1, idx->closes);
+    if (end >= idx->len || idx->dormant) return 0;
+
+    if (yajl_index_test(idx, idx->dirty, end)) return 0;
+    if (yajl_index_test(idx, idx->nonASCII, end)) {
+        /* the scan will stop at the closing quote if all is well.  giving
+         * it the rest of the text spares it copying out a partial block */
+        len = end - off - 1;
+        if (yajl_simd_utf8_scan(idx->text + off + 1, idx->len - off - 1)
+            != len)
+        {
+            return 0;
+        }
+    }
+
+    return end;
+}
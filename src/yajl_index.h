@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * A structural index over a JSON text which is entirely in memory, used
+ * by yajl_parse_buffer().  The text is classified 64 bytes at a time (see
+ * yajl_simd_classify()) into bitmaps, one bit per byte, of the quotes
+ * which open and close strings and the first byte after every run of
+ * whitespace.  With that in hand the lexer can hop over whitespace, and
+ * can take a string which needs no further checking without looking at
+ * its contents at all.  Where there's little whitespace to hop over that
+ * doesn't pay, and the text is left to the lexer.
+ *
+ * The index is built a window at a time as the lexer asks for it, so its
+ * memory use doesn't depend on the size of the text, and the parts the
+ * lexer is about to read are still in cache.
+ */
+
+#ifndef __YAJL_INDEX_H__
+#define __YAJL_INDEX_H__
+
+#include "api/yajl_common.h"
+#include "yajl_alloc.h"
+
+typedef struct yajl_index_t * yajl_index;
+
+/* allocate a new index */
+yajl_index yajl_index_alloc(yajl_alloc_funcs * alloc);
+
+/* free the index */
+void yajl_index_free(yajl_index idx);
+
+/* start indexing a new text.  When validateUTF8 is set, strings holding
+ * non-ASCII characters are validated before they're handed out. */
+void yajl_index_reset(yajl_index idx, const unsigned char * text,
+                      size_t len, unsigned int validateUTF8);
+
+/* get the offset before which the index has nothing to offer.  Text
+ * with little whitespace isn't worth indexing, so the index goes dormant
+ * over it for a while, and starts afresh from the first offset at or
+ * after this one that it's asked about. */
+size_t yajl_index_start(yajl_index idx);
+
+/* when off is within a run of whitespace, get the offset of the first
+ * byte after it (or the length of the text if the run never ends) */
+size_t yajl_index_seek(yajl_index idx, size_t off);
+
+/* when off is the opening quote of a string without escapes, control
+ * characters or (when validating) malformed UTF8, get the offset of its
+ * closing quote.  Returns zero otherwise. */
+size_t yajl_index_string_end(yajl_index idx, size_t off);
+
+#endif
@@ -16,6 +16,9 @@
 
 #include "yajl_lex.h"
 #include "yajl_buf.h"
+#include "yajl_encode.h"
+#include "yajl_index.h"
+#include "yajl_simd.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -60,9 +63,11 @@ tokToStr(yajl_tok tok)
  * When we lex to end of input string before end of token is hit, we
  * copy all of the input text composing the token into our lexBuf.
  *
- * Every time we read a character, we do so through the readChar function.
- * readChar's responsibility is to handle pulling all chars from the buffer
- * before pulling chars from input text
+ * Everything else is lexed straight out of the input text.  When the
+ * next chunk arrives, yajl_lex_stitch() appends just enough of it to
+ * the lexBuf to complete the token, and lexes the lexBuf as though it
+ * were input text.  That keeps the check for a split token out of the
+ * loops which read characters.
  */
 
 struct yajl_lexer_t {
@@ -77,11 +82,7 @@ struct yajl_lexer_t {
      * multiple chunks */
     yajl_buf buf;
 
-    /* in the case where we have data in the lexBuf, bufOff holds
-     * the current offset into the lexBuf. */
-    size_t bufOff;
-
-    /* are we using the lex buf? */
+    /* does the lex buf hold the start of a token? */
     unsigned int bufInUse;
 
     /* shall we allow comments? */
@@ -90,15 +91,20 @@ struct yajl_lexer_t {
     /* shall we validate utf8 inside strings? */
     unsigned int validateUTF8;
 
+    /* a structural index of indexText, when lexing a complete buffer.
+     * see yajl_lex_index_begin() */
+    yajl_index index;
+    const unsigned char * indexText;
+    /* the index has nothing to offer before here, see yajl_index_start().
+     * as far as it goes when there's no index */
+    size_t indexFrom;
+
     yajl_alloc_funcs * alloc;
 };
 
-#define readChar(lxr, txt, off)                      \
-    (((lxr)->bufInUse && yajl_buf_len((lxr)->buf) && lxr->bufOff < yajl_buf_len((lxr)->buf)) ? \
-     (*((const unsigned char *) yajl_buf_data((lxr)->buf) + ((lxr)->bufOff)++)) : \
-     ((txt)[(*(off))++]))
+#define readChar(txt, off) ((txt)[(*(off))++])
 
-#define unreadChar(lxr, off) ((*(off) > 0) ? (*(off))-- : ((lxr)->bufOff--))
+#define unreadChar(off) ((*(off))--)
 
 yajl_lexer
 yajl_lex_alloc(yajl_alloc_funcs * alloc,
@@ -109,6 +115,7 @@ yajl_lex_alloc(yajl_alloc_funcs * alloc,
     lxr->buf = yajl_buf_alloc(alloc);
     lxr->allowComments = allowComments;
     lxr->validateUTF8 = validateUTF8;
+    lxr->indexFrom = (size_t) -1;
     lxr->alloc = alloc;
     return lxr;
 }
@@ -117,6 +124,7 @@ void
 yajl_lex_free(yajl_lexer lxr)
 {
     yajl_buf_free(lxr->buf);
+    if (lxr->index) yajl_index_free(lxr->index);
     YA_FREE(lxr->alloc, lxr);
     return;
 }
@@ -202,27 +210,27 @@ yajl_lex_utf8_char(yajl_lexer lexer, const unsigned char * jsonText,
     } else if ((curChar >> 5) == 0x6) {
         /* two byte */
         UTF8_CHECK_EOF;
-        curChar = readChar(lexer, jsonText, offset);
+        curChar = readChar(jsonText, offset);
         if ((curChar >> 6) == 0x2) return yajl_tok_string;
     } else if ((curChar >> 4) == 0x0e) {
         /* three byte */
         UTF8_CHECK_EOF;
-        curChar = readChar(lexer, jsonText, offset);
+        curChar = readChar(jsonText, offset);
         if ((curChar >> 6) == 0x2) {
             UTF8_CHECK_EOF;
-            curChar = readChar(lexer, jsonText, offset);
+            curChar = readChar(jsonText, offset);
             if ((curChar >> 6) == 0x2) return yajl_tok_string;
         }
     } else if ((curChar >> 3) == 0x1e) {
         /* four byte */
         UTF8_CHECK_EOF;
-        curChar = readChar(lexer, jsonText, offset);
+        curChar = readChar(jsonText, offset);
         if ((curChar >> 6) == 0x2) {
             UTF8_CHECK_EOF;
-            curChar = readChar(lexer, jsonText, offset);
+            curChar = readChar(jsonText, offset);
             if ((curChar >> 6) == 0x2) {
                 UTF8_CHECK_EOF;
-                curChar = readChar(lexer, jsonText, offset);
+                curChar = readChar(jsonText, offset);
                 if ((curChar >> 6) == 0x2) return yajl_tok_string;
             }
         }
@@ -250,9 +258,15 @@ if (*offset >= jsonTextLen) { \
 /** scan a string for interesting characters that might need further
  *  review.  return the number of chars that are uninteresting and can
  *  be skipped.
- * (lth) hi world, any thoughts on how to make this routine faster? */
+ *
+ *  The bulk of the work is done 16 or 32 bytes at a time by
+ *  yajl_simd_string_scan(), the table driven loop below picks up
+ *  whatever tail is left over (or everything, when yajl is built
+ *  without SIMD support).  When validating UTF8, yajl_simd_utf8_scan()
+ *  also skips over well formed multibyte characters, leaving only
+ *  malformed or truncated ones for yajl_lex_utf8_char(). */
 static size_t
-yajl_string_scan(const unsigned char * buf, size_t len, int utf8check)
+yajl_string_scan_table(const unsigned char * buf, size_t len, int utf8check)
 {
     unsigned char mask = IJC|NFP|(utf8check ? NUC : 0);
     size_t skip = 0;
@@ -264,6 +278,37 @@ yajl_string_scan(const unsigned char * buf, size_t len, int utf8check)
     return skip;
 }
 
+static size_t
+yajl_string_scan(const unsigned char * buf, size_t len, int utf8check)
+{
+    size_t skip = 0;
+
+    if (utf8check) {
+        skip = yajl_simd_utf8_scan(buf, len);
+#ifdef DEBUG
+        /* debug builds verify that everything skipped is valid UTF8
+         * without any interesting ASCII */
+        assert(skip <= yajl_string_scan_table(buf, len, 0));
+        assert(yajl_string_validate_utf8(buf, skip));
+#endif
+        return skip;
+    }
+
+    if (len >= YAJL_SIMD_BLOCK) {
+        skip = yajl_simd_string_scan(buf, len, utf8check);
+    }
+    if (skip < len) {
+        skip += yajl_string_scan_table(buf + skip, len - skip, utf8check);
+    }
+
+#ifdef DEBUG
+    /* debug builds verify the vectorized scan against the table */
+    assert(skip == yajl_string_scan_table(buf, len, utf8check));
+#endif
+
+    return skip;
+}
+
 static yajl_tok
 yajl_lex_string(yajl_lexer lexer, const unsigned char * jsonText,
                 size_t jsonTextLen, size_t * offset)
@@ -275,30 +320,16 @@ yajl_lex_string(yajl_lexer lexer, const unsigned char * jsonText,
         unsigned char curChar;
 
         /* now jump into a faster scanning routine to skip as much
-         * of the buffers as possible */
-        {
-            const unsigned char * p;
-            size_t len;
-
-            if ((lexer->bufInUse && yajl_buf_len(lexer->buf) &&
-                 lexer->bufOff < yajl_buf_len(lexer->buf)))
-            {
-                p = ((const unsigned char *) yajl_buf_data(lexer->buf) +
-                     (lexer->bufOff));
-                len = yajl_buf_len(lexer->buf) - lexer->bufOff;
-                lexer->bufOff += yajl_string_scan(p, len, lexer->validateUTF8);
-            }
-            else if (*offset < jsonTextLen)
-            {
-                p = jsonText + *offset;
-                len = jsonTextLen - *offset;
-                *offset += yajl_string_scan(p, len, lexer->validateUTF8);
-            }
+         * of the buffer as possible */
+        if (*offset < jsonTextLen) {
+            *offset += yajl_string_scan(jsonText + *offset,
+                                        jsonTextLen - *offset,
+                                        lexer->validateUTF8);
         }
 
         STR_CHECK_EOF;
 
-        curChar = readChar(lexer, jsonText, offset);
+        curChar = readChar(jsonText, offset);
 
         /* quote terminates */
         if (curChar == '"') {
@@ -311,23 +342,23 @@ yajl_lex_string(yajl_lexer lexer, const unsigned char * jsonText,
             STR_CHECK_EOF;
 
             /* special case \u */
-            curChar = readChar(lexer, jsonText, offset);
+            curChar = readChar(jsonText, offset);
             if (curChar == 'u') {
                 unsigned int i = 0;
 
                 for (i=0;i<4;i++) {
                     STR_CHECK_EOF;
-                    curChar = readChar(lexer, jsonText, offset);
+                    curChar = readChar(jsonText, offset);
                     if (!(charLookupTable[curChar] & VHC)) {
                         /* back up to offending char */
-                        unreadChar(lexer, offset);
+                        unreadChar(offset);
                         lexer->error = yajl_lex_string_invalid_hex_char;
                         goto finish_string_lex;
                     }
                 }
             } else if (!(charLookupTable[curChar] & VEC)) {
                 /* back up to offending char */
-                unreadChar(lexer, offset);
+                unreadChar(offset);
                 lexer->error = yajl_lex_string_invalid_escaped_char;
                 goto finish_string_lex;
             }
@@ -336,7 +367,7 @@ yajl_lex_string(yajl_lexer lexer, const unsigned char * jsonText,
          * if the present character is invalid */
         else if(charLookupTable[curChar] & IJC) {
             /* back up to offending char */
-            unreadChar(lexer, offset);
+            unreadChar(offset);
             lexer->error = yajl_lex_string_invalid_json_char;
             goto finish_string_lex;
         }
@@ -380,25 +411,25 @@ yajl_lex_number(yajl_lexer lexer, const unsigned char * jsonText,
     yajl_tok tok = yajl_tok_integer;
 
     RETURN_IF_EOF;
-    c = readChar(lexer, jsonText, offset);
+    c = readChar(jsonText, offset);
 
     /* optional leading minus */
     if (c == '-') {
         RETURN_IF_EOF;
-        c = readChar(lexer, jsonText, offset);
+        c = readChar(jsonText, offset);
     }
 
     /* a single zero, or a series of integers */
     if (c == '0') {
         RETURN_IF_EOF;
-        c = readChar(lexer, jsonText, offset);
+        c = readChar(jsonText, offset);
     } else if (c >= '1' && c <= '9') {
         do {
             RETURN_IF_EOF;
-            c = readChar(lexer, jsonText, offset);
+            c = readChar(jsonText, offset);
         } while (c >= '0' && c <= '9');
     } else {
-        unreadChar(lexer, offset);
+        unreadChar(offset);
         lexer->error = yajl_lex_missing_integer_after_minus;
         return yajl_tok_error;
     }
@@ -408,16 +439,16 @@ yajl_lex_number(yajl_lexer lexer, const unsigned char * jsonText,
         int numRd = 0;
 
         RETURN_IF_EOF;
-        c = readChar(lexer, jsonText, offset);
+        c = readChar(jsonText, offset);
 
         while (c >= '0' && c <= '9') {
             numRd++;
             RETURN_IF_EOF;
-            c = readChar(lexer, jsonText, offset);
+            c = readChar(jsonText, offset);
         }
 
         if (!numRd) {
-            unreadChar(lexer, offset);
+            unreadChar(offset);
             lexer->error = yajl_lex_missing_integer_after_decimal;
             return yajl_tok_error;
         }
@@ -427,21 +458,21 @@ yajl_lex_number(yajl_lexer lexer, const unsigned char * jsonText,
     /* optional exponent (indicates this is floating point) */
     if (c == 'e' || c == 'E') {
         RETURN_IF_EOF;
-        c = readChar(lexer, jsonText, offset);
+        c = readChar(jsonText, offset);
 
         /* optional sign */
         if (c == '+' || c == '-') {
             RETURN_IF_EOF;
-            c = readChar(lexer, jsonText, offset);
+            c = readChar(jsonText, offset);
         }
 
         if (c >= '0' && c <= '9') {
             do {
                 RETURN_IF_EOF;
-                c = readChar(lexer, jsonText, offset);
+                c = readChar(jsonText, offset);
             } while (c >= '0' && c <= '9');
         } else {
-            unreadChar(lexer, offset);
+            unreadChar(offset);
             lexer->error = yajl_lex_missing_integer_after_exponent;
             return yajl_tok_error;
         }
@@ -449,7 +480,7 @@ yajl_lex_number(yajl_lexer lexer, const unsigned char * jsonText,
     }
 
     /* we always go "one too far" */
-    unreadChar(lexer, offset);
+    unreadChar(offset);
 
     return tok;
 }
@@ -463,27 +494,27 @@ yajl_lex_comment(yajl_lexer lexer, const unsigned char * jsonText,
     yajl_tok tok = yajl_tok_comment;
 
     RETURN_IF_EOF;
-    c = readChar(lexer, jsonText, offset);
+    c = readChar(jsonText, offset);
 
     /* either slash or star expected */
     if (c == '/') {
         /* now we throw away until end of line */
         do {
             RETURN_IF_EOF;
-            c = readChar(lexer, jsonText, offset);
+            c = readChar(jsonText, offset);
         } while (c != '\n');
     } else if (c == '*') {
         /* now we throw away until end of comment */
         for (;;) {
             RETURN_IF_EOF;
-            c = readChar(lexer, jsonText, offset);
+            c = readChar(jsonText, offset);
             if (c == '*') {
                 RETURN_IF_EOF;
-                c = readChar(lexer, jsonText, offset);
+                c = readChar(jsonText, offset);
                 if (c == '/') {
                     break;
                 } else {
-                    unreadChar(lexer, offset);
+                    unreadChar(offset);
                 }
             }
         }
@@ -495,126 +526,160 @@ yajl_lex_comment(yajl_lexer lexer, const unsigned char * jsonText,
     return tok;
 }
 
-yajl_tok
-yajl_lex_lex(yajl_lexer lexer, const unsigned char * jsonText,
-             size_t jsonTextLen, size_t * offset,
-             const unsigned char ** outBuf, size_t * outLen)
+void
+yajl_lex_index_begin(yajl_lexer lexer, const unsigned char * jsonText,
+                     size_t jsonTextLen)
+{
+    /* comments would hide quotes from the index, and a token carried
+     * over from an earlier chunk might leave us inside a string */
+    if (lexer->allowComments || lexer->bufInUse) return;
+    if (lexer->index == NULL) lexer->index = yajl_index_alloc(lexer->alloc);
+    yajl_index_reset(lexer->index, jsonText, jsonTextLen,
+                     lexer->validateUTF8);
+    lexer->indexText = jsonText;
+    lexer->indexFrom = 0;
+}
+
+void
+yajl_lex_index_end(yajl_lexer lexer)
+{
+    lexer->indexText = NULL;
+    lexer->indexFrom = (size_t) -1;
+}
+
+#define yajl_lex_is_space(c) ((c) == ' ' || ((c) >= 0x09 && (c) <= 0x0d))
+
+/* lex one token out of contiguous text, skipping any whitespace and
+ * comments in front of it.  On return *startOffset is where the token
+ * (or, on eof, what there is of it) begins. */
+static yajl_tok
+yajl_lex_token(yajl_lexer lexer, const unsigned char * jsonText,
+               size_t jsonTextLen, size_t * offset, size_t * startOffset)
 {
     yajl_tok tok = yajl_tok_error;
     unsigned char c;
-    size_t startOffset = *offset;
 
-    *outBuf = NULL;
-    *outLen = 0;
+    /* with an index we can skip whitespace in one go, and take clean
+     * strings whole.  everything else is lexed as usual */
+    if (*offset >= lexer->indexFrom && jsonText == lexer->indexText) {
+        /* a lone space is cheaper to step over than to look up */
+        if (*offset + 1 < jsonTextLen &&
+            yajl_lex_is_space(jsonText[*offset]))
+        {
+            if (yajl_lex_is_space(jsonText[*offset + 1])) {
+                *offset = yajl_index_seek(lexer->index, *offset);
+                /* it stopped short, and may have gone dormant */
+                if (*offset < jsonTextLen &&
+                    yajl_lex_is_space(jsonText[*offset]))
+                {
+                    lexer->indexFrom = yajl_index_start(lexer->index);
+                }
+            } else {
+                *offset += 1;
+            }
+            *startOffset = *offset;
+        }
+        if (*offset < jsonTextLen && jsonText[*offset] == '"') {
+            size_t end = yajl_index_string_end(lexer->index, *offset);
+            if (end) {
+                *offset = end + 1;
+                return yajl_tok_string;
+            }
+            lexer->indexFrom = yajl_index_start(lexer->index);
+        }
+    }
 
     for (;;) {
         assert(*offset <= jsonTextLen);
 
         if (*offset >= jsonTextLen) {
-            tok = yajl_tok_eof;
-            goto lexed;
+            return yajl_tok_eof;
         }
 
-        c = readChar(lexer, jsonText, offset);
+        c = readChar(jsonText, offset);
 
         switch (c) {
             case '{':
-                tok = yajl_tok_left_bracket;
-                goto lexed;
+                return yajl_tok_left_bracket;
             case '}':
-                tok = yajl_tok_right_bracket;
-                goto lexed;
+                return yajl_tok_right_bracket;
             case '[':
-                tok = yajl_tok_left_brace;
-                goto lexed;
+                return yajl_tok_left_brace;
             case ']':
-                tok = yajl_tok_right_brace;
-                goto lexed;
+                return yajl_tok_right_brace;
             case ',':
-                tok = yajl_tok_comma;
-                goto lexed;
+                return yajl_tok_comma;
             case ':':
-                tok = yajl_tok_colon;
-                goto lexed;
+                return yajl_tok_colon;
             case '\t': case '\n': case '\v': case '\f': case '\r': case ' ':
-                startOffset++;
+                (*startOffset)++;
                 break;
             case 't': {
                 const char * want = "rue";
                 do {
                     if (*offset >= jsonTextLen) {
-                        tok = yajl_tok_eof;
-                        goto lexed;
+                        return yajl_tok_eof;
                     }
-                    c = readChar(lexer, jsonText, offset);
+                    c = readChar(jsonText, offset);
                     if (c != *want) {
-                        unreadChar(lexer, offset);
+                        unreadChar(offset);
                         lexer->error = yajl_lex_invalid_string;
-                        tok = yajl_tok_error;
-                        goto lexed;
+                        return yajl_tok_error;
                     }
                 } while (*(++want));
-                tok = yajl_tok_bool;
-                goto lexed;
+                return yajl_tok_bool;
             }
             case 'f': {
                 const char * want = "alse";
                 do {
                     if (*offset >= jsonTextLen) {
-                        tok = yajl_tok_eof;
-                        goto lexed;
+                        return yajl_tok_eof;
                     }
-                    c = readChar(lexer, jsonText, offset);
+                    c = readChar(jsonText, offset);
                     if (c != *want) {
-                        unreadChar(lexer, offset);
+                        unreadChar(offset);
                         lexer->error = yajl_lex_invalid_string;
-                        tok = yajl_tok_error;
-                        goto lexed;
+                        return yajl_tok_error;
                     }
                 } while (*(++want));
-                tok = yajl_tok_bool;
-                goto lexed;
+                return yajl_tok_bool;
             }
             case 'n': {
                 const char * want = "ull";
                 do {
                     if (*offset >= jsonTextLen) {
-                        tok = yajl_tok_eof;
-                        goto lexed;
+                        return yajl_tok_eof;
                     }
-                    c = readChar(lexer, jsonText, offset);
+                    c = readChar(jsonText, offset);
                     if (c != *want) {
-                        unreadChar(lexer, offset);
+                        unreadChar(offset);
                         lexer->error = yajl_lex_invalid_string;
-                        tok = yajl_tok_error;
-                        goto lexed;
+                        return yajl_tok_error;
                     }
                 } while (*(++want));
-                tok = yajl_tok_null;
-                goto lexed;
+                return yajl_tok_null;
             }
             case '"': {
                 tok = yajl_lex_string(lexer, (const unsigned char *) jsonText,
                                       jsonTextLen, offset);
-                goto lexed;
+                return tok;
             }
             case '-':
             case '0': case '1': case '2': case '3': case '4':
             case '5': case '6': case '7': case '8': case '9': {
                 /* integer parsing wants to start from the beginning */
-                unreadChar(lexer, offset);
+                unreadChar(offset);
                 tok = yajl_lex_number(lexer, (const unsigned char *) jsonText,
                                       jsonTextLen, offset);
-                goto lexed;
+                return tok;
             }
             case '/':
                 /* hey, look, a probable comment!  If comments are disabled
                  * it's an error. */
                 if (!lexer->allowComments) {
-                    unreadChar(lexer, offset);
+                    unreadChar(offset);
                     lexer->error = yajl_lex_unallowed_comment;
-                    tok = yajl_tok_error;
-                    goto lexed;
+                    return yajl_tok_error;
                 }
                 /* if comments are enabled, then we should try to lex
                  * the thing.  possible outcomes are
@@ -628,38 +693,108 @@ yajl_lex_lex(yajl_lexer lexer, const unsigned char * jsonText,
                     /* "error" is silly, but that's the initial
                      * state of tok.  guilty until proven innocent. */
                     tok = yajl_tok_error;
-                    yajl_buf_clear(lexer->buf);
-                    lexer->bufInUse = 0;
-                    startOffset = *offset;
+                    *startOffset = *offset;
                     break;
                 }
                 /* hit error or eof, bail */
-                goto lexed;
+                return tok;
             default:
                 lexer->error = yajl_lex_invalid_char;
-                tok = yajl_tok_error;
-                goto lexed;
+                return yajl_tok_error;
         }
     }
 
 
-  lexed:
-    /* need to append to buffer if the buffer is in use or
-     * if it's an EOF token */
-    if (tok == yajl_tok_eof || lexer->bufInUse) {
-        if (!lexer->bufInUse) yajl_buf_clear(lexer->buf);
-        lexer->bufInUse = 1;
-        yajl_buf_append(lexer->buf, jsonText + startOffset, *offset - startOffset);
-        lexer->bufOff = 0;
+}
+
+/* finish lexing a token which the end of the last chunk cut short.  The
+ * start of it is in the lexBuf.  Most tokens are short, so rather than
+ * copy the whole chunk we append a little at a time (64 bytes, or as
+ * much as we already have, doubling after that) until the token is
+ * complete.  Returns yajl_tok_comment when the token turns out to start
+ * in jsonText (after a comment which spanned the chunks), in which case
+ * lexing should carry on there from *offset. */
+static yajl_tok
+yajl_lex_stitch(yajl_lexer lexer, const unsigned char * jsonText,
+                size_t jsonTextLen, size_t * offset, size_t * startOffset)
+{
+    size_t prevLen = yajl_buf_len(lexer->buf);
+    size_t step = prevLen > 64 ? prevLen : 64;
+    size_t taken = 0, bufOff;
+    yajl_tok tok;
+
+    for (;;) {
+        size_t n = jsonTextLen - *offset - taken;
+        if (n > step) n = step;
+        yajl_buf_append(lexer->buf, jsonText + *offset + taken, n);
+        taken += n;
+
+        bufOff = *startOffset = 0;
+        tok = yajl_lex_token(lexer, yajl_buf_data(lexer->buf),
+                             yajl_buf_len(lexer->buf), &bufOff, startOffset);
+        if (tok != yajl_tok_eof || *offset + taken >= jsonTextLen) break;
+        step *= 2;
+    }
+
+    if (*startOffset >= prevLen) {
+        /* nothing left of the split token, go again on jsonText */
+        *offset += *startOffset - prevLen;
+        yajl_buf_clear(lexer->buf);
+        lexer->bufInUse = 0;
+        return yajl_tok_comment;
+    } else if (tok == yajl_tok_eof) {
+        /* still split, lexBuf now holds all of jsonText */
+        *offset = jsonTextLen;
+        return tok;
+    }
+
+    /* on error we may have backed up to the start of this chunk, but
+     * no further */
+    *offset += (bufOff > prevLen) ? bufOff - prevLen : 0;
+    yajl_buf_truncate(lexer->buf, bufOff);
+    lexer->bufInUse = 0;
+    return tok;
+}
 
-        if (tok != yajl_tok_eof) {
-            *outBuf = yajl_buf_data(lexer->buf);
-            *outLen = yajl_buf_len(lexer->buf);
-            lexer->bufInUse = 0;
+yajl_tok
+yajl_lex_lex(yajl_lexer lexer, const unsigned char * jsonText,
+             size_t jsonTextLen, size_t * offset,
+             const unsigned char ** outBuf, size_t * outLen)
+{
+    yajl_tok tok = yajl_tok_comment;
+    size_t startOffset = *offset;
+
+    *outBuf = NULL;
+    *outLen = 0;
+
+    if (lexer->bufInUse) {
+        tok = yajl_lex_stitch(lexer, jsonText, jsonTextLen, offset,
+                              &startOffset);
+        if (tok != yajl_tok_comment && tok != yajl_tok_error &&
+            tok != yajl_tok_eof)
+        {
+            *outBuf = yajl_buf_data(lexer->buf) + startOffset;
+            *outLen = yajl_buf_len(lexer->buf) - startOffset;
+        }
+    }
+
+    if (tok == yajl_tok_comment) {
+        startOffset = *offset;
+        tok = yajl_lex_token(lexer, jsonText, jsonTextLen, offset,
+                             &startOffset);
+
+        if (tok == yajl_tok_eof) {
+            /* hang on to what we have of a token split across chunks */
+            if (startOffset < jsonTextLen) {
+                yajl_buf_clear(lexer->buf);
+                yajl_buf_append(lexer->buf, jsonText + startOffset,
+                                jsonTextLen - startOffset);
+                lexer->bufInUse = 1;
+            }
+        } else if (tok != yajl_tok_error) {
+            *outBuf = jsonText + startOffset;
+            *outLen = *offset - startOffset;
         }
-    } else if (tok != yajl_tok_error) {
-        *outBuf = jsonText + startOffset;
-        *outLen = *offset - startOffset;
     }
 
     /* special case for strings. skip the quotes. */
@@ -741,23 +876,3 @@ size_t yajl_lex_current_char(yajl_lexer lexer)
 {
     return lexer->charOff;
 }
-
-yajl_tok yajl_lex_peek(yajl_lexer lexer, const unsigned char * jsonText,
-                       size_t jsonTextLen, size_t offset)
-{
-    const unsigned char * outBuf;
-    size_t outLen;
-    size_t bufLen = yajl_buf_len(lexer->buf);
-    size_t bufOff = lexer->bufOff;
-    unsigned int bufInUse = lexer->bufInUse;
-    yajl_tok tok;
-
-    tok = yajl_lex_lex(lexer, jsonText, jsonTextLen, &offset,
-                       &outBuf, &outLen);
-
-    lexer->bufOff = bufOff;
-    lexer->bufInUse = bufInUse;
-    yajl_buf_truncate(lexer->buf, bufLen);
-
-    return tok;
-}
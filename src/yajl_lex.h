@@ -79,9 +79,15 @@ yajl_tok yajl_lex_lex(yajl_lexer lexer, const unsigned char * jsonText,
                       size_t jsonTextLen, size_t * offset,
                       const unsigned char ** outBuf, size_t * outLen);
 
-/** have a peek at the next token, but don't move the lexer forward */
-yajl_tok yajl_lex_peek(yajl_lexer lexer, const unsigned char * jsonText,
-                       size_t jsonTextLen, size_t offset);
+/** index a complete json text before lexing it.  Until
+ *  yajl_lex_index_end() is called, yajl_lex_lex() uses the index whenever
+ *  it's passed this same text.  This is an optimization only, so it's
+ *  quietly skipped when comments are allowed, or when a token from an
+ *  earlier chunk is incomplete. */
+void yajl_lex_index_begin(yajl_lexer lexer, const unsigned char * jsonText,
+                          size_t jsonTextLen);
+
+void yajl_lex_index_end(yajl_lexer lexer);
 
 
 typedef enum {
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Conversion between JSON number tokens and machine numbers.  Parsing
+ * works directly on the token as the lexer hands it over (no
+ * terminating NUL is needed), and neither direction depends on the
+ * current locale.
+ */
+
+#ifndef __YAJL_NUMBER_H__
+#define __YAJL_NUMBER_H__
+
+#include <stddef.h>
+
+/* convert a number token to the nearest double (ties to even).  Same
+ * semantics as strtod: on overflow HUGE_VAL (with the sign of the
+ * number) is returned, and on underflow to zero a zero, and in both
+ * cases errno is set to ERANGE.  The token must be a JSON number as
+ * checked by the lexer. */
+double yajl_parse_double(const unsigned char * number, size_t length);
+
+/* A little built in integer parsing routine with the same semantics as
+ * strtol that's unaffected by LOCALE.  On overflow (or a character that
+ * isn't a digit) errno is set to ERANGE and LLONG_MAX or LLONG_MIN is
+ * returned. */
+long long yajl_parse_integer(const unsigned char * number, size_t length);
+
+/* the most bytes yajl_format_integer() will write, terminating NUL
+ * included */
+#define YAJL_INTEGER_BUF_SIZE 21
+
+/* format an integer, returning the length of the string written to
+ * buf */
+size_t yajl_format_integer(long long number, char * buf);
+
+/* the most bytes yajl_format_double() will write, terminating NUL
+ * included */
+#define YAJL_DOUBLE_BUF_SIZE 32
+
+/* format a finite double for JSON output.  With precision zero, the
+ * shortest digit string which parses back to the same double is used,
+ * otherwise the number is rounded to that many (1 to 17) significant
+ * digits, unless that would carry it past DBL_MAX.  Numbers from 1e-6 up to 1e21 are written without an
+ * exponent, and integral values get a trailing ".0" so they read back
+ * as doubles.  Returns the length of the string written to buf. */
+size_t yajl_format_double(double d, int precision, char * buf);
+
+#endif
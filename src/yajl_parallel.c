@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The text is cut into pieces just after newlines, and parsed in two
+ * passes, each spreading the pieces over the threads.
+ *
+ * To know where the documents are, a piece needs to know how deeply
+ * nested its start is.  The first pass measures how each piece changes
+ * the nesting, which is quick, and the depth at the start of each piece
+ * is worked out from that.  Whether a piece starts inside a string needn't
+ * be measured: a newline can't be in a string, so for splitting purposes
+ * a newline always ends one.
+ *
+ * The second pass finds the documents which start in each piece, finishing
+ * the last one even if it runs on into the next piece, and parses them.
+ */
+
+#include "api/yajl_parallel.h"
+
+#include "yajl_alloc.h"
+#include "yajl_simd.h"
+#include "yajl_tree_builder.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef YAJL_HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* pieces smaller than this aren't worth a thread's while */
+#define YAJL_PIECE_MIN (64 * 1024)
+/* how many pieces to cut for each thread, so that a slow piece doesn't
+ * hold the others up */
+#define YAJL_PIECES_PER_THREAD 8
+
+typedef struct {
+    size_t offset;
+    size_t len;
+    yajl_val doc;
+    char * error;
+} yajl_doc_result;
+
+typedef struct {
+    /* from just after a newline to just after the next piece's */
+    size_t start;
+    size_t end;
+    /* how the piece changes the nesting, and the lowest it takes it,
+     * relative to its start.  Then the depth at its start */
+    ptrdiff_t net;
+    ptrdiff_t low;
+    size_t depth;
+    /* when ordered, the piece's documents until they're delivered */
+    yajl_doc_result * docs;
+    size_t count;
+    size_t size;
+    int parsed;
+    /* set once the piece is next to be delivered */
+    int head;
+} yajl_piece;
+
+typedef struct {
+    const unsigned char * text;
+    size_t len;
+    unsigned int options;
+    unsigned int treeOptions;
+    unsigned int parseOptions;
+    yajl_parallel_callback callback;
+    void * ctx;
+    yajl_alloc_funcs alloc;
+
+    yajl_piece * pieces;
+    size_t count;
+    /* non-zero during the first pass */
+    int measuring;
+    /* the next piece to take, and (when ordered) to deliver */
+    size_t next;
+    size_t delivered;
+    /* how far ahead of delivery parsing may get, when ordered */
+    size_t window;
+    int delivering;
+    int canceled;
+    int failed;
+#ifdef YAJL_HAVE_PTHREAD
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_mutex_t deliverLock;
+#endif
+} yajl_parallel;
+
+#ifdef YAJL_HAVE_PTHREAD
+#  define yajl_parallel_lock(p) pthread_mutex_lock(&((p)->lock))
+#  define yajl_parallel_unlock(p) pthread_mutex_unlock(&((p)->lock))
+#  define yajl_parallel_wait(p) pthread_cond_wait(&((p)->cond), &((p)->lock))
+#  define yajl_parallel_wake(p) pthread_cond_broadcast(&((p)->cond))
+#else
+#  define yajl_parallel_lock(p)
+#  define yajl_parallel_unlock(p)
+#  define yajl_parallel_wait(p)
+#  define yajl_parallel_wake(p)
+#endif
+
+/* what the splitter stops at, outside of strings */
+static const unsigned char splitStops[256] = {
+    /*       0 1 2 3 4 5 6 7 8 9 a b c d e f */
+    /* 0 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 1 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 2 */  0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 3 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 4 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 5 */  0,0,0,0,0,0,0,0,0,0,0,1,0,1,0,0,
+    /* 6 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 7 */  0,0,0,0,0,0,0,0,0,0,0,1,0,1,0,0
+};
+
+#define yajl_split_is_space(c) ((c) == ' ' || ((c) >= 0x09 && (c) <= 0x0d))
+
+typedef struct {
+    ptrdiff_t depth;
+    ptrdiff_t low;
+    int inString;
+    /* non-zero to keep depth from going below zero */
+    int clamp;
+} yajl_split_state;
+
+/* follow the nesting of text from off to end.  With untilTop, stop just
+ * after whatever brings us back to the top level: a closing bracket, or
+ * the end of a string */
+static size_t
+yajl_split_scan(const unsigned char * text, size_t off, size_t end,
+                yajl_split_state * s, int untilTop)
+{
+    unsigned char c;
+
+    while (off < end) {
+        if (s->inString) {
+            off += yajl_simd_string_scan(text + off, end - off, 0);
+            if (off == end) break;
+            c = text[off++];
+            if (c == '\\') {
+                if (off < end && text[off] != '\n') off++;
+                continue;
+            }
+            if (c != '"' && c != '\n') continue;
+            s->inString = 0;
+        } else {
+            while (off < end && !splitStops[text[off]]) off++;
+            if (off == end) break;
+            c = text[off++];
+            if (c == '"') {
+                s->inString = 1;
+                continue;
+            } else if (c == '{' || c == '[') {
+                s->depth++;
+                continue;
+            }
+            if (s->depth > 0 || !s->clamp) s->depth--;
+            if (s->depth < s->low) s->low = s->depth;
+        }
+        if (untilTop && s->depth == 0 && !s->inString) break;
+    }
+    return off;
+}
+
+/* the first pass */
+static void
+yajl_piece_measure(yajl_parallel * p, yajl_piece * piece)
+{
+    yajl_split_state s;
+
+    memset(&s, 0, sizeof(s));
+    yajl_split_scan(p->text, piece->start, piece->end, &s, 0);
+    piece->net = s.depth;
+    piece->low = s.low;
+}
+
+static int
+yajl_parallel_canceled(yajl_parallel * p)
+{
+    int canceled;
+
+    yajl_parallel_lock(p);
+    canceled = p->canceled;
+    yajl_parallel_unlock(p);
+    return canceled;
+}
+
+/* free a document's tree, which from an arena goes through its root */
+static void
+yajl_parallel_free_doc(yajl_parallel * p, yajl_val doc)
+{
+    if (p->treeOptions & yajl_tree_arena) yajl_tree_free_root(doc);
+    else yajl_tree_free(doc);
+}
+
+/* hand a document to the callback, and forget it */
+static void
+yajl_parallel_deliver(yajl_parallel * p, yajl_doc_result * r)
+{
+    if (!yajl_parallel_canceled(p) &&
+        !p->callback(p->ctx, r->offset, r->len, r->doc, r->error))
+    {
+        yajl_parallel_lock(p);
+        p->canceled = 1;
+        yajl_parallel_wake(p);
+        yajl_parallel_unlock(p);
+    }
+    if (r->doc) yajl_parallel_free_doc(p, r->doc);
+    if (r->error) YA_FREE(&(p->alloc), r->error);
+}
+
+/* deliver what's been parsed, in order.  called and returns with the
+ * lock held */
+static void
+yajl_parallel_deliver_ordered(yajl_parallel * p)
+{
+    if (p->delivering) return;
+    p->delivering = 1;
+    while (p->delivered < p->count && p->pieces[p->delivered].parsed) {
+        yajl_piece * piece = p->pieces + p->delivered;
+        size_t i;
+
+        yajl_parallel_unlock(p);
+        for (i = 0; i < piece->count; i++) {
+            yajl_parallel_deliver(p, piece->docs + i);
+        }
+        piece->count = 0;
+        yajl_parallel_lock(p);
+        p->delivered++;
+        yajl_parallel_wake(p);
+    }
+    p->delivering = 0;
+}
+
+static void
+yajl_piece_add(yajl_parallel * p, yajl_piece * piece,
+               yajl_tree_builder builder, size_t start, size_t end)
+{
+    yajl_doc_result r;
+    char err[256];
+
+    r.offset = start;
+    r.len = end - start;
+    r.error = NULL;
+    r.doc = yajl_tree_builder_parse(builder, p->text + start, end - start,
+                                    err, sizeof(err));
+    if (r.doc == NULL) {
+        size_t l = strlen(err) + 1;
+        r.error = (char *) YA_MALLOC(&(p->alloc), l);
+        if (r.error) memcpy(r.error, err, l);
+    }
+
+    if (!(p->options & yajl_parallel_ordered)) {
+#ifdef YAJL_HAVE_PTHREAD
+        pthread_mutex_lock(&(p->deliverLock));
+#endif
+        yajl_parallel_deliver(p, &r);
+#ifdef YAJL_HAVE_PTHREAD
+        pthread_mutex_unlock(&(p->deliverLock));
+#endif
+        return;
+    }
+
+    /* once everything in front of the piece has been delivered, nothing
+     * else is delivering, and its documents needn't wait */
+    if (!piece->head) {
+        yajl_parallel_lock(p);
+        piece->head = p->delivered == (size_t) (piece - p->pieces);
+        yajl_parallel_unlock(p);
+    }
+    if (piece->head) {
+        size_t i;
+        for (i = 0; i < piece->count; i++) {
+            yajl_parallel_deliver(p, piece->docs + i);
+        }
+        piece->count = 0;
+        yajl_parallel_deliver(p, &r);
+        return;
+    }
+
+    if (piece->count == piece->size) {
+        size_t size = piece->size ? piece->size * 2 : 64;
+        yajl_doc_result * docs = (yajl_doc_result *)
+            YA_REALLOC(&(p->alloc), piece->docs,
+                       size * sizeof(yajl_doc_result));
+        if (docs == NULL) {
+            if (r.doc) yajl_parallel_free_doc(p, r.doc);
+            if (r.error) YA_FREE(&(p->alloc), r.error);
+            yajl_parallel_lock(p);
+            p->failed = p->canceled = 1;
+            yajl_parallel_wake(p);
+            yajl_parallel_unlock(p);
+            return;
+        }
+        piece->docs = docs;
+        piece->size = size;
+    }
+    piece->docs[piece->count++] = r;
+}
+
+/* the second pass: parse the documents which start in the piece */
+static void
+yajl_piece_parse(yajl_parallel * p, yajl_piece * piece,
+                 yajl_tree_builder builder)
+{
+    const unsigned char * text = p->text;
+    size_t off = piece->start;
+    yajl_split_state s;
+
+    memset(&s, 0, sizeof(s));
+    s.clamp = 1;
+
+    /* finish off a document which started in an earlier piece */
+    if (piece->depth > 0) {
+        s.depth = (ptrdiff_t) piece->depth;
+        off = yajl_split_scan(text, off, p->len, &s, 1);
+    }
+
+    while (!yajl_parallel_canceled(p)) {
+        size_t start;
+        unsigned char c;
+
+        while (off < piece->end && yajl_split_is_space(text[off])) off++;
+        if (off >= piece->end) break;
+
+        start = off;
+        c = text[off];
+        if (c == '{' || c == '[' || c == '}' || c == ']' || c == '"') {
+            off = yajl_split_scan(text, off, p->len, &s, 1);
+        } else {
+            /* a number or a literal, or garbage */
+            while (off < p->len && !yajl_split_is_space(text[off]) &&
+                   !splitStops[text[off]])
+            {
+                off++;
+            }
+        }
+        yajl_piece_add(p, piece, builder, start, off);
+    }
+
+    if (p->options & yajl_parallel_ordered) {
+        yajl_parallel_lock(p);
+        piece->parsed = 1;
+        yajl_parallel_deliver_ordered(p);
+        yajl_parallel_unlock(p);
+    }
+}
+
+static void *
+yajl_parallel_work(void * arg)
+{
+    yajl_parallel * p = (yajl_parallel *) arg;
+    /* each thread parses its documents with a parser of its own */
+    yajl_tree_builder builder = NULL;
+
+    if (!p->measuring) {
+        builder = yajl_tree_builder_alloc(p->treeOptions, p->parseOptions);
+        if (builder == NULL) {
+            yajl_parallel_lock(p);
+            p->failed = p->canceled = 1;
+            yajl_parallel_wake(p);
+            yajl_parallel_unlock(p);
+            return NULL;
+        }
+    }
+
+    for (;;) {
+        yajl_piece * piece;
+
+        yajl_parallel_lock(p);
+        /* when ordered, don't let parsed documents pile up behind a
+         * slow piece */
+        while (!p->measuring && !p->canceled &&
+               (p->options & yajl_parallel_ordered) &&
+               p->next < p->count && p->next >= p->delivered + p->window)
+        {
+            yajl_parallel_wait(p);
+        }
+        if (p->canceled || p->next == p->count) {
+            yajl_parallel_unlock(p);
+            break;
+        }
+        piece = p->pieces + p->next++;
+        yajl_parallel_unlock(p);
+
+        if (p->measuring) yajl_piece_measure(p, piece);
+        else yajl_piece_parse(p, piece, builder);
+    }
+    if (builder) yajl_tree_builder_free(builder);
+    return NULL;
+}
+
+/* run a pass on the calling thread and threads - 1 others */
+static void
+yajl_parallel_pass(yajl_parallel * p, unsigned int threads)
+{
+#ifdef YAJL_HAVE_PTHREAD
+    pthread_t tids[64];
+    unsigned int i, started = 0;
+
+    if (threads > sizeof(tids) / sizeof(tids[0])) {
+        threads = sizeof(tids) / sizeof(tids[0]);
+    }
+    p->next = 0;
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(tids + started, NULL, yajl_parallel_work, p)) {
+            break;
+        }
+        started++;
+    }
+    yajl_parallel_work(p);
+    for (i = 0; i < started; i++) pthread_join(tids[i], NULL);
+#else
+    (void) threads;
+    p->next = 0;
+    yajl_parallel_work(p);
+#endif
+}
+
+yajl_status
+yajl_parse_parallel(const unsigned char * text, size_t len,
+                    unsigned int threads, unsigned int options,
+                    unsigned int treeOptions, unsigned int parseOptions,
+                    yajl_parallel_callback callback, void * ctx)
+{
+    yajl_parallel p;
+    size_t i;
+
+    memset(&p, 0, sizeof(p));
+    p.text = text;
+    p.len = len;
+    p.options = options;
+    p.treeOptions = treeOptions;
+    p.parseOptions = parseOptions & yajl_dont_validate_strings;
+    p.callback = callback;
+    p.ctx = ctx;
+    yajl_set_default_alloc_funcs(&(p.alloc));
+
+#ifdef YAJL_HAVE_PTHREAD
+    if (threads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (unsigned int) n : 1;
+    }
+#else
+    threads = 1;
+#endif
+
+    /* one thread may as well take the text in one piece */
+    p.count = threads > 1 ? len / YAJL_PIECE_MIN : 1;
+    if (p.count > threads * YAJL_PIECES_PER_THREAD) {
+        p.count = threads * YAJL_PIECES_PER_THREAD;
+    }
+    if (p.count == 0) p.count = 1;
+    if (threads > p.count) threads = (unsigned int) p.count;
+    p.window = 2 * threads;
+
+    p.pieces = (yajl_piece *) YA_MALLOC(&(p.alloc),
+                                        p.count * sizeof(yajl_piece));
+    if (p.pieces == NULL) return yajl_status_error;
+    memset(p.pieces, 0, p.count * sizeof(yajl_piece));
+
+    /* cut just after newlines */
+    for (i = 1; i < p.count; i++) {
+        size_t start = i * (len / p.count);
+        const unsigned char * nl;
+
+        if (start < p.pieces[i - 1].start) start = p.pieces[i - 1].start;
+        nl = (const unsigned char *) memchr(text + start, '\n', len - start);
+        p.pieces[i].start = nl ? (size_t) (nl - text) + 1 : len;
+        p.pieces[i - 1].end = p.pieces[i].start;
+    }
+    p.pieces[p.count - 1].end = len;
+
+#ifdef YAJL_HAVE_PTHREAD
+    pthread_mutex_init(&(p.lock), NULL);
+    pthread_cond_init(&(p.cond), NULL);
+    pthread_mutex_init(&(p.deliverLock), NULL);
+#endif
+
+    if (p.count > 1) {
+        p.measuring = 1;
+        yajl_parallel_pass(&p, threads);
+        p.measuring = 0;
+
+        /* with depth kept from going below zero, a piece which takes it
+         * down to low and ends up at net leaves it at whichever is the
+         * greater of depth + net and net - low */
+        for (i = 1; i < p.count; i++) {
+            yajl_piece * prev = p.pieces + i - 1;
+            ptrdiff_t d = (ptrdiff_t) prev->depth + prev->net;
+            if (d < prev->net - prev->low) d = prev->net - prev->low;
+            p.pieces[i].depth = (size_t) d;
+        }
+    }
+
+    yajl_parallel_pass(&p, threads);
+
+    /* anything left after a cancel */
+    for (i = 0; i < p.count; i++) {
+        size_t j;
+        for (j = 0; j < p.pieces[i].count; j++) {
+            yajl_doc_result * r = p.pieces[i].docs + j;
+            if (r->doc) yajl_parallel_free_doc(&p, r->doc);
+            if (r->error) YA_FREE(&(p.alloc), r->error);
+        }
+        if (p.pieces[i].docs) YA_FREE(&(p.alloc), p.pieces[i].docs);
+    }
+    YA_FREE(&(p.alloc), p.pieces);
+
+#ifdef YAJL_HAVE_PTHREAD
+    pthread_mutex_destroy(&(p.lock));
+    pthread_cond_destroy(&(p.cond));
+    pthread_mutex_destroy(&(p.deliverLock));
+#endif
+
+    if (p.failed) return yajl_status_error;
+    if (p.canceled) return yajl_status_client_canceled;
+    return yajl_status_ok;
+}
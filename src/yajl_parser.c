@@ -18,7 +18,10 @@
 #include "yajl_lex.h"
 #include "yajl_parser.h"
 #include "yajl_encode.h"
+#include "yajl_number.h"
 #include "yajl_bytestack.h"
+#include "yajl_simd.h"
+#include "yajl_filter.h"
 
 #include <stdlib.h>
 #include <limits.h>
@@ -29,38 +32,6 @@
 #include <assert.h>
 #include <math.h>
 
-#define MAX_VALUE_TO_MULTIPLY ((LLONG_MAX / 10) + (LLONG_MAX % 10))
-
- /* same semantics as strtol */
-long long
-yajl_parse_integer(const unsigned char *number, unsigned int length)
-{
-    long long ret  = 0;
-    long sign = 1;
-    const unsigned char *pos = number;
-    if (*pos == '-') { pos++; sign = -1; }
-    if (*pos == '+') { pos++; }
-
-    while (pos < number + length) {
-        if ( ret > MAX_VALUE_TO_MULTIPLY ) {
-            errno = ERANGE;
-            return sign == 1 ? LLONG_MAX : LLONG_MIN;
-        }
-        ret *= 10;
-        if (LLONG_MAX - ret < (*pos - '0')) {
-            errno = ERANGE;
-            return sign == 1 ? LLONG_MAX : LLONG_MIN;
-        }
-        if (*pos < '0' || *pos > '9') {
-            errno = ERANGE;
-            return sign == 1 ? LLONG_MAX : LLONG_MIN;
-        }
-        ret += (*pos++ - '0');
-    }
-
-    return sign * ret;
-}
-
 unsigned char *
 yajl_render_error_string(yajl_handle hand, const unsigned char * jsonText,
                          size_t jsonTextLen, int verbose)
@@ -155,6 +126,153 @@ yajl_render_error_string(yajl_handle hand, const unsigned char * jsonText,
     }
 
 
+#define yajl_skip_is_space(c) ((c) == ' ' || ((c) >= 0x09 && (c) <= 0x0d))
+
+/* the bytes which matter inside a skipped object or array */
+static const unsigned char skipStops[256] = {
+    /*       0 1 2 3 4 5 6 7 8 9 a b c d e f */
+    /* 0 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 1 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 2 */  0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,1,
+    /* 3 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 4 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 5 */  0,0,0,0,0,0,0,0,0,0,0,1,0,1,0,0,
+    /* 6 */  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 7 */  0,0,0,0,0,0,0,0,0,0,0,1,0,1,0,0
+};
+
+/* scan over a skipped value, looking only at quotes, brackets and (when
+ * allowed) comments.  returns 1 once the value is behind us, 0 if the
+ * text ran out first, and -1 on an error */
+static int
+yajl_skip_scan(yajl_handle hand, const unsigned char * jsonText,
+               size_t jsonTextLen, size_t * offset)
+{
+    int allowComments = hand->flags & yajl_allow_comments;
+    size_t off = *offset;
+    unsigned char c;
+    int rv = 0;
+
+    while (off < jsonTextLen) {
+        if (hand->skipState == yajl_skip_in_string) {
+            off += yajl_simd_string_scan(jsonText + off, jsonTextLen - off,
+                                         0);
+            if (off == jsonTextLen) break;
+        } else if (hand->skipState == yajl_skip_in_container) {
+            while (off < jsonTextLen && !skipStops[jsonText[off]]) off++;
+            if (off == jsonTextLen) break;
+        }
+
+        c = jsonText[off++];
+
+        switch (hand->skipState) {
+            case yajl_skip_before_value:
+                if (yajl_skip_is_space(c)) break;
+                if (c == '"') {
+                    hand->skipState = yajl_skip_in_string;
+                } else if (c == '{' || c == '[') {
+                    hand->skipDepth = 1;
+                    hand->skipState = yajl_skip_in_container;
+                } else if (c == '/' && allowComments) {
+                    hand->skipState = yajl_skip_slash;
+                } else if (c == '}' || c == ']' || c == ',' || c == ':') {
+                    off--;
+                    rv = -1;
+                    goto done;
+                } else {
+                    hand->skipState = yajl_skip_in_scalar;
+                }
+                break;
+            case yajl_skip_in_scalar:
+                /* numbers and literals end at anything structural, which
+                 * is left for the lexer */
+                if (yajl_skip_is_space(c) || c == ',' || c == ':' ||
+                    c == '}' || c == ']' || c == '{' || c == '[' ||
+                    c == '"' || c == '/')
+                {
+                    off--;
+                    rv = 1;
+                    goto done;
+                }
+                break;
+            case yajl_skip_in_container:
+                if (c == '"') {
+                    hand->skipState = yajl_skip_in_string;
+                } else if (c == '{' || c == '[') {
+                    hand->skipDepth++;
+                } else if (c == '}' || c == ']') {
+                    if (--hand->skipDepth == 0) {
+                        if (hand->skipContents) off--;
+                        rv = 1;
+                        goto done;
+                    }
+                } else if (c == '/' && allowComments) {
+                    hand->skipState = yajl_skip_slash;
+                }
+                break;
+            case yajl_skip_in_string:
+                if (c == '\\') {
+                    hand->skipState = yajl_skip_in_escape;
+                } else if (c == '"') {
+                    if (hand->skipDepth == 0) {
+                        rv = 1;
+                        goto done;
+                    }
+                    hand->skipState = yajl_skip_in_container;
+                }
+                break;
+            case yajl_skip_in_escape:
+                hand->skipState = yajl_skip_in_string;
+                break;
+            case yajl_skip_slash:
+                if (c == '/') {
+                    hand->skipState = yajl_skip_in_line_comment;
+                } else if (c == '*') {
+                    hand->skipState = yajl_skip_in_block_comment;
+                } else {
+                    off--;
+                    rv = -1;
+                    goto done;
+                }
+                break;
+            case yajl_skip_in_line_comment:
+                if (c == '\n') {
+                    hand->skipState = hand->skipDepth ?
+                        yajl_skip_in_container : yajl_skip_before_value;
+                }
+                break;
+            case yajl_skip_in_block_comment:
+                if (c == '*') hand->skipState = yajl_skip_block_star;
+                break;
+            case yajl_skip_block_star:
+                if (c == '/') {
+                    hand->skipState = hand->skipDepth ?
+                        yajl_skip_in_container : yajl_skip_before_value;
+                } else if (c != '*') {
+                    hand->skipState = yajl_skip_in_block_comment;
+                }
+                break;
+        }
+    }
+
+  done:
+    *offset = off;
+    return rv;
+}
+
+/* start skipping a value, or from inside an object or array when depth
+ * is 1.  with contents set, its closing bracket is left to the parser */
+static void
+yajl_skip_begin(yajl_handle hand, size_t depth, int contents)
+{
+    hand->skipRequest = 0;
+    hand->skipContents = (unsigned char) contents;
+    hand->skipDepth = depth;
+    hand->skipState = (unsigned char) (depth ? yajl_skip_in_container
+                                             : yajl_skip_before_value);
+    yajl_bs_push(hand->stateStack, yajl_state_skip);
+}
+
 yajl_status
 yajl_do_finish(yajl_handle hand)
 {
@@ -182,18 +300,56 @@ yajl_do_finish(yajl_handle hand)
     }
 }
 
+/* decode a string with escapes, pointing buf and bufLen at the result */
+static void
+yajl_decode_string(yajl_handle hand, const unsigned char ** buf,
+                   size_t * bufLen)
+{
+    if (hand->decodeInPlace) {
+        *bufLen = yajl_string_decode_to((unsigned char *) *buf, *buf,
+                                        *bufLen);
+    } else {
+        yajl_buf_clear(hand->decodeBuf);
+        yajl_string_decode(hand->decodeBuf, *buf, *bufLen);
+        *buf = yajl_buf_data(hand->decodeBuf);
+        *bufLen = yajl_buf_len(hand->decodeBuf);
+    }
+}
+
 yajl_status
 yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
               size_t jsonTextLen)
+{
+    hand->bytesConsumed = 0;
+    return yajl_do_continue(hand, jsonText, jsonTextLen);
+}
+
+yajl_status
+yajl_do_continue(yajl_handle hand, const unsigned char * jsonText,
+                 size_t jsonTextLen)
 {
     yajl_tok tok;
     const unsigned char * buf;
     size_t bufLen;
     size_t * offset = &(hand->bytesConsumed);
+    /* where the budget for this call runs out */
+    size_t limit = jsonTextLen;
 
-    *offset = 0;
+    if (hand->budget && hand->budget < jsonTextLen - *offset) {
+        limit = *offset + hand->budget;
+    }
 
   around_again:
+    /* stop between tokens when asked to, see yajl_reader_next(), or
+     * once the budget is spent */
+    if (hand->yieldRequest) {
+        hand->yieldRequest = 0;
+        return yajl_status_yield;
+    }
+    if (*offset >= limit && *offset < jsonTextLen) {
+        return yajl_status_yield;
+    }
+
     switch (yajl_bs_current(hand->stateStack)) {
         case yajl_state_parse_complete:
             if (hand->flags & yajl_allow_multiple_values) {
@@ -215,6 +371,22 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
         case yajl_state_lexical_error:
         case yajl_state_parse_error:
             return yajl_status_error;
+        case yajl_state_skip:
+            /* a long skip mustn't overrun the budget */
+            switch (yajl_skip_scan(hand, jsonText, limit, offset)) {
+                case 0:
+                    if (*offset < jsonTextLen) goto around_again;
+                    return yajl_status_ok;
+                case 1:
+                    yajl_bs_pop(hand->stateStack);
+                    break;
+                default:
+                    yajl_bs_pop(hand->stateStack);
+                    yajl_bs_set(hand->stateStack, yajl_state_parse_error);
+                    hand->parseError =
+                        "unallowed token at this point in JSON text";
+            }
+            goto around_again;
         case yajl_state_start:
         case yajl_state_got_value:
         case yajl_state_map_need_val:
@@ -228,9 +400,63 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
              * than state_start */
 
             yajl_state stateToPush = yajl_state_start;
+            const yajl_callbacks * callbacks = hand->callbacks;
+            /* the first token of a value dropped by the path filters */
+            int dropped = 0;
+
+            /* the client asked to skip the value of the last key, or
+             * the contents of the array just started */
+            if (hand->skipRequest) {
+                if (yajl_bs_current(hand->stateStack) ==
+                    yajl_state_map_need_val)
+                {
+                    yajl_bs_set(hand->stateStack, yajl_state_map_got_val);
+                    yajl_skip_begin(hand, 0, 0);
+                    goto around_again;
+                }
+                if (yajl_bs_current(hand->stateStack) ==
+                    yajl_state_array_start)
+                {
+                    yajl_skip_begin(hand, 1, 1);
+                    goto around_again;
+                }
+            }
 
             tok = yajl_lex_lex(hand->lexer, jsonText, jsonTextLen,
                                offset, &buf, &bufLen);
+            hand->skipRequest = 0;
+
+            /* values the path filters don't want get no callbacks, and
+             * objects and arrays among them are skipped */
+            if (hand->filter != NULL) {
+                int container = 0;
+                switch (tok) {
+                    case yajl_tok_left_bracket: container = '{'; break;
+                    case yajl_tok_left_brace: container = '['; break;
+                    case yajl_tok_string:
+                    case yajl_tok_string_with_escapes:
+                    case yajl_tok_bool:
+                    case yajl_tok_null:
+                    case yajl_tok_integer:
+                    case yajl_tok_double: break;
+                    default: container = -1;
+                }
+                if (container >= 0) {
+                    const unsigned char * key;
+                    size_t keyLen;
+
+                    if (!yajl_filter_value(hand->filter, container)) {
+                        callbacks = NULL;
+                        dropped = 1;
+                    } else if (yajl_filter_held_key(hand->filter, &key,
+                                                    &keyLen) &&
+                               callbacks && callbacks->yajl_map_key)
+                    {
+                        _CC_CHK(callbacks->yajl_map_key(hand->ctx, key,
+                                                        keyLen));
+                    }
+                }
+            }
 
             switch (tok) {
                 case yajl_tok_eof:
@@ -239,49 +465,47 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
                     yajl_bs_set(hand->stateStack, yajl_state_lexical_error);
                     goto around_again;
                 case yajl_tok_string:
-                    if (hand->callbacks && hand->callbacks->yajl_string) {
-                        _CC_CHK(hand->callbacks->yajl_string(hand->ctx,
+                    if (callbacks && callbacks->yajl_string) {
+                        _CC_CHK(callbacks->yajl_string(hand->ctx,
                                                              buf, bufLen));
                     }
                     break;
                 case yajl_tok_string_with_escapes:
-                    if (hand->callbacks && hand->callbacks->yajl_string) {
-                        yajl_buf_clear(hand->decodeBuf);
-                        yajl_string_decode(hand->decodeBuf, buf, bufLen);
-                        _CC_CHK(hand->callbacks->yajl_string(
-                                    hand->ctx, yajl_buf_data(hand->decodeBuf),
-                                    yajl_buf_len(hand->decodeBuf)));
+                    if (callbacks && callbacks->yajl_string) {
+                        yajl_decode_string(hand, &buf, &bufLen);
+                        _CC_CHK(callbacks->yajl_string(hand->ctx,
+                                                             buf, bufLen));
                     }
                     break;
                 case yajl_tok_bool:
-                    if (hand->callbacks && hand->callbacks->yajl_boolean) {
-                        _CC_CHK(hand->callbacks->yajl_boolean(hand->ctx,
+                    if (callbacks && callbacks->yajl_boolean) {
+                        _CC_CHK(callbacks->yajl_boolean(hand->ctx,
                                                               *buf == 't'));
                     }
                     break;
                 case yajl_tok_null:
-                    if (hand->callbacks && hand->callbacks->yajl_null) {
-                        _CC_CHK(hand->callbacks->yajl_null(hand->ctx));
+                    if (callbacks && callbacks->yajl_null) {
+                        _CC_CHK(callbacks->yajl_null(hand->ctx));
                     }
                     break;
                 case yajl_tok_left_bracket:
-                    if (hand->callbacks && hand->callbacks->yajl_start_map) {
-                        _CC_CHK(hand->callbacks->yajl_start_map(hand->ctx));
+                    if (callbacks && callbacks->yajl_start_map) {
+                        _CC_CHK(callbacks->yajl_start_map(hand->ctx));
                     }
                     stateToPush = yajl_state_map_start;
                     break;
                 case yajl_tok_left_brace:
-                    if (hand->callbacks && hand->callbacks->yajl_start_array) {
-                        _CC_CHK(hand->callbacks->yajl_start_array(hand->ctx));
+                    if (callbacks && callbacks->yajl_start_array) {
+                        _CC_CHK(callbacks->yajl_start_array(hand->ctx));
                     }
                     stateToPush = yajl_state_array_start;
                     break;
                 case yajl_tok_integer:
-                    if (hand->callbacks) {
-                        if (hand->callbacks->yajl_number) {
-                            _CC_CHK(hand->callbacks->yajl_number(
+                    if (callbacks) {
+                        if (callbacks->yajl_number) {
+                            _CC_CHK(callbacks->yajl_number(
                                         hand->ctx,(const char *) buf, bufLen));
-                        } else if (hand->callbacks->yajl_integer) {
+                        } else if (callbacks->yajl_integer) {
                             long long int i = 0;
                             errno = 0;
                             i = yajl_parse_integer(buf, bufLen);
@@ -296,23 +520,20 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
                                 else *offset = 0;
                                 goto around_again;
                             }
-                            _CC_CHK(hand->callbacks->yajl_integer(hand->ctx,
+                            _CC_CHK(callbacks->yajl_integer(hand->ctx,
                                                                   i));
                         }
                     }
                     break;
                 case yajl_tok_double:
-                    if (hand->callbacks) {
-                        if (hand->callbacks->yajl_number) {
-                            _CC_CHK(hand->callbacks->yajl_number(
+                    if (callbacks) {
+                        if (callbacks->yajl_number) {
+                            _CC_CHK(callbacks->yajl_number(
                                         hand->ctx, (const char *) buf, bufLen));
-                        } else if (hand->callbacks->yajl_double) {
+                        } else if (callbacks->yajl_double) {
                             double d = 0.0;
-                            yajl_buf_clear(hand->decodeBuf);
-                            yajl_buf_append(hand->decodeBuf, buf, bufLen);
-                            buf = yajl_buf_data(hand->decodeBuf);
                             errno = 0;
-                            d = strtod((char *) buf, NULL);
+                            d = yajl_parse_double(buf, bufLen);
                             if ((d == HUGE_VAL || d == -HUGE_VAL) &&
                                 errno == ERANGE)
                             {
@@ -325,7 +546,7 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
                                 else *offset = 0;
                                 goto around_again;
                             }
-                            _CC_CHK(hand->callbacks->yajl_double(hand->ctx,
+                            _CC_CHK(callbacks->yajl_double(hand->ctx,
                                                                  d));
                         }
                     }
@@ -334,10 +555,11 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
                     if (yajl_bs_current(hand->stateStack) ==
                         yajl_state_array_start)
                     {
-                        if (hand->callbacks &&
-                            hand->callbacks->yajl_end_array)
+                        if (hand->filter) yajl_filter_end(hand->filter);
+                        if (callbacks &&
+                            callbacks->yajl_end_array)
                         {
-                            _CC_CHK(hand->callbacks->yajl_end_array(hand->ctx));
+                            _CC_CHK(callbacks->yajl_end_array(hand->ctx));
                         }
                         yajl_bs_pop(hand->stateStack);
                         goto around_again;
@@ -368,7 +590,11 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
                 }
             }
             if (stateToPush != yajl_state_start) {
-                yajl_bs_push(hand->stateStack, stateToPush);
+                if (dropped) {
+                    yajl_skip_begin(hand, 1, 0);
+                } else {
+                    yajl_bs_push(hand->stateStack, stateToPush);
+                }
             }
 
             goto around_again;
@@ -378,8 +604,19 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
             /* only difference between these two states is that in
              * start '}' is valid, whereas in need_key, we've parsed
              * a comma, and a string key _must_ follow */
+
+            /* the client asked to skip the contents of the map just
+             * started */
+            if (hand->skipRequest &&
+                yajl_bs_current(hand->stateStack) == yajl_state_map_start)
+            {
+                yajl_skip_begin(hand, 1, 1);
+                goto around_again;
+            }
+
             tok = yajl_lex_lex(hand->lexer, jsonText, jsonTextLen,
                                offset, &buf, &bufLen);
+            hand->skipRequest = 0;
             switch (tok) {
                 case yajl_tok_eof:
                     return yajl_status_ok;
@@ -387,24 +624,35 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
                     yajl_bs_set(hand->stateStack, yajl_state_lexical_error);
                     goto around_again;
                 case yajl_tok_string_with_escapes:
-                    if (hand->callbacks && hand->callbacks->yajl_map_key) {
-                        yajl_buf_clear(hand->decodeBuf);
-                        yajl_string_decode(hand->decodeBuf, buf, bufLen);
-                        buf = yajl_buf_data(hand->decodeBuf);
-                        bufLen = yajl_buf_len(hand->decodeBuf);
+                    if (hand->filter ||
+                        (hand->callbacks && hand->callbacks->yajl_map_key))
+                    {
+                        yajl_decode_string(hand, &buf, &bufLen);
                     }
                     /* intentional fall-through */
-                case yajl_tok_string:
-                    if (hand->callbacks && hand->callbacks->yajl_map_key) {
+                case yajl_tok_string: {
+                    yajl_filter_action action = yajl_filter_pass;
+
+                    /* a value the path filters don't want is skipped, as
+                     * if the client had asked */
+                    if (hand->filter != NULL) {
+                        action = yajl_filter_key(hand->filter, buf, bufLen);
+                        if (action == yajl_filter_drop) hand->skipRequest = 1;
+                    }
+                    if (action == yajl_filter_pass &&
+                        hand->callbacks && hand->callbacks->yajl_map_key)
+                    {
                         _CC_CHK(hand->callbacks->yajl_map_key(hand->ctx, buf,
                                                               bufLen));
                     }
                     yajl_bs_set(hand->stateStack, yajl_state_map_sep);
                     goto around_again;
+                }
                 case yajl_tok_right_bracket:
                     if (yajl_bs_current(hand->stateStack) ==
                         yajl_state_map_start)
                     {
+                        if (hand->filter) yajl_filter_end(hand->filter);
                         if (hand->callbacks && hand->callbacks->yajl_end_map) {
                             _CC_CHK(hand->callbacks->yajl_end_map(hand->ctx));
                         }
@@ -442,6 +690,7 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
                                offset, &buf, &bufLen);
             switch (tok) {
                 case yajl_tok_right_bracket:
+                    if (hand->filter) yajl_filter_end(hand->filter);
                     if (hand->callbacks && hand->callbacks->yajl_end_map) {
                         _CC_CHK(hand->callbacks->yajl_end_map(hand->ctx));
                     }
@@ -470,6 +719,7 @@ yajl_do_parse(yajl_handle hand, const unsigned char * jsonText,
                                offset, &buf, &bufLen);
             switch (tok) {
                 case yajl_tok_right_brace:
+                    if (hand->filter) yajl_filter_end(hand->filter);
                     if (hand->callbacks && hand->callbacks->yajl_end_array) {
                         _CC_CHK(hand->callbacks->yajl_end_array(hand->ctx));
                     }
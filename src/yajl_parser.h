@@ -21,6 +21,7 @@
 #include "yajl_bytestack.h"
 #include "yajl_buf.h"
 #include "yajl_lex.h"
+#include "yajl_filter.h"
 
 
 typedef enum {
@@ -37,8 +38,24 @@ typedef enum {
     yajl_state_array_got_val,
     yajl_state_array_need_val,
     yajl_state_got_value,
+    /* scanning over a value the client asked to skip, see
+     * yajl_skip_value() */
+    yajl_state_skip
 } yajl_state;
 
+/* where the scan over a skipped value is at */
+typedef enum {
+    yajl_skip_before_value = 0,
+    yajl_skip_in_scalar,
+    yajl_skip_in_container,
+    yajl_skip_in_string,
+    yajl_skip_in_escape,
+    yajl_skip_slash,
+    yajl_skip_in_line_comment,
+    yajl_skip_in_block_comment,
+    yajl_skip_block_star
+} yajl_skip_state;
+
 struct yajl_handle_t {
     const yajl_callbacks * callbacks;
     void * ctx;
@@ -50,18 +67,45 @@ struct yajl_handle_t {
     size_t bytesConsumed;
     /* temporary storage for decoded strings */
     yajl_buf decodeBuf;
+    /* set when the text may be written to, strings with escapes are then
+     * decoded where they lie rather than into decodeBuf */
+    unsigned int decodeInPlace;
     /* a stack of states.  access with yajl_state_XXX routines */
     yajl_bytestack stateStack;
     /* memory allocation routines */
     yajl_alloc_funcs alloc;
     /* bitfield */
     unsigned int flags;
+    /* set by yajl_skip_value(), cleared whenever the next token is lexed */
+    unsigned int skipRequest;
+    /* the scan over a skipped value: its nesting depth, whether only
+     * the contents of an object or array are skipped, leaving its closing
+     * bracket to the parser, and a yajl_skip_state */
+    size_t skipDepth;
+    unsigned char skipContents;
+    unsigned char skipState;
+    /* set to return from yajl_do_parse() before the next token */
+    unsigned int yieldRequest;
+    /* the yajl_yield_budget in bytes, zero for none */
+    size_t budget;
+    /* the chunk a yielded parse will resume in, and whether the parse is
+     * to be completed after it, see yajl_resume() */
+    const unsigned char * resumeText;
+    size_t resumeLen;
+    int resumeFinish;
+    /* the path filters, NULL unless yajl_add_path_filter() was called */
+    yajl_filter filter;
 };
 
 yajl_status
 yajl_do_parse(yajl_handle handle, const unsigned char * jsonText,
               size_t jsonTextLen);
 
+/* carry on parsing jsonText from hand->bytesConsumed */
+yajl_status
+yajl_do_continue(yajl_handle handle, const unsigned char * jsonText,
+                 size_t jsonTextLen);
+
 yajl_status
 yajl_do_finish(yajl_handle handle);
 
@@ -69,10 +113,4 @@ unsigned char *
 yajl_render_error_string(yajl_handle hand, const unsigned char * jsonText,
                          size_t jsonTextLen, int verbose);
 
-/* A little built in integer parsing routine with the same semantics as strtol
- * that's unaffected by LOCALE. */
-long long
-yajl_parse_integer(const unsigned char *number, unsigned int length);
-
-
 #endif
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The reader drives the usual parser with callbacks of its own, each of
+ * which records its event and asks the parser to stop before the next
+ * token.  Parsing then resumes where it stopped on the next call.
+ */
+
+#include "api/yajl_reader.h"
+
+#include "yajl_parser.h"
+#include "yajl_alloc.h"
+
+#include <assert.h>
+#include <string.h>
+
+struct yajl_reader_t {
+    yajl_handle hand;
+    /* the chunk being read, and how much of it has been */
+    const unsigned char * text;
+    size_t len;
+    size_t off;
+    /* where the last parse started, for error messages */
+    size_t lastOff;
+    int finished;
+    /* the last event, and its value */
+    yajl_event event;
+    const unsigned char * value;
+    size_t valueLen;
+};
+
+static int
+yajl_reader_event(yajl_reader r, yajl_event e, const unsigned char * value,
+                  size_t len)
+{
+    r->event = e;
+    r->value = value;
+    r->valueLen = len;
+    r->hand->yieldRequest = 1;
+    return 1;
+}
+
+static int
+yajl_reader_null(void * ctx)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_null,
+                             (const unsigned char *) "null", 4);
+}
+
+static int
+yajl_reader_boolean(void * ctx, int b)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_boolean,
+                             (const unsigned char *) (b ? "true" : "false"),
+                             b ? 4 : 5);
+}
+
+static int
+yajl_reader_number(void * ctx, const char * s, size_t l)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_number,
+                             (const unsigned char *) s, l);
+}
+
+static int
+yajl_reader_string(void * ctx, const unsigned char * s, size_t l)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_string, s, l);
+}
+
+static int
+yajl_reader_map_key(void * ctx, const unsigned char * s, size_t l)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_map_key, s, l);
+}
+
+static int
+yajl_reader_start_map(void * ctx)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_start_map,
+                             NULL, 0);
+}
+
+static int
+yajl_reader_end_map(void * ctx)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_end_map, NULL, 0);
+}
+
+static int
+yajl_reader_start_array(void * ctx)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_start_array,
+                             NULL, 0);
+}
+
+static int
+yajl_reader_end_array(void * ctx)
+{
+    return yajl_reader_event((yajl_reader) ctx, yajl_event_end_array,
+                             NULL, 0);
+}
+
+static const yajl_callbacks yajl_reader_callbacks = {
+    yajl_reader_null,
+    yajl_reader_boolean,
+    NULL,
+    NULL,
+    yajl_reader_number,
+    yajl_reader_string,
+    yajl_reader_start_map,
+    yajl_reader_map_key,
+    yajl_reader_end_map,
+    yajl_reader_start_array,
+    yajl_reader_end_array
+};
+
+yajl_reader
+yajl_reader_alloc(unsigned int parse_options, yajl_alloc_funcs * afs)
+{
+    static const yajl_option options[] = {
+        yajl_allow_comments,
+        yajl_dont_validate_strings,
+        yajl_allow_trailing_garbage,
+        yajl_allow_multiple_values,
+        yajl_allow_partial_values
+    };
+    yajl_handle hand;
+    yajl_reader r;
+    size_t i;
+
+    hand = yajl_alloc(&yajl_reader_callbacks, afs, NULL);
+    if (hand == NULL) return NULL;
+
+    r = (yajl_reader) YA_MALLOC(&(hand->alloc), sizeof(struct yajl_reader_t));
+    memset((void *) r, 0, sizeof(struct yajl_reader_t));
+    r->hand = hand;
+    hand->ctx = r;
+
+    for (i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+        if (parse_options & options[i]) yajl_config(hand, options[i], 1);
+    }
+    hand->lexer = yajl_lex_alloc(&(hand->alloc),
+                                 hand->flags & yajl_allow_comments,
+                                 !(hand->flags & yajl_dont_validate_strings));
+
+    return r;
+}
+
+void
+yajl_reader_free(yajl_reader r)
+{
+    yajl_handle hand = r->hand;
+    YA_FREE(&(hand->alloc), r);
+    yajl_free(hand);
+}
+
+void
+yajl_reader_feed(yajl_reader r, const unsigned char * text, size_t len)
+{
+    r->text = text;
+    r->len = len;
+    r->off = 0;
+}
+
+void
+yajl_reader_finish(yajl_reader r)
+{
+    r->finished = 1;
+}
+
+/* run the parser over some text until it produces an event or runs out,
+ * returns zero on an error */
+static int
+yajl_reader_parse(yajl_reader r, const unsigned char * text, size_t len)
+{
+    yajl_status stat;
+
+    r->event = yajl_event_need_more;
+    stat = yajl_do_parse(r->hand, text, len);
+    return stat == yajl_status_ok || stat == yajl_status_yield;
+}
+
+yajl_event
+yajl_reader_next(yajl_reader r, const unsigned char ** value, size_t * len)
+{
+    yajl_event e;
+
+    switch (yajl_bs_current(r->hand->stateStack)) {
+        case yajl_state_parse_error:
+        case yajl_state_lexical_error:
+            e = yajl_event_error;
+            goto out;
+        default:
+            break;
+    }
+
+    if (r->off < r->len) {
+        r->lastOff = r->off;
+        if (!yajl_reader_parse(r, r->text + r->off, r->len - r->off)) {
+            e = yajl_event_error;
+            goto out;
+        }
+        r->off += yajl_get_bytes_consumed(r->hand);
+        if (r->event != yajl_event_need_more) {
+            *value = r->value;
+            *len = r->valueLen;
+            return r->event;
+        }
+    }
+
+    if (!r->finished) {
+        e = yajl_event_need_more;
+        goto out;
+    }
+
+    /* end of input.  a space ends any number the lexer is holding on
+     * to, which may be the last event */
+    r->text = NULL;
+    r->len = r->off = r->lastOff = 0;
+    if (!yajl_reader_parse(r, (const unsigned char *) " ", 1)) {
+        e = yajl_event_error;
+        goto out;
+    }
+    if (r->event != yajl_event_need_more) {
+        *value = r->value;
+        *len = r->valueLen;
+        return r->event;
+    }
+    e = yajl_do_finish(r->hand) == yajl_status_ok ? yajl_event_end
+                                                  : yajl_event_error;
+
+  out:
+    *value = NULL;
+    *len = 0;
+    return e;
+}
+
+void
+yajl_reader_skip(yajl_reader r)
+{
+    yajl_skip_value(r->hand);
+}
+
+unsigned char *
+yajl_reader_get_error(yajl_reader r, int verbose)
+{
+    return yajl_get_error(r->hand, verbose,
+                          r->text ? r->text + r->lastOff : NULL,
+                          r->text ? r->len - r->lastOff : 0);
+}
+
+void
+yajl_reader_free_error(yajl_reader r, unsigned char * str)
+{
+    yajl_free_error(r->hand, str);
+}
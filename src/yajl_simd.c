@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "yajl_simd.h"
+
+#include <string.h>
+
+#ifdef YAJL_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(YAJL_SIMD_SSSE3) || defined(YAJL_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static unsigned int yajl_ctz(unsigned int x)
+{
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return (unsigned int) i;
+}
+#elif defined(__GNUC__)
+#define yajl_ctz(x) ((unsigned int) __builtin_ctz(x))
+#else
+static unsigned int yajl_ctz(unsigned int x)
+{
+    unsigned int i = 0;
+    while (!(x & 1)) { x >>= 1; i++; }
+    return i;
+}
+#endif
+
+/* Inside a string the lexer cares about '"', '\\' and control chars
+ * (< 0x20), and when validating UTF8, bytes >= 0x80.  The last two
+ * classes are found with a single signed comparison:
+ *
+ *   utf8check:  (signed) c < 0x20 catches 0x00-0x1f and 0x80-0xff
+ *   otherwise:  (signed) (c ^ 0x80) < (signed) 0xa0 catches 0x00-0x1f
+ *
+ * so all we vary is the bias and the threshold. */
+#define SCAN_BIAS(utf8check) ((utf8check) ? 0x00 : 0x80)
+#define SCAN_LIMIT(utf8check) ((char) ((utf8check) ? 0x20 : 0xa0))
+
+static size_t
+yajl_scan_none(const unsigned char * buf, size_t len, int utf8check)
+{
+    (void) buf; (void) len; (void) utf8check;
+    return 0;
+}
+
+#ifdef YAJL_SIMD_SSE2
+static size_t
+yajl_scan_sse2(const unsigned char * buf, size_t len, int utf8check)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i bias = _mm_set1_epi8((char) SCAN_BIAS(utf8check));
+    const __m128i limit = _mm_set1_epi8(SCAN_LIMIT(utf8check));
+    size_t off = 0;
+
+    for (; off + 16 <= len; off += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (buf + off));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+            _mm_cmplt_epi8(_mm_xor_si128(v, bias), limit));
+        unsigned int bits = (unsigned int) _mm_movemask_epi8(m);
+        if (bits) return off + yajl_ctz(bits);
+    }
+    return off;
+}
+#endif
+
+#ifdef YAJL_SIMD_AVX2
+__attribute__((target("avx2")))
+static size_t
+yajl_scan_avx2(const unsigned char * buf, size_t len, int utf8check)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i bias = _mm256_set1_epi8((char) SCAN_BIAS(utf8check));
+    const __m256i limit = _mm256_set1_epi8(SCAN_LIMIT(utf8check));
+    size_t off = 0;
+
+    for (; off + 32 <= len; off += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (buf + off));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                            _mm256_cmpeq_epi8(v, bslash)),
+            _mm256_cmpgt_epi8(limit, _mm256_xor_si256(v, bias)));
+        unsigned int bits = (unsigned int) _mm256_movemask_epi8(m);
+        if (bits) return off + yajl_ctz(bits);
+    }
+    /* let SSE2 have a go at what's left.  the upper halves of the
+     * registers must be cleared first, or mixing in SSE code costs a
+     * state transition which is dearer than the scan */
+    _mm256_zeroupper();
+    return off + yajl_scan_sse2(buf + off, len - off, utf8check);
+}
+#endif
+
+/* strict UTF8 validation, one character at a time.  Lead bytes are
+ * classified per table 3-7 of the Unicode standard, which also rules
+ * out overlong forms, surrogates, and code points past U+10FFFF.  Stops
+ * at the first special ASCII byte, or at the lead byte of a sequence
+ * that is invalid or runs past the end of the buffer. */
+static size_t
+yajl_utf8_scan_scalar(const unsigned char * buf, size_t len)
+{
+    size_t off = 0;
+
+    while (off < len) {
+        unsigned char c = buf[off];
+        unsigned char lo = 0x80, hi = 0xbf;
+        size_t n, i;
+
+        if (c < 0x80) {
+            if (c < 0x20 || c == '"' || c == '\\') break;
+            off++;
+            continue;
+        }
+
+        if (c >= 0xc2 && c <= 0xdf) n = 1;
+        else if (c == 0xe0) { n = 2; lo = 0xa0; }
+        else if (c == 0xed) { n = 2; hi = 0x9f; }
+        else if (c >= 0xe1 && c <= 0xef) n = 2;
+        else if (c == 0xf0) { n = 3; lo = 0x90; }
+        else if (c >= 0xf1 && c <= 0xf3) n = 3;
+        else if (c == 0xf4) { n = 3; hi = 0x8f; }
+        else break;
+
+        if (len - off <= n) break;
+        if (buf[off + 1] < lo || buf[off + 1] > hi) break;
+        for (i = 2; i <= n; i++) {
+            if ((buf[off + i] & 0xc0) != 0x80) break;
+        }
+        if (i <= n) break;
+        off += n + 1;
+    }
+
+    return off;
+}
+
+#if defined(YAJL_SIMD_SSSE3) || defined(YAJL_SIMD_AVX2)
+/* Vectorized validation after Keiser & Lemire, "Validating UTF-8 In Less
+ * Than One Instruction Per Byte".  Each byte is checked against the one
+ * before it by looking up the high nibble of the previous byte, the low
+ * nibble of the previous byte and the high nibble of the current byte
+ * in three 16 entry tables.  Every bit names a class of error, and a pair
+ * of bytes is in error when all three lookups agree on some bit.  Bytes
+ * which must be the second or third continuation of a longer sequence
+ * are checked separately, by looking two and three bytes back. */
+#define U8_TOO_SHORT   (1<<0) /* 11______ 0_______, 11______ 11______ */
+#define U8_TOO_LONG    (1<<1) /* 0_______ 10______ */
+#define U8_OVERLONG_3  (1<<2) /* 11100000 100_____ */
+#define U8_TOO_LARGE   (1<<3) /* 11110100 1001____ and above */
+#define U8_SURROGATE   (1<<4) /* 11101101 101_____ */
+#define U8_OVERLONG_2  (1<<5) /* 1100000_ 10______ */
+#define U8_TOO_LARGE_1000 (1<<6) /* 11110101 1000____ and above */
+#define U8_OVERLONG_4  (1<<6) /* 11110000 1000____ */
+/* bit 7, spelled negative so table entries fit in a (signed) char */
+#define U8_TWO_CONTS   (-0x80) /* 10______ 10______ */
+#define U8_CARRY (U8_TOO_SHORT | U8_TOO_LONG | U8_TWO_CONTS)
+
+#define U8_BYTE_1_HIGH                                                  \
+    U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,                 \
+    U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,                 \
+    U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS,             \
+    U8_TOO_SHORT | U8_OVERLONG_2,                                       \
+    U8_TOO_SHORT,                                                       \
+    U8_TOO_SHORT | U8_OVERLONG_3 | U8_SURROGATE,                        \
+    U8_TOO_SHORT | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_OVERLONG_4
+
+#define U8_BYTE_1_LOW                                                   \
+    U8_CARRY | U8_OVERLONG_3 | U8_OVERLONG_2 | U8_OVERLONG_4,           \
+    U8_CARRY | U8_OVERLONG_2,                                           \
+    U8_CARRY,                                                           \
+    U8_CARRY,                                                           \
+    U8_CARRY | U8_TOO_LARGE,                                            \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_SURROGATE,         \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,                        \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000
+
+#define U8_BYTE_2_HIGH                                                  \
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,             \
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,             \
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 |        \
+        U8_TOO_LARGE_1000 | U8_OVERLONG_4,                              \
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 |        \
+        U8_TOO_LARGE,                                                   \
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE |         \
+        U8_TOO_LARGE,                                                   \
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE |         \
+        U8_TOO_LARGE,                                                   \
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT
+
+/* a vector routine gave up on the block at off, either because it failed
+ * validation or because there's something in it the lexer must see.
+ * Everything before the character boundary preceding off is known to be
+ * good, so back up to that boundary and let the scalar loop find exactly
+ * where to stop, looking no further than the end of the block. */
+static size_t
+yajl_utf8_scan_finish(const unsigned char * buf, size_t len, size_t off,
+                      size_t block)
+{
+    size_t start = off;
+    size_t end = (len - off > block) ? off + block : len;
+
+    /* a multibyte character may straddle the block boundary */
+    while (start > 0 && off - start < 3 && (buf[start - 1] & 0xc0) == 0x80) {
+        start--;
+    }
+    if (start > 0 && buf[start - 1] >= 0xc0) start--;
+    else start = off;
+
+    return start + yajl_utf8_scan_scalar(buf + start, end - start);
+}
+#endif
+
+#ifdef YAJL_SIMD_SSSE3
+#define U8_TARGET_SSSE3 __attribute__((target("ssse3")))
+
+U8_TARGET_SSSE3
+static __m128i
+yajl_utf8_check_ssse3(__m128i v, __m128i prev)
+{
+    const __m128i nib = _mm_set1_epi8(0x0f);
+    __m128i prev1 = _mm_alignr_epi8(v, prev, 15);
+    __m128i prev2 = _mm_alignr_epi8(v, prev, 14);
+    __m128i prev3 = _mm_alignr_epi8(v, prev, 13);
+    __m128i b1h = _mm_shuffle_epi8(_mm_setr_epi8(U8_BYTE_1_HIGH),
+                                   _mm_and_si128(_mm_srli_epi16(prev1, 4), nib));
+    __m128i b1l = _mm_shuffle_epi8(_mm_setr_epi8(U8_BYTE_1_LOW),
+                                   _mm_and_si128(prev1, nib));
+    __m128i b2h = _mm_shuffle_epi8(_mm_setr_epi8(U8_BYTE_2_HIGH),
+                                   _mm_and_si128(_mm_srli_epi16(v, 4), nib));
+    __m128i special = _mm_and_si128(_mm_and_si128(b1h, b1l), b2h);
+    __m128i must23 = _mm_or_si128(
+        _mm_subs_epu8(prev2, _mm_set1_epi8((char) (0xe0 - 0x80))),
+        _mm_subs_epu8(prev3, _mm_set1_epi8((char) (0xf0 - 0x80))));
+    return _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8((char) 0x80)),
+                         special);
+}
+
+U8_TARGET_SSSE3
+static size_t
+yajl_utf8_scan_ssse3(const unsigned char * buf, size_t len)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i bias = _mm_set1_epi8((char) SCAN_BIAS(0));
+    const __m128i limit = _mm_set1_epi8(SCAN_LIMIT(0));
+    const __m128i index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                        8, 9, 10, 11, 12, 13, 14, 15);
+    /* the last three bytes of a block may not begin sequences which
+     * extend past it */
+    const __m128i lastOk = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                                         -1, -1, -1, -1, -1, (char) 0xef,
+                                         (char) 0xdf, (char) 0xbf);
+    __m128i prev = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+    size_t off = 0;
+
+    for (;;) {
+        __m128i v, err;
+        unsigned int bits, stop = 16;
+
+        if (len - off >= 16) {
+            v = _mm_loadu_si128((const __m128i *) (buf + off));
+        } else {
+            /* pad the tail with NULs, which read as control characters
+             * and stop the scan at the end of the buffer */
+            unsigned char tail[16];
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, buf + off, len - off);
+            v = _mm_loadu_si128((const __m128i *) tail);
+        }
+
+        bits = (unsigned int) _mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+            _mm_cmplt_epi8(_mm_xor_si128(v, bias), limit)));
+        if (bits) {
+            /* only validate what comes before the stopping point.  A
+             * sequence cut short there shows up as an error */
+            stop = yajl_ctz(bits);
+            v = _mm_and_si128(v, _mm_cmpgt_epi8(_mm_set1_epi8((char) stop),
+                                                index));
+        }
+
+        if (_mm_movemask_epi8(v)) {
+            err = yajl_utf8_check_ssse3(v, prev);
+            incomplete = _mm_subs_epu8(v, lastOk);
+        } else {
+            err = incomplete;
+            incomplete = _mm_setzero_si128();
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(err, _mm_setzero_si128()))
+            != 0xffff)
+        {
+            return yajl_utf8_scan_finish(buf, len, off, 16);
+        }
+        if (bits) return off + stop;
+
+        prev = v;
+        off += 16;
+    }
+}
+#endif
+
+#ifdef YAJL_SIMD_AVX2
+#define U8_TARGET_AVX2 __attribute__((target("avx2")))
+
+U8_TARGET_AVX2
+static __m256i
+yajl_utf8_check_avx2(__m256i v, __m256i prev)
+{
+    const __m256i nib = _mm256_set1_epi8(0x0f);
+    __m256i shifted = _mm256_permute2x128_si256(prev, v, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(v, shifted, 15);
+    __m256i prev2 = _mm256_alignr_epi8(v, shifted, 14);
+    __m256i prev3 = _mm256_alignr_epi8(v, shifted, 13);
+    __m256i b1h = _mm256_shuffle_epi8(
+        _mm256_broadcastsi128_si256(_mm_setr_epi8(U8_BYTE_1_HIGH)),
+        _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib));
+    __m256i b1l = _mm256_shuffle_epi8(
+        _mm256_broadcastsi128_si256(_mm_setr_epi8(U8_BYTE_1_LOW)),
+        _mm256_and_si256(prev1, nib));
+    __m256i b2h = _mm256_shuffle_epi8(
+        _mm256_broadcastsi128_si256(_mm_setr_epi8(U8_BYTE_2_HIGH)),
+        _mm256_and_si256(_mm256_srli_epi16(v, 4), nib));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h);
+    __m256i must23 = _mm256_or_si256(
+        _mm256_subs_epu8(prev2, _mm256_set1_epi8((char) (0xe0 - 0x80))),
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8((char) (0xf0 - 0x80))));
+    return _mm256_xor_si256(
+        _mm256_and_si256(must23, _mm256_set1_epi8((char) 0x80)), special);
+}
+
+U8_TARGET_AVX2
+static size_t
+yajl_utf8_scan_avx2(const unsigned char * buf, size_t len)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i bias = _mm256_set1_epi8((char) SCAN_BIAS(0));
+    const __m256i limit = _mm256_set1_epi8(SCAN_LIMIT(0));
+    const __m256i index = _mm256_setr_epi8(
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+    const __m256i lastOk = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char) 0xef,
+        (char) 0xdf, (char) 0xbf);
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    size_t off = 0;
+
+    for (;;) {
+        __m256i v, err;
+        unsigned int bits, stop = 32;
+
+        if (len - off >= 32) {
+            v = _mm256_loadu_si256((const __m256i *) (buf + off));
+        } else {
+            unsigned char tail[32];
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, buf + off, len - off);
+            v = _mm256_loadu_si256((const __m256i *) tail);
+        }
+
+        bits = (unsigned int) _mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                            _mm256_cmpeq_epi8(v, bslash)),
+            _mm256_cmpgt_epi8(limit, _mm256_xor_si256(v, bias))));
+        if (bits) {
+            stop = yajl_ctz(bits);
+            v = _mm256_and_si256(v, _mm256_cmpgt_epi8(
+                                     _mm256_set1_epi8((char) stop), index));
+        }
+
+        if (_mm256_movemask_epi8(v)) {
+            err = yajl_utf8_check_avx2(v, prev);
+            incomplete = _mm256_subs_epu8(v, lastOk);
+        } else {
+            err = incomplete;
+            incomplete = _mm256_setzero_si256();
+        }
+
+        if (!_mm256_testz_si256(err, err)) {
+            return yajl_utf8_scan_finish(buf, len, off, 32);
+        }
+        if (bits) return off + stop;
+
+        prev = v;
+        off += 32;
+    }
+}
+#endif
+
+/* runtime dispatch.  the first call through a routine selects the best
+ * implementation for this processor.  Concurrent first calls race to
+ * store the same value, which is harmless. */
+typedef size_t (*yajl_scan_func)(const unsigned char *, size_t, int);
+
+static size_t yajl_scan_select(const unsigned char * buf, size_t len,
+                               int utf8check);
+
+static yajl_scan_func s_stringScan = yajl_scan_select;
+
+static size_t
+yajl_scan_select(const unsigned char * buf, size_t len, int utf8check)
+{
+    yajl_scan_func f = yajl_scan_none;
+#ifdef YAJL_SIMD_SSE2
+    f = yajl_scan_sse2;
+#endif
+#ifdef YAJL_SIMD_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) f = yajl_scan_avx2;
+#endif
+    s_stringScan = f;
+    return f(buf, len, utf8check);
+}
+
+size_t
+yajl_simd_string_scan(const unsigned char * buf, size_t len, int utf8check)
+{
+    return s_stringScan(buf, len, utf8check);
+}
+
+typedef size_t (*yajl_utf8_scan_func)(const unsigned char *, size_t);
+
+static size_t yajl_utf8_scan_select(const unsigned char * buf, size_t len);
+
+static yajl_utf8_scan_func s_utf8Scan = yajl_utf8_scan_select;
+
+static size_t
+yajl_utf8_scan_select(const unsigned char * buf, size_t len)
+{
+    yajl_utf8_scan_func f = yajl_utf8_scan_scalar;
+#if defined(YAJL_SIMD_SSSE3) || defined(YAJL_SIMD_AVX2)
+    __builtin_cpu_init();
+#endif
+#ifdef YAJL_SIMD_SSSE3
+    if (__builtin_cpu_supports("ssse3")) f = yajl_utf8_scan_ssse3;
+#endif
+#ifdef YAJL_SIMD_AVX2
+    if (__builtin_cpu_supports("avx2")) f = yajl_utf8_scan_avx2;
+#endif
+    s_utf8Scan = f;
+    return f(buf, len);
+}
+
+size_t
+yajl_simd_utf8_scan(const unsigned char * buf, size_t len)
+{
+    return s_utf8Scan(buf, len);
+}
+
+/* whitespace, as the lexer sees it, is ' ' and \t\n\v\f\r (0x09-0x0d) */
+static void
+yajl_classify_none(const unsigned char * buf, yajl_simd_masks * m)
+{
+    unsigned int i;
+
+    memset((void *) m, 0, sizeof(*m));
+    for (i = 0; i < 64; i++) {
+        uint64_t bit = (uint64_t) 1 << i;
+        unsigned char c = buf[i];
+        if (c == '"') m->quote |= bit;
+        else if (c == '\\') m->bslash |= bit;
+        else if (c == ' ' || (c >= 0x09 && c <= 0x0d)) m->space |= bit;
+        if (c < 0x20) m->ctrl |= bit;
+        else if (c >= 0x80) m->high |= bit;
+    }
+}
+
+#ifdef YAJL_SIMD_SSE2
+static void
+yajl_classify_sse2(const unsigned char * buf, yajl_simd_masks * m)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i wsLo = _mm_set1_epi8(0x08);
+    const __m128i wsHi = _mm_set1_epi8(0x0e);
+    const __m128i bias = _mm_set1_epi8((char) SCAN_BIAS(0));
+    const __m128i limit = _mm_set1_epi8(SCAN_LIMIT(0));
+    unsigned int i;
+
+    memset((void *) m, 0, sizeof(*m));
+    for (i = 0; i < 64; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+        m->quote |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << i;
+        m->bslash |=
+            (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, bslash)) << i;
+        m->space |= (uint64_t) _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, space),
+            _mm_and_si128(_mm_cmpgt_epi8(v, wsLo),
+                          _mm_cmplt_epi8(v, wsHi)))) << i;
+        m->ctrl |= (uint64_t) _mm_movemask_epi8(
+            _mm_cmplt_epi8(_mm_xor_si128(v, bias), limit)) << i;
+        m->high |= (uint64_t) _mm_movemask_epi8(v) << i;
+    }
+}
+#endif
+
+#ifdef YAJL_SIMD_AVX2
+__attribute__((target("avx2")))
+static void
+yajl_classify_avx2(const unsigned char * buf, yajl_simd_masks * m)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i wsLo = _mm256_set1_epi8(0x08);
+    const __m256i wsHi = _mm256_set1_epi8(0x0e);
+    const __m256i bias = _mm256_set1_epi8((char) SCAN_BIAS(0));
+    const __m256i limit = _mm256_set1_epi8(SCAN_LIMIT(0));
+    __m256i lo = _mm256_loadu_si256((const __m256i *) buf);
+    __m256i hi = _mm256_loadu_si256((const __m256i *) (buf + 32));
+
+#define CLASSIFY(expr)                                                  \
+    ((uint32_t) _mm256_movemask_epi8(expr(lo)) |                        \
+     ((uint64_t) (uint32_t) _mm256_movemask_epi8(expr(hi)) << 32))
+#define IS_QUOTE(v) _mm256_cmpeq_epi8(v, quote)
+#define IS_BSLASH(v) _mm256_cmpeq_epi8(v, bslash)
+#define IS_SPACE(v)                                                     \
+    _mm256_or_si256(_mm256_cmpeq_epi8(v, space),                        \
+                    _mm256_and_si256(_mm256_cmpgt_epi8(v, wsLo),        \
+                                     _mm256_cmpgt_epi8(wsHi, v)))
+#define IS_CTRL(v) _mm256_cmpgt_epi8(limit, _mm256_xor_si256(v, bias))
+#define IS_HIGH(v) (v)
+
+    m->quote = CLASSIFY(IS_QUOTE);
+    m->bslash = CLASSIFY(IS_BSLASH);
+    m->space = CLASSIFY(IS_SPACE);
+    m->ctrl = CLASSIFY(IS_CTRL);
+    m->high = CLASSIFY(IS_HIGH);
+
+#undef CLASSIFY
+#undef IS_QUOTE
+#undef IS_BSLASH
+#undef IS_SPACE
+#undef IS_CTRL
+#undef IS_HIGH
+}
+#endif
+
+typedef void (*yajl_classify_func)(const unsigned char *, yajl_simd_masks *);
+
+static void yajl_classify_select(const unsigned char * buf,
+                                 yajl_simd_masks * m);
+
+static yajl_classify_func s_classify = yajl_classify_select;
+
+static void
+yajl_classify_select(const unsigned char * buf, yajl_simd_masks * m)
+{
+    yajl_classify_func f = yajl_classify_none;
+#ifdef YAJL_SIMD_SSE2
+    f = yajl_classify_sse2;
+#endif
+#ifdef YAJL_SIMD_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) f = yajl_classify_avx2;
+#endif
+    s_classify = f;
+    f(buf, m);
+}
+
+void
+yajl_simd_classify(const unsigned char * buf, yajl_simd_masks * masks)
+{
+    s_classify(buf, masks);
+}
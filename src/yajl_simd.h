@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Vectorized scanning primitives.  These routines look at 16 (SSE2) or
+ * 32 (AVX2) bytes at a time.  The widest implementation supported by the
+ * running processor is selected the first time a routine is called.
+ *
+ * All routines only consume whole blocks, it's up to the caller to
+ * finish off the tail with a scalar loop.  When yajl is built without
+ * SIMD support (or for a platform we don't know how to vectorize for)
+ * the routines consume nothing, and the scalar loops do all the work.
+ *
+ * Define YAJL_NO_SIMD to disable the vector implementations at build
+ * time (cmake -DYAJL_ENABLE_SIMD=OFF).
+ */
+
+#ifndef __YAJL_SIMD_H__
+#define __YAJL_SIMD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(YAJL_NO_SIMD) &&                                      \
+    (defined(__x86_64__) || defined(_M_X64) ||                     \
+     (defined(__i386__) && defined(__SSE2__)))
+#  define YAJL_SIMD_SSE2 1
+/* SSSE3 and AVX2 code is compiled with function level target
+ * attributes so the library can still run on processors which lack it */
+#  if defined(__GNUC__) && \
+      ((__GNUC__ * 100 + __GNUC_MINOR__) >= 409 || defined(__clang__))
+#    define YAJL_SIMD_SSSE3 1
+#    define YAJL_SIMD_AVX2 1
+#  endif
+#endif
+
+/** the widest block size (in bytes) consumed by the routines below */
+#define YAJL_SIMD_BLOCK 32
+
+/** scan the contents of a JSON string for the first byte that needs
+ *  further review by the lexer: a quote, a backslash, a control
+ *  character, or (when utf8check is non-zero) a byte with the high bit
+ *  set.
+ *
+ *  returns the offset of the first such byte, or the number of bytes
+ *  that were consumed in whole blocks without finding one (which is
+ *  len rounded down to some multiple of the block size).  */
+size_t yajl_simd_string_scan(const unsigned char * buf, size_t len,
+                             int utf8check);
+
+/** scan the contents of a JSON string for the first byte that needs
+ *  further review by the lexer, validating UTF8 as we go.  The scan
+ *  stops at a quote, a backslash, a control character, or at the first
+ *  byte of a multibyte sequence that is not (or cannot yet be shown to
+ *  be) well formed.  Everything skipped is strictly valid UTF8, so the
+ *  lexer's own per character checks have the final word on anything
+ *  questionable.
+ *
+ *  Unlike yajl_simd_string_scan(), this routine looks at the whole
+ *  buffer, tail included, and falls back to a scalar loop where no
+ *  vector implementation is available.  */
+size_t yajl_simd_utf8_scan(const unsigned char * buf, size_t len);
+
+/** one bit per byte of a 64 byte block, bit 0 being the first byte */
+typedef struct {
+    uint64_t quote;    /* '"' */
+    uint64_t bslash;   /* '\\' */
+    uint64_t space;    /* whitespace, as the lexer sees it */
+    uint64_t ctrl;     /* control characters, < 0x20 */
+    uint64_t high;     /* bytes >= 0x80 */
+} yajl_simd_masks;
+
+/** classify exactly 64 bytes at buf, filling in masks */
+void yajl_simd_classify(const unsigned char * buf, yajl_simd_masks * masks);
+
+#endif
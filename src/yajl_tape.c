@@ -0,0 +1,513 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "api/yajl_tape.h"
+#include "api/yajl_parse.h"
+
+#include "yajl_parser.h"
+#include "yajl_alloc.h"
+#include "yajl_number.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(WIN32)
+#define snprintf sprintf_s
+#endif
+
+/*
+ * Each word of the tape holds a tag character in its top byte and a 56
+ * bit payload:
+ *
+ *   '{' '['   start of an object or array, the payload is the position
+ *             just past the matching end word
+ *   '}' ']'   end of an object or array, the payload is the number of
+ *             key-value pairs or elements
+ *   '"'       a string or key, the payload is its offset in the strings,
+ *             where a 32 bit length precedes the null terminated text
+ *   'l'       an integer, the next word holds its value
+ *   'd'       any other number, the next word holds its double's bits
+ *   't' 'f' 'n'
+ *
+ * The strings follow the words in the same allocation.
+ */
+#define TAPE_WORD(tag, payload) \
+    (((uint64_t) (tag) << 56) | (uint64_t) (payload))
+#define TAPE_TAG(w) ((unsigned char) ((w) >> 56))
+#define TAPE_PAYLOAD(w) ((size_t) ((w) & (((uint64_t) 1 << 56) - 1)))
+
+struct yajl_tape_s {
+    yajl_alloc_funcs alloc;
+    /* the number of words */
+    size_t len;
+    const uint64_t * words;
+    const unsigned char * strings;
+};
+
+/* an object or array being built */
+typedef struct {
+    size_t start;
+    size_t count;
+} yajl_tape_open;
+
+/* the state of a parse, a tape is built up in growable arrays and then
+ * copied into a single allocation once complete */
+typedef struct {
+    yajl_alloc_funcs * alloc;
+    uint64_t * words;
+    size_t used, size;
+    unsigned char * strings;
+    size_t stringsUsed, stringsSize;
+    yajl_tape_open * stack;
+    size_t depth, stackSize;
+    int outOfMemory;
+} yajl_tape_builder;
+
+/* make room for want more elements of elemSize bytes in a growable array,
+ * returns zero if out of memory */
+static int
+yajl_tape_reserve(yajl_tape_builder * b, void ** array, size_t * size,
+                  size_t used, size_t want, size_t elemSize)
+{
+    size_t need = *size ? *size : 64;
+    void * p;
+
+    if (*size - used >= want) return 1;
+
+    while (need - used < want) need <<= 1;
+    p = YA_REALLOC(b->alloc, *array, need * elemSize);
+    if (p == NULL) {
+        b->outOfMemory = 1;
+        return 0;
+    }
+    *array = p;
+    *size = need;
+    return 1;
+}
+
+static int
+yajl_tape_push(yajl_tape_builder * b, uint64_t w)
+{
+    if (b->used == b->size &&
+        !yajl_tape_reserve(b, (void **) &b->words, &b->size, b->used, 1,
+                           sizeof(uint64_t)))
+    {
+        return 0;
+    }
+    b->words[b->used++] = w;
+    return 1;
+}
+
+/* every value, but not a key, counts towards its container */
+static void
+yajl_tape_count(yajl_tape_builder * b)
+{
+    if (b->depth > 0) b->stack[b->depth - 1].count++;
+}
+
+static int
+yajl_tape_add_string(yajl_tape_builder * b, const unsigned char * str,
+                     size_t len)
+{
+    unsigned int len32 = (unsigned int) len;
+
+    if (len > 0xffffffffU) {
+        b->outOfMemory = 1;
+        return 0;
+    }
+    if (!yajl_tape_reserve(b, (void **) &b->strings, &b->stringsSize,
+                           b->stringsUsed, 4 + len + 1, 1) ||
+        !yajl_tape_push(b, TAPE_WORD('"', b->stringsUsed)))
+    {
+        return 0;
+    }
+
+    memcpy(b->strings + b->stringsUsed, &len32, 4);
+    memcpy(b->strings + b->stringsUsed + 4, str, len);
+    b->strings[b->stringsUsed + 4 + len] = 0;
+    b->stringsUsed += 4 + len + 1;
+    return 1;
+}
+
+static int
+yajl_tape_null(void * ctx)
+{
+    yajl_tape_builder * b = (yajl_tape_builder *) ctx;
+    yajl_tape_count(b);
+    return yajl_tape_push(b, TAPE_WORD('n', 0));
+}
+
+static int
+yajl_tape_boolean(void * ctx, int boolean)
+{
+    yajl_tape_builder * b = (yajl_tape_builder *) ctx;
+    yajl_tape_count(b);
+    return yajl_tape_push(b, TAPE_WORD(boolean ? 't' : 'f', 0));
+}
+
+static int
+yajl_tape_number(void * ctx, const char * s, size_t l)
+{
+    yajl_tape_builder * b = (yajl_tape_builder *) ctx;
+    const unsigned char * num = (const unsigned char *) s;
+    uint64_t bits;
+    long long i;
+    double d;
+    size_t j;
+
+    yajl_tape_count(b);
+
+    for (j = 0; j < l; j++) {
+        if (s[j] == '.' || s[j] == 'e' || s[j] == 'E') break;
+    }
+    if (j == l) {
+        errno = 0;
+        i = yajl_parse_integer(num, l);
+        if (errno == 0) {
+            return yajl_tape_push(b, TAPE_WORD('l', 0)) &&
+                yajl_tape_push(b, (uint64_t) i);
+        }
+    }
+
+    /* on overflow, strtod's infinity is as good as anything */
+    d = yajl_parse_double(num, l);
+    memcpy(&bits, &d, sizeof(bits));
+    return yajl_tape_push(b, TAPE_WORD('d', 0)) && yajl_tape_push(b, bits);
+}
+
+static int
+yajl_tape_string(void * ctx, const unsigned char * s, size_t l)
+{
+    yajl_tape_builder * b = (yajl_tape_builder *) ctx;
+    yajl_tape_count(b);
+    return yajl_tape_add_string(b, s, l);
+}
+
+static int
+yajl_tape_map_key(void * ctx, const unsigned char * s, size_t l)
+{
+    return yajl_tape_add_string((yajl_tape_builder *) ctx, s, l);
+}
+
+static int
+yajl_tape_start(yajl_tape_builder * b, unsigned char tag)
+{
+    yajl_tape_count(b);
+    if (b->depth == b->stackSize &&
+        !yajl_tape_reserve(b, (void **) &b->stack, &b->stackSize, b->depth,
+                           1, sizeof(yajl_tape_open)))
+    {
+        return 0;
+    }
+    b->stack[b->depth].start = b->used;
+    b->stack[b->depth].count = 0;
+    b->depth++;
+    /* the payload is filled in at the end */
+    return yajl_tape_push(b, TAPE_WORD(tag, 0));
+}
+
+static int
+yajl_tape_end(yajl_tape_builder * b, unsigned char tag)
+{
+    yajl_tape_open * o = &b->stack[--b->depth];
+
+    b->words[o->start] = TAPE_WORD(b->words[o->start] >> 56, b->used + 1);
+    return yajl_tape_push(b, TAPE_WORD(tag, o->count));
+}
+
+static int
+yajl_tape_start_map(void * ctx)
+{
+    return yajl_tape_start((yajl_tape_builder *) ctx, '{');
+}
+
+static int
+yajl_tape_end_map(void * ctx)
+{
+    return yajl_tape_end((yajl_tape_builder *) ctx, '}');
+}
+
+static int
+yajl_tape_start_array(void * ctx)
+{
+    return yajl_tape_start((yajl_tape_builder *) ctx, '[');
+}
+
+static int
+yajl_tape_end_array(void * ctx)
+{
+    return yajl_tape_end((yajl_tape_builder *) ctx, ']');
+}
+
+/* copy the finished tape into a single allocation */
+static yajl_tape
+yajl_tape_finish(yajl_tape_builder * b)
+{
+    /* keep the words aligned */
+    size_t header = (sizeof(struct yajl_tape_s) + sizeof(uint64_t) - 1) &
+        ~(sizeof(uint64_t) - 1);
+    size_t wordBytes = b->used * sizeof(uint64_t);
+    unsigned char * p;
+    yajl_tape t;
+
+    p = YA_MALLOC(b->alloc, header + wordBytes + b->stringsUsed);
+    if (p == NULL) {
+        b->outOfMemory = 1;
+        return NULL;
+    }
+
+    t = (yajl_tape) p;
+    t->alloc = *(b->alloc);
+    t->len = b->used;
+    t->words = (const uint64_t *) (p + header);
+    t->strings = p + header + wordBytes;
+    memcpy(p + header, b->words, wordBytes);
+    if (b->stringsUsed > 0) {
+        memcpy(p + header + wordBytes, b->strings, b->stringsUsed);
+    }
+
+    return t;
+}
+
+yajl_tape
+yajl_tape_parse(const unsigned char * input, size_t input_len,
+                unsigned int parse_options, yajl_alloc_funcs * afs,
+                char * error_buffer, size_t error_buffer_size)
+{
+    static const yajl_callbacks callbacks = {
+        yajl_tape_null,
+        yajl_tape_boolean,
+        NULL,
+        NULL,
+        yajl_tape_number,
+        yajl_tape_string,
+        yajl_tape_start_map,
+        yajl_tape_map_key,
+        yajl_tape_end_map,
+        yajl_tape_start_array,
+        yajl_tape_end_array
+    };
+    /* the parser options which make sense for a single document */
+    static const yajl_option parserOptions[] = {
+        yajl_allow_comments,
+        yajl_dont_validate_strings,
+        yajl_allow_trailing_garbage
+    };
+    yajl_tape_builder b;
+    yajl_handle hand;
+    yajl_status stat;
+    yajl_tape t = NULL;
+    size_t i;
+
+    if (error_buffer != NULL && error_buffer_size > 0) error_buffer[0] = 0;
+
+    memset((void *) &b, 0, sizeof(b));
+    hand = yajl_alloc(&callbacks, afs, &b);
+    if (hand == NULL) {
+        if (error_buffer != NULL) {
+            snprintf(error_buffer, error_buffer_size, "Out of memory");
+        }
+        return NULL;
+    }
+    b.alloc = &(hand->alloc);
+
+    for (i = 0; i < sizeof(parserOptions) / sizeof(parserOptions[0]); i++) {
+        if (parse_options & parserOptions[i]) {
+            yajl_config(hand, parserOptions[i], 1);
+        }
+    }
+
+    stat = yajl_parse(hand, input, input_len);
+    if (stat == yajl_status_ok) stat = yajl_complete_parse(hand);
+    if (stat == yajl_status_ok) t = yajl_tape_finish(&b);
+
+    if (t == NULL && error_buffer != NULL && error_buffer_size > 0) {
+        if (b.outOfMemory) {
+            snprintf(error_buffer, error_buffer_size, "Out of memory");
+        } else {
+            unsigned char * str = yajl_get_error(hand, 1, input, input_len);
+            snprintf(error_buffer, error_buffer_size, "%s", (char *) str);
+            yajl_free_error(hand, str);
+        }
+    }
+
+    if (b.words) YA_FREE(b.alloc, b.words);
+    if (b.strings) YA_FREE(b.alloc, b.strings);
+    if (b.stack) YA_FREE(b.alloc, b.stack);
+    yajl_free(hand);
+
+    return t;
+}
+
+void
+yajl_tape_free(yajl_tape t)
+{
+    if (t != NULL) YA_FREE(&(t->alloc), t);
+}
+
+yajl_type
+yajl_tape_type(yajl_tape t, size_t v)
+{
+    if (v >= t->len) return yajl_t_any;
+
+    switch (TAPE_TAG(t->words[v])) {
+        case '"': return yajl_t_string;
+        case 'l': case 'd': return yajl_t_number;
+        case '{': return yajl_t_object;
+        case '[': return yajl_t_array;
+        case 't': return yajl_t_true;
+        case 'f': return yajl_t_false;
+        case 'n': return yajl_t_null;
+        default: return yajl_t_any;
+    }
+}
+
+const char *
+yajl_tape_get_string(yajl_tape t, size_t v, size_t * len)
+{
+    const unsigned char * s;
+    unsigned int len32;
+
+    if (v >= t->len || TAPE_TAG(t->words[v]) != '"') return NULL;
+
+    s = t->strings + TAPE_PAYLOAD(t->words[v]);
+    if (len != NULL) {
+        memcpy(&len32, s, 4);
+        *len = len32;
+    }
+    return (const char *) (s + 4);
+}
+
+int
+yajl_tape_is_integer(yajl_tape t, size_t v)
+{
+    return v < t->len && TAPE_TAG(t->words[v]) == 'l';
+}
+
+long long
+yajl_tape_get_integer(yajl_tape t, size_t v)
+{
+    if (!yajl_tape_is_integer(t, v)) return 0;
+    return (long long) t->words[v + 1];
+}
+
+double
+yajl_tape_get_double(yajl_tape t, size_t v)
+{
+    double d;
+
+    if (v >= t->len) return 0;
+
+    switch (TAPE_TAG(t->words[v])) {
+        case 'l':
+            return (double) (long long) t->words[v + 1];
+        case 'd':
+            memcpy(&d, &t->words[v + 1], sizeof(d));
+            return d;
+        default:
+            return 0;
+    }
+}
+
+size_t
+yajl_tape_len(yajl_tape t, size_t v)
+{
+    unsigned char tag;
+
+    if (v >= t->len) return 0;
+
+    tag = TAPE_TAG(t->words[v]);
+    if (tag != '{' && tag != '[') return 0;
+    return TAPE_PAYLOAD(t->words[TAPE_PAYLOAD(t->words[v]) - 1]);
+}
+
+/* is position v past the end of the current object or array? */
+#define TAPE_AT_END(t, v) ((v) >= (t)->len ||                           \
+                           TAPE_TAG((t)->words[v]) == '}' ||            \
+                           TAPE_TAG((t)->words[v]) == ']')
+
+size_t
+yajl_tape_first(yajl_tape t, size_t v)
+{
+    unsigned char tag;
+
+    if (v >= t->len) return YAJL_TAPE_NONE;
+
+    tag = TAPE_TAG(t->words[v]);
+    if ((tag != '{' && tag != '[') || TAPE_AT_END(t, v + 1)) {
+        return YAJL_TAPE_NONE;
+    }
+    return v + 1;
+}
+
+size_t
+yajl_tape_next(yajl_tape t, size_t v)
+{
+    if (v >= t->len) return YAJL_TAPE_NONE;
+
+    switch (TAPE_TAG(t->words[v])) {
+        case '{': case '[':
+            v = TAPE_PAYLOAD(t->words[v]);
+            break;
+        case 'l': case 'd':
+            v += 2;
+            break;
+        default:
+            v++;
+    }
+    return TAPE_AT_END(t, v) ? YAJL_TAPE_NONE : v;
+}
+
+size_t
+yajl_tape_object_get(yajl_tape t, size_t obj, const char * key, size_t len)
+{
+    size_t k, v;
+    unsigned int len32;
+    const unsigned char * s;
+
+    if (obj >= t->len || TAPE_TAG(t->words[obj]) != '{') {
+        return YAJL_TAPE_NONE;
+    }
+
+    /* keys take one word, so a key's value is right after it */
+    for (k = yajl_tape_first(t, obj); k != YAJL_TAPE_NONE;
+         k = yajl_tape_next(t, v))
+    {
+        v = k + 1;
+        s = t->strings + TAPE_PAYLOAD(t->words[k]);
+        memcpy(&len32, s, 4);
+        if (len32 == len && !memcmp(s + 4, key, len)) return v;
+    }
+    return YAJL_TAPE_NONE;
+}
+
+size_t
+yajl_tape_array_get(yajl_tape t, size_t array, size_t index)
+{
+    size_t v;
+
+    if (array >= t->len || TAPE_TAG(t->words[array]) != '[' ||
+        index >= yajl_tape_len(t, array))
+    {
+        return YAJL_TAPE_NONE;
+    }
+
+    for (v = array + 1; index > 0; index--) v = yajl_tape_next(t, v);
+    return v;
+}
@@ -15,15 +15,22 @@
  */
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 
 #include "api/yajl_tree.h"
 #include "api/yajl_parse.h"
 
 #include "yajl_parser.h"
+#include "yajl_alloc.h"
+#include "yajl_number.h"
+#include "yajl_arena.h"
+#include "yajl_tree_builder.h"
 
 #if defined(_WIN32) || defined(WIN32)
 #define snprintf sprintf_s
@@ -38,6 +45,8 @@ struct stack_elem_s
 {
     char * key;
     yajl_val value;
+    /* where the children of "value" start on the scratch stack */
+    size_t base;
     stack_elem_t *next;
 };
 
@@ -47,60 +56,236 @@ struct context_s
     yajl_val root;
     char *errbuf;
     size_t errbuf_size;
+    /* where the tree is allocated from, NULL for the heap */
+    yajl_arena arena;
+    /* the allocation functions of the parser, used for the heap */
+    yajl_alloc_funcs *afs;
+    /* non-zero to give the root a "tree_root_t" */
+    int root_header;
+    /* the value allocated with a "tree_root_t", if any */
+    yajl_val header_value;
+    /* non-zero to index the keys of large objects, see "index_build" */
+    int hash_keys;
+    /* non-zero to leave numbers for "yajl_tree_convert_number" */
+    int lazy_numbers;
+    /* the input, when strings are kept in it, see "insitu_string" */
+    unsigned char *insitu;
+    yajl_handle handle;
+    /* stack elements which have been popped, ready for reuse */
+    stack_elem_t *free_stack;
+    /* the children of the open objects and arrays, see "scratch_push" */
+    char **scratch_keys;
+    yajl_val *scratch_values;
+    size_t scratch_len;
+    size_t scratch_size;
 };
 typedef struct context_s context_t;
 
+/*
+ * The hash table over the keys of an object is open addressed with linear
+ * probing.  A slot holds the hash of a key and its position in the object
+ * plus one, zero marking an empty slot.  There are at least twice as many
+ * slots as keys, so probe sequences stay short.
+ */
+typedef struct
+{
+    unsigned int hash;
+    unsigned int pos;
+} index_slot_t;
+
+typedef struct
+{
+    size_t mask;
+    index_slot_t *slots;
+} object_index_t;
+
+/*
+ * An object with a hash table is a single block: the value, the table's
+ * header, the keys, then the slots.  See "object_index" for how it's told
+ * apart from other objects.
+ */
+typedef struct
+{
+    struct yajl_val_s value;
+    object_index_t index;
+} tree_object_t;
+
+/*
+ * The root of a tree allocated from an arena, with caller supplied
+ * allocation functions, or in situ, carries along what
+ * "yajl_tree_free_root" needs to know to free it.
+ */
+typedef struct
+{
+    yajl_arena arena;
+    yajl_alloc_funcs afs;
+    /* non-zero when strings and keys point into the input */
+    int insitu;
+    tree_object_t object;
+} tree_root_t;
+
+#define TREE_ROOT(v) \
+    ((tree_root_t *) ((char *) (v) - offsetof (tree_root_t, object.value)))
+
 #define RETURN_ERROR(ctx,retval,...) {                                  \
         if ((ctx)->errbuf != NULL)                                      \
             snprintf ((ctx)->errbuf, (ctx)->errbuf_size, __VA_ARGS__);  \
         return (retval);                                                \
     }
 
-static yajl_val value_alloc (yajl_type type)
+/*
+ * Memory for the tree comes either from the heap, one piece at a time, or
+ * from an arena which is released in one go.
+ */
+static void * tree_malloc (context_t *ctx, size_t size)
+{
+    if (ctx->arena != NULL)
+        return (yajl_arena_malloc (ctx->arena, size));
+    return (YA_MALLOC (ctx->afs, size));
+}
+
+static void tree_free (context_t *ctx, void *ptr)
+{
+    if (ctx->arena == NULL && ptr != NULL)
+        YA_FREE (ctx->afs, ptr);
+}
+
+/*
+ * Free a string or key, unless it lives in the input.
+ */
+static void string_free (context_t *ctx, char *str)
+{
+    if (ctx->insitu == NULL)
+        tree_free (ctx, str);
+}
+
+static yajl_val value_alloc (context_t *ctx, yajl_type type)
 {
     yajl_val v;
 
-    v = malloc (sizeof (*v));
-    if (v == NULL) return (NULL);
-    memset (v, 0, sizeof (*v));
+    /* The first value of a document is its root. */
+    if (ctx->root_header && ctx->stack == NULL && ctx->root == NULL)
+    {
+        tree_root_t *r;
+
+        r = tree_malloc (ctx, sizeof (*r));
+        if (r == NULL) return (NULL);
+        memset (r, 0, sizeof (*r));
+        r->arena = ctx->arena;
+        r->afs = *(ctx->afs);
+        r->insitu = (ctx->insitu != NULL);
+        v = &r->object.value;
+        ctx->header_value = v;
+    }
+    else
+    {
+        v = tree_malloc (ctx, sizeof (*v));
+        if (v == NULL) return (NULL);
+        memset (v, 0, sizeof (*v));
+    }
     v->type = type;
 
     return (v);
 }
 
-static void yajl_object_free (yajl_val v)
+/*
+ * The hash table over the keys of object "v", or NULL.  Only "index_build"
+ * puts the keys of an object right behind room for a table, in the same
+ * block as the value, so that's what gives one away.  Nothing but the
+ * value's own members is read to find out, which makes it safe for values
+ * built by an application.
+ */
+static object_index_t * object_index (yajl_val v)
 {
-    size_t i;
-
-    if (!YAJL_IS_OBJECT(v)) return;
-
-    for (i = 0; i < v->u.object.len; i++)
+    if (v->u.object.len >= YAJL_TREE_HASH_MIN &&
+        (uintptr_t) v->u.object.keys ==
+        (uintptr_t) v + sizeof (tree_object_t))
     {
-        free((char *) v->u.object.keys[i]);
-        v->u.object.keys[i] = NULL;
-        yajl_tree_free (v->u.object.values[i]);
-        v->u.object.values[i] = NULL;
+        return (&((tree_object_t *) v)->index);
     }
-
-    free((void*) v->u.object.keys);
-    free(v->u.object.values);
-    free(v);
+    return (NULL);
 }
 
-static void yajl_array_free (yajl_val v)
+/*
+ * Free whatever "v" owns on the heap, but not "v" itself.  "insitu" is
+ * non-zero when strings and keys point into the input.
+ */
+static void value_free (const yajl_alloc_funcs *afs, yajl_val v, int insitu)
 {
     size_t i;
 
-    if (!YAJL_IS_ARRAY(v)) return;
+    if (YAJL_IS_STRING(v))
+    {
+        if (!insitu)
+            YA_FREE(afs, v->u.string);
+    }
+    else if (YAJL_IS_NUMBER(v))
+    {
+        YA_FREE(afs, v->u.number.r);
+    }
+    else if (YAJL_IS_OBJECT(v))
+    {
+        for (i = 0; i < v->u.object.len; i++)
+        {
+            if (!insitu)
+                YA_FREE(afs, (char *) v->u.object.keys[i]);
+            value_free (afs, v->u.object.values[i], insitu);
+            YA_FREE(afs, v->u.object.values[i]);
+        }
 
-    for (i = 0; i < v->u.array.len; i++)
+        if (v->u.object.len > 0)
+        {
+            /* the keys of an indexed object go with the object */
+            if (object_index (v) == NULL)
+                YA_FREE(afs, (void *) v->u.object.keys);
+            YA_FREE(afs, v->u.object.values);
+        }
+    }
+    else if (YAJL_IS_ARRAY(v))
     {
-        yajl_tree_free (v->u.array.values[i]);
-        v->u.array.values[i] = NULL;
+        for (i = 0; i < v->u.array.len; i++)
+        {
+            value_free (afs, v->u.array.values[i], insitu);
+            YA_FREE(afs, v->u.array.values[i]);
+        }
+
+        if (v->u.array.len > 0)
+            YA_FREE(afs, v->u.array.values);
     }
+}
+
+/*
+ * The memory "v" was allocated as, which for the root includes the
+ * "tree_root_t" around it.
+ */
+static void * value_block (context_t *ctx, yajl_val v)
+{
+    if (v == ctx->header_value)
+        return (TREE_ROOT (v));
+    return (v);
+}
 
-    free(v->u.array.values);
-    free(v);
+/*
+ * Give back the memory of "v" itself.
+ */
+static void value_dealloc (context_t *ctx, yajl_val v)
+{
+    tree_free (ctx, value_block (ctx, v));
+    if (v == ctx->header_value)
+        ctx->header_value = NULL;
+}
+
+/*
+ * Free a value which hasn't been added to the tree, along with its
+ * children.
+ */
+static void context_value_free (context_t *ctx, yajl_val v)
+{
+    if (ctx->arena != NULL || v == NULL)
+        return;
+
+    value_free (ctx->afs, v, ctx->insitu != NULL);
+    value_dealloc (ctx, v);
 }
 
 /*
@@ -109,14 +294,190 @@ static void yajl_array_free (yajl_val v)
  * appropriate value is pushed on the stack. When the end of the object is
  * reached (an appropriate closing bracket has been read), the value is popped
  * off the stack and added to the enclosing object using "context_add_value".
+ *
+ * The children of the open objects and arrays are collected on a scratch
+ * stack shared by all of them, a child being pushed after those of its
+ * parent and popped before the parent gets its next one.  Once an object or
+ * array is complete its children are copied, once, into arrays of exactly
+ * the right size, rather than growing those arrays child by child.
  */
+static int scratch_grow (context_t *ctx)
+{
+    size_t size = ctx->scratch_size ? 2 * ctx->scratch_size : 64;
+    char **tmpk;
+    yajl_val *tmpv;
+
+    tmpk = YA_REALLOC (ctx->afs, ctx->scratch_keys, size * sizeof (*tmpk));
+    if (tmpk == NULL) return (-1);
+    ctx->scratch_keys = tmpk;
+
+    tmpv = YA_REALLOC (ctx->afs, ctx->scratch_values, size * sizeof (*tmpv));
+    if (tmpv == NULL) return (-1);
+    ctx->scratch_values = tmpv;
+
+    ctx->scratch_size = size;
+    return (0);
+}
+
+static int scratch_push (context_t *ctx, char *key, yajl_val value)
+{
+    if (ctx->scratch_len == ctx->scratch_size && scratch_grow (ctx) != 0)
+    {
+        /* nothing else refers to them, so they go now */
+        string_free (ctx, key);
+        context_value_free (ctx, value);
+        RETURN_ERROR (ctx, ENOMEM, "Out of memory");
+    }
+
+    ctx->scratch_keys[ctx->scratch_len] = key;
+    ctx->scratch_values[ctx->scratch_len] = value;
+    ctx->scratch_len++;
+
+    return (0);
+}
+
+/*
+ * Does "k" equal the "len" bytes at "key"?  "key" may hold a NUL, which
+ * mustn't end the comparison before "k" does.
+ */
+static int key_equal (const char *k, const char *key, size_t len)
+{
+    return (strlen (k) == len && memcmp (k, key, len) == 0);
+}
+
+/*
+ * Move object "*v", about to get "len" keys, into a block with room for
+ * them and for a hash table over them, see "tree_object_t".  Returns where
+ * the keys go, or NULL if memory ran out, in which case "*v" stays put.
+ */
+static const char ** index_alloc (context_t *ctx, yajl_val *v, size_t len)
+{
+    size_t size = 2 * YAJL_TREE_HASH_MIN;
+    size_t head = 0;
+    void *old = value_block (ctx, *v);
+    char *block;
+    tree_object_t *o;
+    const char **keys;
+
+    while (size < 2 * len)
+        size <<= 1;
+
+    /* the root brings its "tree_root_t" along */
+    if (*v == ctx->header_value)
+        head = offsetof (tree_root_t, object);
+
+    block = tree_malloc (ctx, head + sizeof (*o) + len * sizeof (*keys)
+                         + size * sizeof (index_slot_t));
+    if (block == NULL)
+        return (NULL);
+    memcpy (block, old, head + sizeof (**v));
+    tree_free (ctx, old);
+
+    o = (tree_object_t *) (block + head);
+    keys = (const char **) (o + 1);
+    o->index.mask = size - 1;
+    o->index.slots = (index_slot_t *) (keys + len);
+    memset (o->index.slots, 0, size * sizeof (index_slot_t));
+
+    if (*v == ctx->header_value)
+        ctx->header_value = &o->value;
+    *v = &o->value;
+
+    return (keys);
+}
+
+/*
+ * Build the hash table over the keys of "obj".  Keys are inserted in
+ * order, so of several equal keys the first is found first, just as a
+ * linear scan would.
+ */
+static void index_build (yajl_val obj)
+{
+    object_index_t *idx = object_index (obj);
+    size_t i, j;
+    unsigned int hash;
+    const char *k;
+
+    assert (idx != NULL);
+
+    for (i = 0; i < obj->u.object.len; i++)
+    {
+        k = obj->u.object.keys[i];
+        hash = yajl_tree_key_hash (k, strlen (k));
+        for (j = hash & idx->mask; idx->slots[j].pos != 0;
+             j = (j + 1) & idx->mask)
+            ;
+        idx->slots[j].hash = hash;
+        idx->slots[j].pos = (unsigned int) i + 1;
+    }
+}
+
+/*
+ * Move the children of "*v" from the scratch stack into "*v", which an
+ * object getting a hash table moves along with them.
+ */
+static int scratch_pop (context_t *ctx, yajl_val *v, size_t base)
+{
+    size_t len = ctx->scratch_len - base;
+    yajl_val *values;
+
+    if (len == 0) return (0);
+
+    values = tree_malloc (ctx, len * sizeof (*values));
+    if (values == NULL)
+        RETURN_ERROR (ctx, ENOMEM, "Out of memory");
+    memcpy (values, ctx->scratch_values + base, len * sizeof (*values));
+
+    if (YAJL_IS_OBJECT (*v))
+    {
+        int indexed = ctx->hash_keys && len >= YAJL_TREE_HASH_MIN;
+        const char **keys;
+
+        if (indexed)
+            keys = index_alloc (ctx, v, len);
+        else
+            keys = tree_malloc (ctx, len * sizeof (*keys));
+        if (keys == NULL)
+        {
+            /* the children are freed from the scratch stack */
+            tree_free (ctx, values);
+            RETURN_ERROR (ctx, ENOMEM, "Out of memory");
+        }
+        memcpy ((void *) keys, ctx->scratch_keys + base, len * sizeof (*keys));
+
+        (*v)->u.object.keys = keys;
+        (*v)->u.object.values = values;
+        (*v)->u.object.len = len;
+
+        if (indexed)
+            index_build (*v);
+    }
+    else
+    {
+        (*v)->u.array.values = values;
+        (*v)->u.array.len = len;
+    }
+
+    ctx->scratch_len = base;
+
+    return (0);
+}
+
 static int context_push(context_t *ctx, yajl_val v)
 {
     stack_elem_t *stack;
 
-    stack = malloc (sizeof (*stack));
-    if (stack == NULL)
-        RETURN_ERROR (ctx, ENOMEM, "Out of memory");
+    if (ctx->free_stack != NULL)
+    {
+        stack = ctx->free_stack;
+        ctx->free_stack = stack->next;
+    }
+    else
+    {
+        stack = tree_malloc (ctx, sizeof (*stack));
+        if (stack == NULL)
+            RETURN_ERROR (ctx, ENOMEM, "Out of memory");
+    }
     memset (stack, 0, sizeof (*stack));
 
     assert ((ctx->stack == NULL)
@@ -124,6 +485,7 @@ static int context_push(context_t *ctx, yajl_val v)
             || YAJL_IS_ARRAY (v));
 
     stack->value = v;
+    stack->base = ctx->scratch_len;
     stack->next = ctx->stack;
     ctx->stack = stack;
 
@@ -140,11 +502,14 @@ static yajl_val context_pop(context_t *ctx)
                       "Bottom of stack reached prematurely");
 
     stack = ctx->stack;
-    ctx->stack = stack->next;
-
     v = stack->value;
 
-    free (stack);
+    if (scratch_pop (ctx, &v, stack->base) != 0)
+        return (NULL);
+
+    ctx->stack = stack->next;
+    stack->next = ctx->free_stack;
+    ctx->free_stack = stack;
 
     return (v);
 }
@@ -152,9 +517,6 @@ static yajl_val context_pop(context_t *ctx)
 static int object_add_keyval(context_t *ctx,
                              yajl_val obj, char *key, yajl_val value)
 {
-    const char **tmpk;
-    yajl_val *tmpv;
-
     /* We're checking for NULL in "context_add_value" or its callers. */
     assert (ctx != NULL);
     assert (obj != NULL);
@@ -164,28 +526,12 @@ static int object_add_keyval(context_t *ctx,
     /* We're assuring that "obj" is an object in "context_add_value". */
     assert(YAJL_IS_OBJECT(obj));
 
-    tmpk = realloc((void *) obj->u.object.keys, sizeof(*(obj->u.object.keys)) * (obj->u.object.len + 1));
-    if (tmpk == NULL)
-        RETURN_ERROR(ctx, ENOMEM, "Out of memory");
-    obj->u.object.keys = tmpk;
-
-    tmpv = realloc(obj->u.object.values, sizeof (*obj->u.object.values) * (obj->u.object.len + 1));
-    if (tmpv == NULL)
-        RETURN_ERROR(ctx, ENOMEM, "Out of memory");
-    obj->u.object.values = tmpv;
-
-    obj->u.object.keys[obj->u.object.len] = key;
-    obj->u.object.values[obj->u.object.len] = value;
-    obj->u.object.len++;
-
-    return (0);
+    return (scratch_push (ctx, key, value));
 }
 
 static int array_add_value (context_t *ctx,
                             yajl_val array, yajl_val value)
 {
-    yajl_val *tmp;
-
     /* We're checking for NULL pointers in "context_add_value" or its
      * callers. */
     assert (ctx != NULL);
@@ -195,15 +541,7 @@ static int array_add_value (context_t *ctx,
     /* "context_add_value" will only call us with array values. */
     assert(YAJL_IS_ARRAY(array));
 
-    tmp = realloc(array->u.array.values,
-                  sizeof(*(array->u.array.values)) * (array->u.array.len + 1));
-    if (tmp == NULL)
-        RETURN_ERROR(ctx, ENOMEM, "Out of memory");
-    array->u.array.values = tmp;
-    array->u.array.values[array->u.array.len] = value;
-    array->u.array.len++;
-
-    return 0;
+    return (scratch_push (ctx, NULL, value));
 }
 
 /*
@@ -221,40 +559,34 @@ static int context_add_value (context_t *ctx, yajl_val v)
      *   - There is no value on the stack => This is the only value. This is the
      *     last step done when parsing a document. We assign the value to the
      *     "root" member and return.
-     *   - The value on the stack is an object. In this case store the key on the
-     *     stack or, if the key has already been read, add key and value to the
-     *     object.
+     *   - The value on the stack is an object. In this case add the key
+     *     stored on the stack by "handle_map_key" and the value to the object.
      *   - The value on the stack is an array. In this case simply add the value
      *     and return.
      */
     if (ctx->stack == NULL)
     {
-        assert (ctx->root == NULL);
+        /* a builder's handle allows more than one value, but a document
+         * is only one, see "yajl_tree_builder_parse" */
+        if (ctx->root != NULL)
+        {
+            context_value_free (ctx, v);
+            RETURN_ERROR (ctx, EINVAL, "trailing garbage");
+        }
         ctx->root = v;
         return (0);
     }
     else if (YAJL_IS_OBJECT (ctx->stack->value))
     {
+        char * key;
+
         if (ctx->stack->key == NULL)
-        {
-            if (!YAJL_IS_STRING (v))
-                RETURN_ERROR (ctx, EINVAL, "context_add_value: "
-                              "Object key is not a string (%#04x)",
-                              v->type);
-
-            ctx->stack->key = v->u.string;
-            v->u.string = NULL;
-            free(v);
-            return (0);
-        }
-        else /* if (ctx->key != NULL) */
-        {
-            char * key;
+            RETURN_ERROR (ctx, EINVAL, "context_add_value: "
+                          "Object key is missing");
 
-            key = ctx->stack->key;
-            ctx->stack->key = NULL;
-            return (object_add_keyval (ctx, ctx->stack->value, key, v));
-        }
+        key = ctx->stack->key;
+        ctx->stack->key = NULL;
+        return (object_add_keyval (ctx, ctx->stack->value, key, v));
     }
     else if (YAJL_IS_ARRAY (ctx->stack->value))
     {
@@ -268,67 +600,160 @@ static int context_add_value (context_t *ctx, yajl_val v)
     }
 }
 
+/*
+ * Keep a string or key in the input.  The callback comes just after the
+ * closing quote was lexed.  An unescaped string is already in place in
+ * front of it, and the quote is overwritten to terminate it.  An escaped
+ * one was decoded in place, see "decodeInPlace", and is terminated where
+ * its decoded form ends: decoding never makes a string longer.  Should it
+ * have been decoded elsewhere it's copied back in front of the quote.
+ */
+static char * insitu_string (context_t *ctx,
+                             const unsigned char *string, size_t string_length)
+{
+    unsigned char *end;
+
+    end = ctx->insitu + yajl_get_bytes_consumed (ctx->handle) - 1;
+    assert (*end == '"');
+
+    if (string >= ctx->insitu && string + string_length <= end)
+    {
+        unsigned char *s = ctx->insitu + (string - ctx->insitu);
+        s[string_length] = 0;
+        return ((char *) s);
+    }
+
+    memcpy (end - string_length, string, string_length);
+    *end = 0;
+
+    return ((char *) (end - string_length));
+}
+
 static int handle_string (void *ctx,
                           const unsigned char *string, size_t string_length)
 {
+    context_t *c = (context_t *) ctx;
     yajl_val v;
 
-    v = value_alloc (yajl_t_string);
+    v = value_alloc (c, yajl_t_string);
     if (v == NULL)
-        RETURN_ERROR ((context_t *) ctx, STATUS_ABORT, "Out of memory");
+        RETURN_ERROR (c, STATUS_ABORT, "Out of memory");
 
-    v->u.string = malloc (string_length + 1);
-    if (v->u.string == NULL)
+    if (c->insitu != NULL)
     {
-        free (v);
-        RETURN_ERROR ((context_t *) ctx, STATUS_ABORT, "Out of memory");
+        v->u.string = insitu_string (c, string, string_length);
+    }
+    else
+    {
+        v->u.string = tree_malloc (c, string_length + 1);
+        if (v->u.string == NULL)
+        {
+            value_dealloc (c, v);
+            RETURN_ERROR (c, STATUS_ABORT, "Out of memory");
+        }
+        memcpy(v->u.string, string, string_length);
+        v->u.string[string_length] = 0;
     }
-    memcpy(v->u.string, string, string_length);
-    v->u.string[string_length] = 0;
 
     return ((context_add_value (ctx, v) == 0) ? STATUS_CONTINUE : STATUS_ABORT);
 }
 
+/*
+ * Keys are kept on the stack until their value arrives, they don't need a
+ * value of their own.
+ */
+static int handle_map_key (void *ctx,
+                           const unsigned char *string, size_t string_length)
+{
+    context_t *c = (context_t *) ctx;
+    char *key;
+
+    assert (c->stack != NULL && YAJL_IS_OBJECT (c->stack->value));
+    assert (c->stack->key == NULL);
+
+    if (c->insitu != NULL)
+    {
+        key = insitu_string (c, string, string_length);
+    }
+    else
+    {
+        key = tree_malloc (c, string_length + 1);
+        if (key == NULL)
+            RETURN_ERROR (c, STATUS_ABORT, "Out of memory");
+        memcpy(key, string, string_length);
+        key[string_length] = 0;
+    }
+
+    c->stack->key = key;
+
+    return (STATUS_CONTINUE);
+}
+
+/*
+ * Set the integer and double values of a number from its text.
+ */
+static void number_convert (yajl_val v, size_t len)
+{
+    const unsigned char *r = (const unsigned char *) v->u.number.r;
+    size_t i;
+
+    v->u.number.flags = 0;
+
+    /* a fraction or exponent makes yajl_parse_integer fail, so there's
+     * no need to ask it */
+    for (i = 0; i < len; i++)
+    {
+        if (r[i] == '.' || r[i] == 'e' || r[i] == 'E')
+            break;
+    }
+    if (i == len)
+    {
+        errno = 0;
+        v->u.number.i = yajl_parse_integer(r, len);
+        if (errno == 0)
+            v->u.number.flags |= YAJL_NUMBER_INT_VALID;
+    }
+    else
+    {
+        v->u.number.i = (*r == '-') ? LLONG_MIN : LLONG_MAX;
+    }
+
+    errno = 0;
+    v->u.number.d = yajl_parse_double(r, len);
+    if (errno == 0)
+        v->u.number.flags |= YAJL_NUMBER_DOUBLE_VALID;
+}
+
 static int handle_number (void *ctx, const char *string, size_t string_length)
 {
+    context_t *c = (context_t *) ctx;
     yajl_val v;
-    char *endptr;
 
-    v = value_alloc(yajl_t_number);
+    v = value_alloc(c, yajl_t_number);
     if (v == NULL)
-        RETURN_ERROR((context_t *) ctx, STATUS_ABORT, "Out of memory");
+        RETURN_ERROR(c, STATUS_ABORT, "Out of memory");
 
-    v->u.number.r = malloc(string_length + 1);
+    v->u.number.r = tree_malloc(c, string_length + 1);
     if (v->u.number.r == NULL)
     {
-        free(v);
-        RETURN_ERROR((context_t *) ctx, STATUS_ABORT, "Out of memory");
+        value_dealloc(c, v);
+        RETURN_ERROR(c, STATUS_ABORT, "Out of memory");
     }
     memcpy(v->u.number.r, string, string_length);
     v->u.number.r[string_length] = 0;
 
-    v->u.number.flags = 0;
-
-    errno = 0;
-    v->u.number.i = yajl_parse_integer((const unsigned char *) v->u.number.r,
-                                       strlen(v->u.number.r));
-    if (errno == 0)
-        v->u.number.flags |= YAJL_NUMBER_INT_VALID;
-
-    endptr = NULL;
-    errno = 0;
-    v->u.number.d = strtod(v->u.number.r, &endptr);
-    if ((errno == 0) && (endptr != NULL) && (*endptr == 0))
-        v->u.number.flags |= YAJL_NUMBER_DOUBLE_VALID;
+    /* a lazy number's flags stay zero until "yajl_tree_convert_number" */
+    if (!c->lazy_numbers)
+        number_convert(v, string_length);
 
-    return ((context_add_value(ctx, v) == 0) ? STATUS_CONTINUE : STATUS_ABORT);
+    return ((context_add_value(c, v) == 0) ? STATUS_CONTINUE : STATUS_ABORT);
 }
 
 static int handle_start_map (void *ctx)
 {
     yajl_val v;
 
-    v = value_alloc(yajl_t_object);
+    v = value_alloc(ctx, yajl_t_object);
     if (v == NULL)
         RETURN_ERROR ((context_t *) ctx, STATUS_ABORT, "Out of memory");
 
@@ -354,7 +779,7 @@ static int handle_start_array (void *ctx)
 {
     yajl_val v;
 
-    v = value_alloc(yajl_t_array);
+    v = value_alloc(ctx, yajl_t_array);
     if (v == NULL)
         RETURN_ERROR ((context_t *) ctx, STATUS_ABORT, "Out of memory");
 
@@ -379,7 +804,7 @@ static int handle_boolean (void *ctx, int boolean_value)
 {
     yajl_val v;
 
-    v = value_alloc (boolean_value ? yajl_t_true : yajl_t_false);
+    v = value_alloc (ctx, boolean_value ? yajl_t_true : yajl_t_false);
     if (v == NULL)
         RETURN_ERROR ((context_t *) ctx, STATUS_ABORT, "Out of memory");
 
@@ -390,7 +815,7 @@ static int handle_null (void *ctx)
 {
     yajl_val v;
 
-    v = value_alloc (yajl_t_null);
+    v = value_alloc (ctx, yajl_t_null);
     if (v == NULL)
         RETURN_ERROR ((context_t *) ctx, STATUS_ABORT, "Out of memory");
 
@@ -398,60 +823,344 @@ static int handle_null (void *ctx)
 }
 
 /*
- * Public functions
+ * Release what's left of the parse context.  After an error the stack and
+ * the scratch stack hold the partially built values, none of which has been
+ * added to its parent yet.
  */
-yajl_val yajl_tree_parse (const char *input,
-                          char *error_buffer, size_t error_buffer_size)
+static void context_free (context_t *ctx)
 {
-    static const yajl_callbacks callbacks =
-        {
-            /* null        = */ handle_null,
-            /* boolean     = */ handle_boolean,
-            /* integer     = */ NULL,
-            /* double      = */ NULL,
-            /* number      = */ handle_number,
-            /* string      = */ handle_string,
-            /* start map   = */ handle_start_map,
-            /* map key     = */ handle_string,
-            /* end map     = */ handle_end_map,
-            /* start array = */ handle_start_array,
-            /* end array   = */ handle_end_array
-        };
+    stack_elem_t *stack;
+    size_t i;
 
+    if (ctx->arena != NULL)
+    {
+        /* without a tree to carry it, the arena goes now */
+        if (ctx->root == NULL)
+            yajl_arena_free (ctx->arena);
+        ctx->scratch_len = 0;
+        ctx->stack = NULL;
+        ctx->free_stack = NULL;
+    }
+
+    for (i = 0; i < ctx->scratch_len; i++)
+    {
+        string_free (ctx, ctx->scratch_keys[i]);
+        context_value_free (ctx, ctx->scratch_values[i]);
+    }
+    if (ctx->scratch_size > 0)
+    {
+        YA_FREE (ctx->afs, ctx->scratch_keys);
+        YA_FREE (ctx->afs, ctx->scratch_values);
+    }
+
+    while ((stack = ctx->stack) != NULL)
+    {
+        ctx->stack = stack->next;
+        string_free (ctx, stack->key);
+        context_value_free (ctx, stack->value);
+        tree_free (ctx, stack);
+    }
+
+    while ((stack = ctx->free_stack) != NULL)
+    {
+        ctx->free_stack = stack->next;
+        tree_free (ctx, stack);
+    }
+}
+
+static const yajl_callbacks tree_callbacks =
+    {
+        /* null        = */ handle_null,
+        /* boolean     = */ handle_boolean,
+        /* integer     = */ NULL,
+        /* double      = */ NULL,
+        /* number      = */ handle_number,
+        /* string      = */ handle_string,
+        /* start map   = */ handle_start_map,
+        /* map key     = */ handle_map_key,
+        /* end map     = */ handle_end_map,
+        /* start array = */ handle_start_array,
+        /* end array   = */ handle_end_array
+    };
+
+/* the parser options which make sense for a single tree */
+static const yajl_option tree_parser_options[] =
+    {
+        yajl_allow_comments,
+        yajl_dont_validate_strings,
+        yajl_allow_trailing_garbage
+    };
+
+/*
+ * Parse "input" into a tree.  "insitu" is either NULL or "input", in which
+ * case strings and keys are kept in the input, see "insitu_string".
+ */
+static yajl_val tree_parse (const unsigned char *input, size_t input_len,
+                            unsigned char *insitu,
+                            unsigned int options, unsigned int parse_options,
+                            yajl_alloc_funcs *afs,
+                            char *error_buffer, size_t error_buffer_size)
+{
     yajl_handle handle;
     yajl_status status;
     char * internal_err_str;
-	context_t ctx = { NULL, NULL, NULL, 0 };
+    size_t i;
+	context_t ctx;
 
+	memset (&ctx, 0, sizeof (ctx));
 	ctx.errbuf = error_buffer;
 	ctx.errbuf_size = error_buffer_size;
 
     if (error_buffer != NULL)
         memset (error_buffer, 0, error_buffer_size);
 
-    handle = yajl_alloc (&callbacks, NULL, &ctx);
-    yajl_config(handle, yajl_allow_comments, 1);
+    handle = yajl_alloc (&tree_callbacks, afs, &ctx);
+    if (handle == NULL)
+    {
+        if (error_buffer != NULL)
+            snprintf (error_buffer, error_buffer_size, "Out of memory");
+        return NULL;
+    }
+
+    for (i = 0; i < sizeof (tree_parser_options) /
+                    sizeof (tree_parser_options[0]); i++)
+    {
+        if (parse_options & tree_parser_options[i])
+            yajl_config (handle, tree_parser_options[i], 1);
+    }
+
+    ctx.afs = &(handle->alloc);
+    /* only the root knows how to free such a tree */
+    ctx.root_header = (afs != NULL || insitu != NULL ||
+                       (options & yajl_tree_arena));
+
+    if (options & yajl_tree_hash_keys)
+        ctx.hash_keys = 1;
 
-    status = yajl_parse(handle,
-                        (unsigned char *) input,
-                        strlen (input));
+    if (options & yajl_tree_lazy_numbers)
+        ctx.lazy_numbers = 1;
+
+    ctx.handle = handle;
+    ctx.insitu = insitu;
+    if (insitu != NULL)
+        handle->decodeInPlace = 1;
+
+    if (options & yajl_tree_arena)
+    {
+        ctx.arena = yajl_arena_alloc (&(handle->alloc), input_len);
+        if (ctx.arena == NULL)
+        {
+            if (error_buffer != NULL)
+                snprintf (error_buffer, error_buffer_size, "Out of memory");
+            yajl_free (handle);
+            return NULL;
+        }
+    }
+
+    status = yajl_parse(handle, input, input_len);
     status = yajl_complete_parse (handle);
     if (status != yajl_status_ok) {
         if (error_buffer != NULL && error_buffer_size > 0) {
-               internal_err_str = (char *) yajl_get_error(handle, 1,
-                     (const unsigned char *) input,
-                     strlen(input));
+               /* in situ, the input now has nulls in place of quotes */
+               internal_err_str = (char *) yajl_get_error(handle,
+                     insitu == NULL, input, input_len);
              snprintf(error_buffer, error_buffer_size, "%s", internal_err_str);
              YA_FREE(&(handle->alloc), internal_err_str);
         }
+        if (ctx.arena == NULL && ctx.root_header)
+            yajl_tree_free_root (ctx.root);
+        else if (ctx.arena == NULL)
+            yajl_tree_free (ctx.root);
+        ctx.root = NULL;
+        context_free (&ctx);
         yajl_free (handle);
         return NULL;
     }
 
+    context_free (&ctx);
     yajl_free (handle);
     return (ctx.root);
 }
 
+/*
+ * Public functions
+ */
+yajl_val yajl_tree_parse (const char *input,
+                          char *error_buffer, size_t error_buffer_size)
+{
+    return (yajl_tree_parse_options (input, 0,
+                                     error_buffer, error_buffer_size));
+}
+
+yajl_val yajl_tree_parse_options (const char *input, unsigned int options,
+                                  char *error_buffer, size_t error_buffer_size)
+{
+    return (yajl_tree_parse_buf ((const unsigned char *) input, strlen (input),
+                                 options, yajl_allow_comments, NULL,
+                                 error_buffer, error_buffer_size));
+}
+
+yajl_val yajl_tree_parse_buf (const unsigned char *input, size_t input_len,
+                              unsigned int options, unsigned int parse_options,
+                              yajl_alloc_funcs *afs,
+                              char *error_buffer, size_t error_buffer_size)
+{
+    return (tree_parse (input, input_len, NULL, options, parse_options, afs,
+                        error_buffer, error_buffer_size));
+}
+
+yajl_val yajl_tree_parse_insitu (unsigned char *input, size_t input_len,
+                                 unsigned int options,
+                                 unsigned int parse_options,
+                                 yajl_alloc_funcs *afs,
+                                 char *error_buffer, size_t error_buffer_size)
+{
+    return (tree_parse (input, input_len, input, options, parse_options, afs,
+                        error_buffer, error_buffer_size));
+}
+
+/*
+ * A builder parses one document after another with the same handle and
+ * parse context, rather than setting them up for each, see
+ * "yajl_tree_builder.h".
+ */
+struct yajl_tree_builder_s
+{
+    context_t ctx;
+    yajl_handle handle;
+    unsigned int options;
+    unsigned int parse_options;
+    yajl_alloc_funcs afs;
+};
+
+yajl_tree_builder yajl_tree_builder_alloc (unsigned int options,
+                                           unsigned int parse_options)
+{
+    yajl_alloc_funcs afs;
+    yajl_tree_builder b;
+
+    yajl_set_default_alloc_funcs (&afs);
+    b = YA_MALLOC (&afs, sizeof (*b));
+    if (b == NULL)
+        return (NULL);
+    memset (b, 0, sizeof (*b));
+    b->options = options;
+    b->parse_options = parse_options;
+    b->afs = afs;
+
+    b->ctx.afs = &(b->afs);
+    b->ctx.hash_keys = (options & yajl_tree_hash_keys) != 0;
+    b->ctx.lazy_numbers = (options & yajl_tree_lazy_numbers) != 0;
+    b->ctx.root_header = (options & yajl_tree_arena) != 0;
+
+    return (b);
+}
+
+/* (re)start the handle, which is dropped after an error */
+static int tree_builder_start (yajl_tree_builder b)
+{
+    size_t i;
+
+    b->handle = yajl_alloc (&tree_callbacks, &(b->afs), &(b->ctx));
+    if (b->handle == NULL)
+        return (-1);
+
+    for (i = 0; i < sizeof (tree_parser_options) /
+                    sizeof (tree_parser_options[0]); i++)
+    {
+        if (b->parse_options & tree_parser_options[i])
+            yajl_config (b->handle, tree_parser_options[i], 1);
+    }
+    /* to carry on with the next document once one is complete */
+    yajl_config (b->handle, yajl_allow_multiple_values, 1);
+    b->ctx.handle = b->handle;
+
+    return (0);
+}
+
+yajl_val yajl_tree_builder_parse (yajl_tree_builder b,
+                                  const unsigned char *input,
+                                  size_t input_len,
+                                  char *error_buffer,
+                                  size_t error_buffer_size)
+{
+    context_t *ctx = &(b->ctx);
+    yajl_status status;
+    yajl_val root;
+
+    ctx->errbuf = error_buffer;
+    ctx->errbuf_size = error_buffer_size;
+    if (error_buffer != NULL)
+        memset (error_buffer, 0, error_buffer_size);
+
+    if (b->handle == NULL && tree_builder_start (b) != 0)
+    {
+        if (error_buffer != NULL)
+            snprintf (error_buffer, error_buffer_size, "Out of memory");
+        return NULL;
+    }
+
+    if (b->options & yajl_tree_arena)
+    {
+        ctx->arena = yajl_arena_alloc (ctx->afs, input_len);
+        if (ctx->arena == NULL)
+        {
+            if (error_buffer != NULL)
+                snprintf (error_buffer, error_buffer_size, "Out of memory");
+            return NULL;
+        }
+    }
+
+    status = yajl_parse (b->handle, input, input_len);
+    if (status == yajl_status_ok)
+        status = yajl_complete_parse (b->handle);
+
+    if (status != yajl_status_ok)
+    {
+        if (error_buffer != NULL && error_buffer_size > 0)
+        {
+            unsigned char *str = yajl_get_error (b->handle, 1, input,
+                                                 input_len);
+            snprintf (error_buffer, error_buffer_size, "%s", (char *) str);
+            yajl_free_error (b->handle, str);
+        }
+        if (ctx->arena == NULL)
+            yajl_tree_free (ctx->root);
+        ctx->root = NULL;
+        context_free (ctx);
+        ctx->header_value = NULL;
+        ctx->stack = NULL;
+        ctx->free_stack = NULL;
+        ctx->scratch_keys = NULL;
+        ctx->scratch_values = NULL;
+        ctx->scratch_len = ctx->scratch_size = 0;
+        ctx->arena = NULL;
+        yajl_free (b->handle);
+        b->handle = NULL;
+        return NULL;
+    }
+
+    root = ctx->root;
+    ctx->root = NULL;
+    ctx->header_value = NULL;
+    if (ctx->arena != NULL)
+    {
+        /* the arena, and the stack elements kept for reuse in it, are
+         * the tree's now */
+        ctx->arena = NULL;
+        ctx->free_stack = NULL;
+    }
+    return (root);
+}
+
+void yajl_tree_builder_free (yajl_tree_builder b)
+{
+    if (b->handle != NULL)
+        yajl_free (b->handle);
+    context_free (&(b->ctx));
+    YA_FREE (&(b->afs), b);
+}
+
 yajl_val yajl_tree_get(yajl_val n, const char ** path, yajl_type type)
 {
     if (!path) return NULL;
@@ -460,6 +1169,14 @@ yajl_val yajl_tree_get(yajl_val n, const char ** path, yajl_type type)
         size_t len;
 
         if (n->type != yajl_t_object) return NULL;
+        if (object_index(n) != NULL) {
+            len = strlen(*path);
+            n = yajl_tree_object_get(n, *path, len,
+                                     yajl_tree_key_hash(*path, len));
+            if (n == NULL) return NULL;
+            path++;
+            continue;
+        }
         len = n->u.object.len;
         for (i = 0; i < len; i++) {
             if (!strcmp(*path, n->u.object.keys[i])) {
@@ -474,30 +1191,262 @@ yajl_val yajl_tree_get(yajl_val n, const char ** path, yajl_type type)
     return n;
 }
 
-void yajl_tree_free (yajl_val v)
+/* 32 bit FNV-1a */
+unsigned int yajl_tree_key_hash(const char * key, size_t len)
 {
-    if (v == NULL) return;
+    const unsigned char * p = (const unsigned char *) key;
+    unsigned int hash = 2166136261U;
+    size_t i;
 
-    if (YAJL_IS_STRING(v))
+    for (i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+yajl_val yajl_tree_object_get(yajl_val obj, const char * key, size_t len,
+                              unsigned int hash)
+{
+    const object_index_t * idx;
+    size_t i;
+
+    if (!YAJL_IS_OBJECT(obj)) return NULL;
+
+    idx = object_index(obj);
+    if (idx == NULL) {
+        for (i = 0; i < obj->u.object.len; i++) {
+            if (key_equal(obj->u.object.keys[i], key, len))
+                return obj->u.object.values[i];
+        }
+        return NULL;
+    }
+
+    for (i = hash & idx->mask; idx->slots[i].pos != 0;
+         i = (i + 1) & idx->mask)
     {
-        free(v->u.string);
-        free(v);
+        const index_slot_t * s = &idx->slots[i];
+
+        if (s->hash == hash && key_equal(obj->u.object.keys[s->pos - 1],
+                                         key, len))
+            return obj->u.object.values[s->pos - 1];
     }
-    else if (YAJL_IS_NUMBER(v))
+    return NULL;
+}
+
+/*
+ * A compiled JSON Pointer is a single block: the header, the steps, then
+ * the unescaped keys of the steps, each null terminated.
+ */
+typedef struct
+{
+    const char *key;
+    size_t len;
+    unsigned int hash;
+    /* the array index "key" spells, or (size_t) -1 if it isn't one */
+    size_t index;
+} path_step_t;
+
+struct yajl_path_s
+{
+    size_t len;
+    path_step_t *steps;
+};
+
+/*
+ * The array index spelt by a reference token: digits without a leading
+ * zero.
+ */
+static size_t path_index (const char *key, size_t len)
+{
+    size_t i, index = 0;
+
+    if (len == 0 || (len > 1 && key[0] == '0'))
+        return ((size_t) -1);
+
+    for (i = 0; i < len; i++)
     {
-        free(v->u.number.r);
-        free(v);
+        if (key[i] < '0' || key[i] > '9' ||
+            index > ((size_t) -2 - (size_t) (key[i] - '0')) / 10)
+            return ((size_t) -1);
+        index = index * 10 + (size_t) (key[i] - '0');
     }
-    else if (YAJL_GET_OBJECT(v))
+
+    return (index);
+}
+
+yajl_path yajl_path_compile (const char *pointer,
+                             char *error_buffer, size_t error_buffer_size)
+{
+    yajl_path path;
+    size_t steps = 0;
+    size_t i;
+    const char *p;
+    char *key;
+
+    if (error_buffer != NULL && error_buffer_size > 0)
+        error_buffer[0] = 0;
+
+    if (*pointer != 0 && *pointer != '/')
     {
-        yajl_object_free(v);
+        if (error_buffer != NULL)
+            snprintf (error_buffer, error_buffer_size,
+                      "JSON pointer must be empty or start with '/'");
+        return (NULL);
     }
-    else if (YAJL_GET_ARRAY(v))
+
+    for (p = pointer; *p != 0; p++)
     {
-        yajl_array_free(v);
+        if (*p == '/')
+            steps++;
+        else if (*p == '~' && p[1] != '0' && p[1] != '1')
+        {
+            if (error_buffer != NULL)
+                snprintf (error_buffer, error_buffer_size,
+                          "invalid escape in JSON pointer at offset %u, "
+                          "'~' must be followed by '0' or '1'",
+                          (unsigned int) (p - pointer));
+            return (NULL);
+        }
     }
-    else /* if (yajl_t_true or yajl_t_false or yajl_t_null) */
+
+    /* the keys are no longer than the pointer with its '/'s */
+    path = malloc (sizeof (*path) + steps * sizeof (path_step_t)
+                   + (size_t) (p - pointer) + 1);
+    if (path == NULL)
     {
-        free(v);
+        if (error_buffer != NULL)
+            snprintf (error_buffer, error_buffer_size, "Out of memory");
+        return (NULL);
     }
+    path->len = steps;
+    path->steps = (path_step_t *) (path + 1);
+    key = (char *) (path->steps + steps);
+
+    for (p = pointer, i = 0; i < steps; i++)
+    {
+        path_step_t *step = &path->steps[i];
+
+        step->key = key;
+        for (p++; *p != 0 && *p != '/'; p++)
+        {
+            if (*p == '~')
+                *key++ = (*++p == '0') ? '~' : '/';
+            else
+                *key++ = *p;
+        }
+        *key++ = 0;
+
+        step->len = (size_t) (key - step->key) - 1;
+        step->hash = yajl_tree_key_hash (step->key, step->len);
+        step->index = path_index (step->key, step->len);
+    }
+
+    return (path);
+}
+
+void yajl_path_free (yajl_path path)
+{
+    free (path);
+}
+
+yajl_val yajl_tree_get_compiled (yajl_val n, yajl_path path, yajl_type type)
+{
+    const path_step_t *step, *end;
+
+    if (path == NULL) return NULL;
+
+    for (step = path->steps, end = step + path->len; n && step < end; step++)
+    {
+        if (YAJL_IS_OBJECT (n))
+            n = yajl_tree_object_get (n, step->key, step->len, step->hash);
+        else if (YAJL_IS_ARRAY (n) && step->index < n->u.array.len)
+            n = n->u.array.values[step->index];
+        else
+            return NULL;
+    }
+    if (n && type != yajl_t_any && type != n->type) n = NULL;
+    return n;
+}
+
+yajl_val yajl_tree_convert_number (yajl_val v)
+{
+    struct yajl_val_s n;
+    int saved_errno;
+
+    /* A number neither of whose values is valid yet may not have been
+     * converted.  Should converting it give nothing either, it's left as
+     * it is, so reading a tree never writes to it once it's converted. */
+    if (YAJL_IS_NUMBER (v) && v->u.number.flags == 0 &&
+        v->u.number.r != NULL)
+    {
+        /* looking at a number shouldn't disturb errno */
+        saved_errno = errno;
+        n = *v;
+        number_convert (&n, strlen (n.u.number.r));
+        if (n.u.number.flags != 0)
+            v->u.number = n.u.number;
+        errno = saved_errno;
+    }
+
+    return (v);
+}
+
+int yajl_tree_get_integer (yajl_val v, long long *i)
+{
+    if (!YAJL_IS_NUMBER (v))
+        return (0);
+
+    yajl_tree_convert_number (v);
+    if (!(v->u.number.flags & YAJL_NUMBER_INT_VALID))
+        return (0);
+
+    if (i != NULL)
+        *i = v->u.number.i;
+    return (1);
+}
+
+int yajl_tree_get_double (yajl_val v, double *d)
+{
+    if (!YAJL_IS_NUMBER (v))
+        return (0);
+
+    yajl_tree_convert_number (v);
+    if (!(v->u.number.flags & YAJL_NUMBER_DOUBLE_VALID))
+        return (0);
+
+    if (d != NULL)
+        *d = v->u.number.d;
+    return (1);
+}
+
+void yajl_tree_free (yajl_val v)
+{
+    yajl_alloc_funcs afs;
+
+    if (v == NULL) return;
+
+    yajl_set_default_alloc_funcs (&afs);
+    value_free (&afs, v, 0);
+    free (v);
+}
+
+void yajl_tree_free_root (yajl_val root)
+{
+    tree_root_t *r;
+    yajl_alloc_funcs afs;
+
+    if (root == NULL) return;
+
+    r = TREE_ROOT (root);
+    if (r->arena != NULL)
+    {
+        /* The whole tree goes at once, along with its root. */
+        yajl_arena_free (r->arena);
+        return;
+    }
+
+    afs = r->afs;
+    value_free (&afs, root, r->insitu);
+    YA_FREE (&afs, r);
 }
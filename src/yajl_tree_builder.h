@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2007-2014, Lloyd Hilaiel <me@lloyd.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __YAJL_TREE_BUILDER_H__
+#define __YAJL_TREE_BUILDER_H__
+
+#include "api/yajl_tree.h"
+
+/*
+ * Parses many small documents into trees of their own, as
+ * yajl_tree_parse_buf() would, but keeps the parser and its buffers from
+ * one document to the next.  The trees it returns are freed with
+ * yajl_tree_free(), or yajl_tree_free_root() if they're allocated from an
+ * arena, and may outlive the builder.
+ */
+typedef struct yajl_tree_builder_s * yajl_tree_builder;
+
+yajl_tree_builder yajl_tree_builder_alloc(unsigned int options,
+                                          unsigned int parse_options);
+
+yajl_val yajl_tree_builder_parse(yajl_tree_builder b,
+                                 const unsigned char * input,
+                                 size_t inputLen,
+                                 char * errorBuffer,
+                                 size_t errorBufferSize);
+
+void yajl_tree_builder_free(yajl_tree_builder b);
+
+#endif
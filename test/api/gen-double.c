@@ -0,0 +1,63 @@
+/* ensure that doubles are generated as the shortest text that reads
+ * back as the same value, or rounded when a precision is set */
+
+#include <yajl/yajl_gen.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHK(x) if (x != yajl_gen_status_ok) return 1;
+
+static int check(int precision, const double * numbers, const char * want)
+{
+  yajl_gen yg;
+  const unsigned char * buf;
+  size_t len;
+  int rv;
+
+  yg = yajl_gen_alloc(NULL);
+  if (!yajl_gen_config(yg, yajl_gen_double_precision, precision)) return 1;
+  CHK(yajl_gen_array_open(yg));
+  for (; *numbers != 42.0; numbers++) CHK(yajl_gen_double(yg, *numbers));
+  CHK(yajl_gen_array_close(yg));
+  CHK(yajl_gen_get_buf(yg, &buf, &len));
+
+  rv = (len != strlen(want) || memcmp(buf, want, len));
+  if (rv) printf("got %.*s\nwant %s\n", (int) len, (const char *) buf, want);
+  yajl_gen_free(yg);
+  return rv;
+}
+
+int main(void) {
+  static const double numbers[] = {
+    0.1, -0.0, 1.0, 100.0, 0.3, 1.0 / 3, 123.456, 1e21, 1e20, 1e-6, 1.5e-7,
+    -2.5e-300, 5e-324, 1.7976931348623157e308, 42.0
+  };
+  static const double big[] = {
+    -1.7976931348623157e308, 1.7976931348623157e308, 1.797693134862315e308,
+    -1e308, 42.0
+  };
+
+  if (check(0, numbers,
+            "[0.1,-0.0,1.0,100.0,0.3,0.3333333333333333,123.456,1e+21,"
+            "100000000000000000000.0,0.000001,1.5e-7,-2.5e-300,5e-324,"
+            "1.7976931348623157e+308]"))
+  {
+    return 1;
+  }
+  if (check(3, numbers,
+            "[0.1,-0.0,1.0,100.0,0.3,0.333,123.0,1e+21,"
+            "100000000000000000000.0,0.000001,1.5e-7,-2.5e-300,4.94e-324,"
+            "1.7976931348623157e+308]"))
+  {
+    return 1;
+  }
+  /* rounded past DBL_MAX or not, the text must read back */
+  if (check(2, big, "[-1.7976931348623157e+308,1.7976931348623157e+308,"
+                    "1.797693134862315e+308,-1e+308]") ||
+      check(16, big, "[-1.7976931348623157e+308,1.7976931348623157e+308,"
+                     "1.797693134862315e+308,-1e+308]"))
+  {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+/* ensure that strings escaped, and optionally validated, a block at a
+ * time match a byte at a time reference, on strings of every length
+ * around the block sizes with the interesting bytes moved about */
+
+#include <yajl/yajl_gen.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t encode(unsigned char * out, const unsigned char * s,
+                     size_t len, int solidus)
+{
+  const char * hex = "0123456789ABCDEF";
+  size_t i, n = 0;
+
+  out[n++] = '"';
+  for (i = 0; i < len; i++) {
+    unsigned char c = s[i];
+    const char * e = NULL;
+    switch (c) {
+      case '\r': e = "\\r"; break;
+      case '\n': e = "\\n"; break;
+      case '\\': e = "\\\\"; break;
+      case '/': if (solidus) e = "\\/"; break;
+      case '"': e = "\\\""; break;
+      case '\f': e = "\\f"; break;
+      case '\b': e = "\\b"; break;
+      case '\t': e = "\\t"; break;
+      default: break;
+    }
+    if (e != NULL) {
+      out[n++] = (unsigned char) e[0];
+      out[n++] = (unsigned char) e[1];
+    } else if (c < 0x20) {
+      memcpy(out + n, "\\u00", 4);
+      out[n + 4] = (unsigned char) hex[c >> 4];
+      out[n + 5] = (unsigned char) hex[c & 0xf];
+      n += 6;
+    } else {
+      out[n++] = c;
+    }
+  }
+  out[n++] = '"';
+  return n;
+}
+
+/* the lenient check yajl has always made */
+static int valid(const unsigned char * s, size_t len)
+{
+  size_t i = 0, n, j;
+  while (i < len) {
+    if (s[i] <= 0x7f) n = 0;
+    else if ((s[i] >> 5) == 0x6) n = 1;
+    else if ((s[i] >> 4) == 0x0e) n = 2;
+    else if ((s[i] >> 3) == 0x1e) n = 3;
+    else return 0;
+    if (len - i <= n) return 0;
+    for (j = 1; j <= n; j++) if ((s[i + j] >> 6) != 0x2) return 0;
+    i += n + 1;
+  }
+  return 1;
+}
+
+static const char * pieces[] = {
+  "a", "a", "a", "a", "a", "a", "/", "\"", "\\", "\n", "\x01", "\x1f",
+  "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80",
+  /* accepted by the lenient check but not strictly valid */
+  "\xc0\x80", "\xed\xa0\x80", "\xf7\xbf\xbf\xbf",
+  /* invalid */
+  "\xff", "\xc3", "\x80"
+};
+
+static int check(const unsigned char * s, size_t len, unsigned int flags)
+{
+  static unsigned char want[512];
+  const unsigned char * buf;
+  size_t wantLen, bufLen;
+  yajl_gen_status st;
+  yajl_gen g = yajl_gen_alloc(NULL);
+  int ok = 1;
+
+  if (flags) yajl_gen_config(g, flags, 1);
+  if (flags & yajl_gen_escape_solidus) {
+    yajl_gen_config(g, yajl_gen_validate_utf8, 1);
+    flags |= yajl_gen_validate_utf8;
+  }
+  st = yajl_gen_string(g, s, len);
+  yajl_gen_get_buf(g, &buf, &bufLen);
+
+  if ((flags & yajl_gen_validate_utf8) && !valid(s, len)) {
+    ok = (st == yajl_gen_invalid_string && bufLen == 0);
+  } else {
+    wantLen = encode(want, s, len, flags & yajl_gen_escape_solidus);
+    ok = (st == yajl_gen_status_ok && bufLen == wantLen &&
+          !memcmp(buf, want, wantLen));
+  }
+  if (!ok) {
+    size_t i;
+    printf("flags %u, status %d, input:", flags, (int) st);
+    for (i = 0; i < len; i++) printf(" %02x", s[i]);
+    printf("\ngot %.*s\n", (int) bufLen, (const char *) buf);
+  }
+  yajl_gen_free(g);
+  return ok;
+}
+
+int main(void) {
+  static const unsigned int flags[] = {
+    0, yajl_gen_validate_utf8, yajl_gen_escape_solidus
+  };
+  unsigned char s[128];
+  unsigned int seed = 1;
+  int round;
+
+  for (round = 0; round < 20000; round++) {
+    size_t len = 0, target, f;
+
+    seed = seed * 1103515245 + 12345;
+    target = (seed >> 16) % 100;
+    /* mostly plain text, with the odd piece which needs care */
+    while (len < target) {
+      const char * p;
+      size_t pl;
+      seed = seed * 1103515245 + 12345;
+      p = pieces[(seed >> 16) % 40 < 34 ? 0 :
+                 (seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+      pl = strlen(p);
+      if (len + pl > sizeof(s)) break;
+      memcpy(s + len, p, pl);
+      len += pl;
+    }
+    for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+      if (!check(s, len, flags[f])) return 1;
+    }
+  }
+
+  /* control characters without a short escape, NUL included */
+  if (!check((const unsigned char *) "\0\x0b", 2, 0)) return 1;
+  if (!check((const unsigned char *) "", 0, yajl_gen_validate_utf8)) return 1;
+  return 0;
+}
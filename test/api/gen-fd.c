@@ -0,0 +1,101 @@
+/* ensure that output written to a file descriptor is what the internal
+ * buffer would have held, however it was batched up */
+
+/* for fileno */
+#define _POSIX_C_SOURCE 200112L
+
+#include <yajl/yajl_gen.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (x != yajl_gen_status_ok) return 1;
+
+static unsigned char big[200000];
+
+static yajl_gen_status generate(yajl_gen g) {
+  yajl_gen_status s;
+  int i;
+
+  if ((s = yajl_gen_array_open(g)) != yajl_gen_status_ok) return s;
+  for (i = 0; i < 20000; i++) {
+    if ((s = yajl_gen_string(g, (const unsigned char *) "some text", 9)) ||
+        (s = yajl_gen_integer(g, i)))
+      return s;
+    /* a string too big to be copied, now and again */
+    if (i % 5000 == 0 &&
+        (s = yajl_gen_string(g, big, sizeof(big) - (size_t) i)))
+      return s;
+  }
+  return yajl_gen_array_close(g);
+}
+
+static int check(int threshold) {
+  const unsigned char * want;
+  size_t wantLen, got;
+  unsigned char * buf;
+  yajl_gen g, fg;
+  FILE * f = tmpfile();
+  int rv;
+
+  if (f == NULL) return 1;
+  g = yajl_gen_alloc(NULL);
+  fg = yajl_gen_alloc(NULL);
+  yajl_gen_config(g, yajl_gen_beautify, 1);
+  yajl_gen_config(fg, yajl_gen_beautify, 1);
+  if (!yajl_gen_config(fg, yajl_gen_output_fd, fileno(f))) return 1;
+  if (threshold && !yajl_gen_config(fg, yajl_gen_flush_threshold, threshold))
+    return 1;
+
+  CHK(generate(g));
+  CHK(generate(fg));
+  /* a complete document is written out without being asked */
+  if (yajl_gen_get_buf(fg, &want, &got) != yajl_gen_no_buf) return 1;
+  CHK(yajl_gen_get_buf(g, &want, &wantLen));
+
+  buf = (unsigned char *) malloc(wantLen + 1);
+  rewind(f);
+  got = fread(buf, 1, wantLen + 1, f);
+  rv = (got != wantLen || memcmp(buf, want, wantLen));
+  if (rv) printf("threshold %d: wrote %lu bytes, want %lu\n", threshold,
+                 (unsigned long) got, (unsigned long) wantLen);
+
+  free(buf);
+  yajl_gen_free(g);
+  yajl_gen_free(fg);
+  fclose(f);
+  return rv;
+}
+
+int main(void) {
+  yajl_gen g;
+  FILE * f;
+  int fd;
+
+  memset(big, 'x', sizeof(big));
+  if (check(0) || check(1) || check(100) || check(70000) ||
+      check(100000000))
+  {
+    return 1;
+  }
+
+  /* a failed write is reported, and leaves the generator in error */
+  if ((f = tmpfile()) == NULL) return 1;
+  fd = fileno(f);
+  g = yajl_gen_alloc(NULL);
+  if (yajl_gen_config(g, yajl_gen_output_fd, -1)) return 1;
+  if (yajl_gen_config(g, yajl_gen_flush_threshold, 0)) return 1;
+  yajl_gen_config(g, yajl_gen_output_fd, fd);
+  yajl_gen_config(g, yajl_gen_flush_threshold, 4);
+  fclose(f);
+  CHK(yajl_gen_array_open(g));
+  if (yajl_gen_string(g, (const unsigned char *) "lost", 4) !=
+      yajl_gen_write_error)
+    return 1;
+  if (yajl_gen_null(g) != yajl_gen_in_error_state) return 1;
+  if (yajl_gen_flush(g) != yajl_gen_write_error) return 1;
+  yajl_gen_free(g);
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+/* ensure that a print callback gets the same output as the buffer does,
+ * in a few large blocks, and gets all of it on yajl_gen_flush */
+
+#include <yajl/yajl_gen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (x != yajl_gen_status_ok) return 1;
+
+typedef struct {
+  char * text;
+  size_t len;
+  size_t calls;
+} sink;
+
+static void print(void * ctx, const char * str, size_t len) {
+  sink * s = (sink *) ctx;
+  memcpy(s->text + s->len, str, len);
+  s->len += len;
+  s->calls++;
+}
+
+/* 20k beautified values, a long string, and the end of the document */
+static int generate(yajl_gen g, sink * s, size_t * before) {
+  static char big[100000];
+  int i;
+
+  memset(big, 'x', sizeof(big));
+  yajl_gen_config(g, yajl_gen_beautify, 1);
+  CHK(yajl_gen_map_open(g));
+  CHK(yajl_gen_string(g, (const unsigned char *) "list", 4));
+  CHK(yajl_gen_array_open(g));
+  for (i = 0; i < 20000; i++) {
+    CHK(yajl_gen_integer(g, i));
+    CHK(yajl_gen_string(g, (const unsigned char *) "a\"b", 3));
+  }
+  CHK(yajl_gen_array_close(g));
+  CHK(yajl_gen_string(g, (const unsigned char *) "big", 3));
+  CHK(yajl_gen_string(g, (const unsigned char *) big, sizeof(big)));
+  if (s) {
+    /* what's staged is handed over on a flush */
+    size_t len = s->len;
+    CHK(yajl_gen_flush(g));
+    if (s->len == len) return 1;
+    *before = s->len;
+  }
+  CHK(yajl_gen_map_close(g));
+  return 0;
+}
+
+int main(void) {
+  yajl_gen g = yajl_gen_alloc(NULL);
+  const unsigned char * buf;
+  size_t len, before = 0;
+  sink s;
+
+  /* the same JSON through the buffer */
+  if (generate(g, NULL, NULL)) return 1;
+  CHK(yajl_gen_get_buf(g, &buf, &len));
+
+  s.text = (char *) malloc(len);
+  s.len = s.calls = 0;
+
+  {
+    yajl_gen p = yajl_gen_alloc(NULL);
+    yajl_gen_config(p, yajl_gen_print_callback, print, &s);
+    if (generate(p, &s, &before)) return 1;
+
+    /* the end of the document was handed over without a flush */
+    if (s.len != len || memcmp(s.text, buf, len) || s.len == before) {
+      printf("print callback got %d bytes, want %d\n", (int) s.len,
+             (int) len);
+      return 1;
+    }
+    if (s.calls > 2 * len / (64 * 1024) + 4) {
+      printf("%d calls for %d bytes\n", (int) s.calls, (int) len);
+      return 1;
+    }
+    yajl_gen_free(p);
+  }
+
+  free(s.text);
+  yajl_gen_free(g);
+  return 0;
+}
@@ -0,0 +1,122 @@
+/* ensure that yajl_parse_buffer produces the same callbacks as yajl_parse,
+ * over text which goes back and forth between compact and indented so
+ * the index behind it is put aside and taken up again part way through */
+
+#include <yajl/yajl_parse.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* a hash of every callback and its arguments */
+static unsigned long events;
+
+static void add(char what, const unsigned char * s, size_t l) {
+  size_t i;
+  events = (events ^ (unsigned char) what) * 16777619UL;
+  for (i = 0; i < l; i++) events = (events ^ s[i]) * 16777619UL;
+}
+
+static int on_null(void * ctx) { (void) ctx; add('n', NULL, 0); return 1; }
+static int on_boolean(void * ctx, int b) {
+  (void) ctx; add(b ? 't' : 'f', NULL, 0); return 1;
+}
+static int on_number(void * ctx, const char * s, size_t l) {
+  (void) ctx; add('#', (const unsigned char *) s, l); return 1;
+}
+static int on_string(void * ctx, const unsigned char * s, size_t l) {
+  (void) ctx; add('s', s, l); return 1;
+}
+static int on_map_key(void * ctx, const unsigned char * s, size_t l) {
+  (void) ctx; add('k', s, l); return 1;
+}
+static int on_start_map(void * ctx) { (void) ctx; add('{', NULL, 0); return 1; }
+static int on_end_map(void * ctx) { (void) ctx; add('}', NULL, 0); return 1; }
+static int on_start_array(void * ctx) {
+  (void) ctx; add('[', NULL, 0); return 1;
+}
+static int on_end_array(void * ctx) {
+  (void) ctx; add(']', NULL, 0); return 1;
+}
+
+static yajl_callbacks callbacks = {
+  on_null, on_boolean, NULL, NULL, on_number, on_string,
+  on_start_map, on_map_key, on_end_map, on_start_array, on_end_array
+};
+
+static const char * values[] = {
+  "\"plain\"", "\"  spaced  \"", "\"esc\\\"aped\\\\ \xc3\xa9\"", "-2.5e10",
+  "true", "null", "\"\"", "\"\\\"\\\"\"", "12345"
+};
+
+static char * text;
+static size_t len;
+
+static void put(const char * s, size_t n) {
+  memcpy(text + len, s, n);
+  len += n;
+}
+
+/* a section of objects, compact when indent is zero */
+static void section(unsigned int * seed, int indent) {
+  static const char spaces[] =
+    "                                                ";
+  int i, j;
+
+  put("[", 1);
+  for (i = 0; i < 200; i++) {
+    if (i) put(",", 1);
+    if (indent) { put("\n", 1); put(spaces, (size_t) indent); }
+    put("{", 1);
+    for (j = 0; j < 5; j++) {
+      const char * v;
+      char key[16];
+      *seed = *seed * 1103515245 + 12345;
+      v = values[(*seed >> 16) % (sizeof(values) / sizeof(values[0]))];
+      if (j) put(",", 1);
+      if (indent) { put("\n", 1); put(spaces, (size_t) indent * 2); }
+      sprintf(key, "\"k%d%s\":", j, j == 2 ? "  \\t" : "");
+      put(key, strlen(key));
+      if (indent) put(" ", 1);
+      put(v, strlen(v));
+    }
+    if (indent) { put("\n", 1); put(spaces, (size_t) indent); }
+    put("}", 1);
+  }
+  put("]", 1);
+}
+
+static unsigned long parse(int whole) {
+  yajl_handle h = yajl_alloc(&callbacks, NULL, NULL);
+  yajl_status st;
+
+  events = 2166136261UL;
+  if (whole) {
+    st = yajl_parse_buffer(h, (const unsigned char *) text, len);
+  } else {
+    st = yajl_parse(h, (const unsigned char *) text, len);
+    if (st == yajl_status_ok) st = yajl_complete_parse(h);
+  }
+  yajl_free(h);
+  return st == yajl_status_ok ? events : 0;
+}
+
+int main(void) {
+  unsigned int seed = 1;
+  int s;
+
+  text = malloc(4 * 1024 * 1024);
+  put("[", 1);
+  for (s = 0; s < 60; s++) {
+    if (s) put(",\n", 2);
+    /* indented sections run to a few windows of the index */
+    section(&seed, (s % 3) ? 4 * (s % 5 + 1) : 0);
+  }
+  put("]", 1);
+
+  if (parse(0) == 0 || parse(0) != parse(1)) {
+    printf("yajl_parse_buffer disagrees with yajl_parse\n");
+    return 1;
+  }
+  free(text);
+  return 0;
+}
@@ -0,0 +1,90 @@
+/* ensure that doubles are parsed to the same (correctly rounded) value
+ * strtod gives, through both the callbacks and the tree */
+
+#include <yajl/yajl_parse.h>
+#include <yajl/yajl_tree.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * numbers[] = {
+  "0.0", "-0.0", "0.1", "-2.5e3", "1e23", "1E+2", "1e-22", "1e22",
+  "0.30000000000000004",
+  /* halfway between two doubles, and either side of it */
+  "9007199254740993.0",
+  "1.00000000000000011102230246251565404236316680908203125",
+  "1.00000000000000011102230246251565404236316680908203124",
+  "1.00000000000000011102230246251565404236316680908203126",
+  /* more digits than fit in 64 bits */
+  "3.14159265358979323846264338327950288419716939937510",
+  "123456789012345678901234567890.0",
+  /* at and around the limits */
+  "1.7976931348623157e308", "2.2250738585072014e-308",
+  "2.2250738585072011e-308", "4.9e-324", "2.4703282292062328e-324",
+  "7.2057594037927933e16",
+  NULL
+};
+
+static double parsed;
+
+static int got_double(void * ctx, double d) { (void) ctx; parsed = d; return 1; }
+
+static yajl_callbacks callbacks = {
+  NULL, NULL, NULL, got_double, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+static int check(const char * n) {
+  double want = strtod(n, NULL);
+  yajl_handle h = yajl_alloc(&callbacks, NULL, NULL);
+  yajl_val v;
+  int failed = 0;
+
+  parsed = -1.0;
+  if (yajl_parse(h, (const unsigned char *) n, strlen(n)) !=
+      yajl_status_ok ||
+      yajl_complete_parse(h) != yajl_status_ok ||
+      memcmp(&parsed, &want, sizeof(double)))
+  {
+    printf("%.40s: parsed %.17g, want %.17g\n", n, parsed, want);
+    failed = 1;
+  }
+  yajl_free(h);
+
+  v = yajl_tree_parse(n, NULL, 0);
+  if (v == NULL || !YAJL_IS_DOUBLE(v) ||
+      memcmp(&YAJL_GET_DOUBLE(v), &want, sizeof(double)))
+  {
+    printf("%.40s: tree value doesn't match\n", n);
+    failed = 1;
+  }
+  yajl_tree_free(v);
+  return failed;
+}
+
+/* a one, moved by zeros and put back by the exponent */
+static const unsigned long zeros[] = { 800, 1000, 5000, 2000000, 0 };
+
+int main(void) {
+  const char ** n;
+  const unsigned long * z;
+  int failed = 0;
+
+  for (n = numbers; *n; n++) failed |= check(*n);
+
+  for (z = zeros; *z; z++) {
+    char * buf = malloc(*z + 32);
+    /* 1000...0e-N */
+    buf[0] = '1';
+    memset(buf + 1, '0', *z);
+    sprintf(buf + 1 + *z, "e-%lu", *z);
+    failed |= check(buf);
+    /* 0.000...01eN */
+    memcpy(buf, "0.", 2);
+    memset(buf + 2, '0', *z);
+    sprintf(buf + 2 + *z, "1e%lu", *z + 1);
+    failed |= check(buf);
+    free(buf);
+  }
+
+  return failed;
+}
@@ -0,0 +1,156 @@
+/* ensure that path filters cut the callbacks down to the selected values
+ * and what leads to them, by regenerating the JSON they describe */
+
+#include <yajl/yajl_parse.h>
+#include <yajl/yajl_gen.h>
+#include <stdio.h>
+#include <string.h>
+
+static int on_null(void * ctx) {
+  return yajl_gen_null((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int on_boolean(void * ctx, int b) {
+  return yajl_gen_bool((yajl_gen) ctx, b) == yajl_gen_status_ok;
+}
+
+static int on_number(void * ctx, const char * s, size_t l) {
+  return yajl_gen_number((yajl_gen) ctx, s, l) == yajl_gen_status_ok;
+}
+
+static int on_string(void * ctx, const unsigned char * s, size_t l) {
+  return yajl_gen_string((yajl_gen) ctx, s, l) == yajl_gen_status_ok;
+}
+
+static int on_start_map(void * ctx) {
+  return yajl_gen_map_open((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int on_end_map(void * ctx) {
+  return yajl_gen_map_close((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int on_start_array(void * ctx) {
+  return yajl_gen_array_open((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int on_end_array(void * ctx) {
+  return yajl_gen_array_close((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static yajl_callbacks callbacks = {
+  on_null, on_boolean, NULL, NULL, on_number, on_string,
+  on_start_map, on_string, on_end_map, on_start_array, on_end_array
+};
+
+static const char * doc =
+  "{\"id\":1,\"name\":\"a\\u0062\",\"tags\":[\"x\",\"y\"],"
+  "\"meta\":{\"a\":{\"b\":2,\"c\":3},\"d\":[1,{\"e\":4},[{\"e\":5}]]},"
+  "\"a/b\":true,\"~\":null}";
+
+static const struct {
+  const char * text;
+  /* up to three paths */
+  const char * paths[3];
+  /* NULL if the text should fail to parse */
+  const char * want;
+} cases[] = {
+  { NULL, { "/id" }, "{\"id\":1}" },
+  { NULL, { "/name" }, "{\"name\":\"ab\"}" },
+  { NULL, { "/meta/a/b" }, "{\"meta\":{\"a\":{\"b\":2}}}" },
+  { NULL, { "/tags/1" }, "{\"tags\":[\"y\"]}" },
+  /* what might lead somewhere is kept, even if it turns out empty */
+  { NULL, { "/meta/d/*/e" }, "{\"meta\":{\"d\":[{\"e\":4},[]]}}" },
+  { NULL, { "/meta/*/b", "/name" },
+    "{\"name\":\"ab\",\"meta\":{\"a\":{\"b\":2},\"d\":[]}}" },
+  { NULL, { "/meta/a", "/meta/a/c" }, "{\"meta\":{\"a\":{\"b\":2,\"c\":3}}}" },
+  { NULL, { "/a~1b", "/~0" }, "{\"a/b\":true,\"~\":null}" },
+  { NULL, { "/nope" }, "{}" },
+  { NULL, { "/id/x", "/tags/2" }, "{\"tags\":[]}" },
+  { "[{\"a\":1},{\"a\":2,\"b\":[3]},4]", { "/*/a" },
+    "[{\"a\":1},{\"a\":2}]" },
+  { "[1,2,3]", { "/0", "/2" }, "[1,3]" },
+  { "7", { "/0" }, "" },
+  /* skipped values aren't checked, selected ones are */
+  { "{\"a\":[1 2],\"b\":1}", { "/b" }, "{\"b\":1}" },
+  { "{\"a\":[1 2],\"b\":1}", { "/a" }, NULL }
+};
+
+static int parse(const char * text, const char * const * paths, size_t chunk,
+                 char * out, size_t outSize) {
+  yajl_gen g = yajl_gen_alloc(NULL);
+  yajl_handle hand = yajl_alloc(&callbacks, NULL, (void *) g);
+  size_t len = strlen(text), off, i;
+  yajl_status stat = yajl_status_ok;
+  const unsigned char * buf;
+  size_t bufLen;
+  int ok;
+
+  for (i = 0; i < 3 && paths[i]; i++) yajl_add_path_filter(hand, paths[i]);
+
+  for (off = 0; off < len && stat == yajl_status_ok; off += chunk) {
+    stat = yajl_parse(hand, (const unsigned char *) text + off,
+                      off + chunk > len ? len - off : chunk);
+  }
+  if (stat == yajl_status_ok) stat = yajl_complete_parse(hand);
+  ok = stat == yajl_status_ok;
+
+  yajl_gen_get_buf(g, &buf, &bufLen);
+  snprintf(out, outSize, "%.*s", (int) bufLen, (const char *) buf);
+
+  yajl_free(hand);
+  yajl_gen_free(g);
+  return ok;
+}
+
+int main(void) {
+  size_t i, chunk;
+  int failed = 0;
+  char out[512];
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const char * text = cases[i].text ? cases[i].text : doc;
+    const char * want = cases[i].want;
+
+    for (chunk = 1; chunk <= 4; chunk++) {
+      size_t n = chunk == 4 ? strlen(text) : chunk;
+      int ok = parse(text, cases[i].paths, n, out, sizeof(out));
+
+      if (want == NULL ? ok : !ok || strcmp(out, want)) {
+        printf("%s with %s (chunk %d): got %s\n", text, cases[i].paths[0],
+               (int) n, ok ? out : "an error");
+        failed = 1;
+      }
+    }
+  }
+
+  /* "" selects the whole document */
+  {
+    static const char * const root[] = { "", NULL };
+    static const char * const none[] = { NULL };
+    char whole[512];
+
+    if (!parse(doc, root, 1, out, sizeof(out)) ||
+        !parse(doc, none, 1, whole, sizeof(whole)) || strcmp(out, whole))
+    {
+      printf("\"\" didn't select the whole document\n");
+      failed = 1;
+    }
+  }
+
+  /* malformed paths are refused, as are paths once parsing has begun */
+  {
+    yajl_handle hand = yajl_alloc(NULL, NULL, NULL);
+    if (yajl_add_path_filter(hand, "a") || yajl_add_path_filter(hand, "/~2") ||
+        !yajl_add_path_filter(hand, "/a") ||
+        yajl_parse(hand, (const unsigned char *) "{", 1) != yajl_status_ok ||
+        yajl_add_path_filter(hand, "/b"))
+    {
+      printf("yajl_add_path_filter accepted a bad path\n");
+      failed = 1;
+    }
+    yajl_free(hand);
+  }
+
+  return failed;
+}
@@ -0,0 +1,185 @@
+/* ensure that yajl_parse_parallel finds every document however the text
+ * is split between threads, and delivers each once, in order if asked */
+
+#include <yajl/yajl_parallel.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  size_t offset;
+  size_t len;
+  /* -1 for a document which shouldn't parse, or the value of its "n" */
+  long long n;
+} doc;
+
+static char * text;
+static size_t textLen, textSize;
+static doc * docs;
+static size_t ndocs, docsSize;
+
+static void append(const char * s, long long n) {
+  size_t l = strlen(s);
+  while (textLen + l > textSize) {
+    textSize = textSize ? textSize * 2 : 4096;
+    text = (char *) realloc(text, textSize);
+  }
+  if (n != -2) {
+    if (ndocs == docsSize) {
+      docsSize = docsSize ? docsSize * 2 : 256;
+      docs = (doc *) realloc(docs, docsSize * sizeof(doc));
+    }
+    docs[ndocs].offset = textLen;
+    docs[ndocs].len = l;
+    docs[ndocs].n = n;
+    ndocs++;
+  }
+  memcpy(text + textLen, s, l);
+  textLen += l;
+}
+
+/* a mix of newline delimited documents, documents spread over lines,
+ * several on a line, and mistakes */
+static void build(size_t count) {
+  char buf[256];
+  long long i;
+
+  for (i = 0; i < (long long) count; i++) {
+    switch (i % 6) {
+      case 0:
+        sprintf(buf, "{\"n\":%lld,\"s\":\"a]}\\\"[{\"}", i);
+        append(buf, i);
+        append("\n", -2);
+        break;
+      case 1:
+        sprintf(buf, "{\n  \"n\": %lld,\n  \"l\": [\n    1,\n"
+                     "    \"x\\\\\\ny{\"\n  ]\n}", i);
+        append(buf, i);
+        append("\n", -2);
+        break;
+      case 2:
+        sprintf(buf, "{\"n\":%lld}", i);
+        append(buf, i);
+        append(buf, i);
+        append("  ", -2);
+        append("true", 0);
+        append(" ", -2);
+        append("\"str\\\"ing\"", 0);
+        append("\r\n", -2);
+        break;
+      case 3:
+        append("[1 2]", -1);
+        append("\n", -2);
+        append("\"unterminated\n", -1);
+        append("}", -1);
+        append("\n\n", -2);
+        /* two values with nothing between them */
+        append("truefalse", -1);
+        append("\n", -2);
+        break;
+      case 4:
+        sprintf(buf, "[[[[\n\"deep\"]],\n{\"n\":%lld}]]", i);
+        append(buf, 0);
+        append("\t", -2);
+        break;
+      default:
+        sprintf(buf, "%lld", i);
+        append(buf, 0);
+        append(" \n", -2);
+    }
+  }
+}
+
+static size_t seen, stopAfter;
+static unsigned char * delivered;
+static int ordered, failed;
+
+static int check(void * ctx, size_t offset, size_t len, yajl_val v,
+                 const char * error) {
+  size_t lo = 0, hi = ndocs, i;
+  (void) ctx;
+
+  /* find the document */
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (docs[mid].offset < offset) lo = mid + 1;
+    else hi = mid;
+  }
+  i = lo;
+  if (i == ndocs || docs[i].offset != offset || docs[i].len != len ||
+      delivered[i] || (ordered && i != seen) ||
+      (docs[i].n == -1) != (v == NULL) || (v == NULL && error == NULL))
+  {
+    printf("unexpected document at %d: %.*s\n", (int) offset, (int) len,
+           text + offset);
+    failed = 1;
+    return 0;
+  }
+  if (YAJL_IS_OBJECT(v)) {
+    const char * path[] = { "n", NULL };
+    yajl_val n = yajl_tree_get(v, path, yajl_t_number);
+    if (n == NULL || YAJL_GET_INTEGER(n) != docs[i].n) {
+      printf("wrong document at %d\n", (int) offset);
+      failed = 1;
+    }
+  }
+  delivered[i] = 1;
+  return ++seen != stopAfter;
+}
+
+static void run(unsigned int threads, unsigned int options,
+                unsigned int treeOptions, size_t stop) {
+  yajl_status stat, want;
+  size_t i;
+
+  memset(delivered, 0, ndocs);
+  seen = 0;
+  stopAfter = stop;
+  ordered = options & yajl_parallel_ordered;
+
+  stat = yajl_parse_parallel((const unsigned char *) text, textLen, threads,
+                             options, treeOptions, 0, check, NULL);
+  want = stop ? yajl_status_client_canceled : yajl_status_ok;
+  if (stat != want || (stop ? seen != stop : seen != ndocs)) {
+    printf("%u threads, options %u: %s after %d of %d documents\n", threads,
+           options, yajl_status_to_string(stat), (int) seen, (int) ndocs);
+    failed = 1;
+  }
+  for (i = 0; !stop && i < ndocs; i++) {
+    if (!delivered[i]) {
+      printf("%u threads: missed the document at %d\n", threads,
+             (int) docs[i].offset);
+      failed = 1;
+      break;
+    }
+  }
+}
+
+int main(void) {
+  unsigned int threads;
+
+  /* big enough to be cut into many pieces */
+  build(60000);
+  delivered = (unsigned char *) malloc(ndocs);
+
+  for (threads = 1; threads <= 8 && !failed; threads *= 2) {
+    run(threads, yajl_parallel_ordered, yajl_tree_arena, 0);
+    run(threads, 0, yajl_tree_arena, 0);
+    run(threads, yajl_parallel_ordered, 0, 1000);
+    run(threads, 0, 0, 1000);
+  }
+  run(0, yajl_parallel_ordered, 0, 0);
+
+  /* a small text is one piece */
+  ndocs = textLen = 0;
+  build(12);
+  run(4, yajl_parallel_ordered, yajl_tree_hash_keys, 0);
+
+  ndocs = textLen = 0;
+  run(4, 0, 0, 0);
+
+  free(text);
+  free(docs);
+  free(delivered);
+  return failed;
+}
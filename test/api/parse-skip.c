@@ -0,0 +1,145 @@
+/* ensure that values skipped with yajl_skip_value() produce no callbacks,
+ * however the text is split into chunks */
+
+#include <yajl/yajl_parse.h>
+#include <stdio.h>
+#include <string.h>
+
+/* the values of keys named "skip" are skipped, as are the contents of
+ * maps and arrays which are the values of keys named "contents" */
+static yajl_handle hand;
+static char events[1024];
+static int inContents;
+
+static void add(const char * s, size_t len) {
+  size_t used = strlen(events);
+  if (used + len + 2 < sizeof(events)) {
+    memcpy(events + used, s, len);
+    events[used + len] = ' ';
+    events[used + len + 1] = 0;
+  }
+}
+
+static int on_null(void * ctx) { (void) ctx; add("null", 4); return 1; }
+
+static int on_boolean(void * ctx, int b) {
+  (void) ctx;
+  if (b) add("true", 4); else add("false", 5);
+  return 1;
+}
+
+static int on_number(void * ctx, const char * s, size_t l) {
+  (void) ctx; add(s, l); return 1;
+}
+
+static int on_string(void * ctx, const unsigned char * s, size_t l) {
+  char buf[64];
+  (void) ctx;
+  snprintf(buf, sizeof(buf), "\"%.*s\"", (int) l, (const char *) s);
+  add(buf, strlen(buf));
+  return 1;
+}
+
+static int on_start(void * ctx, const char * s) {
+  (void) ctx;
+  add(s, 1);
+  if (inContents) yajl_skip_value(hand);
+  inContents = 0;
+  return 1;
+}
+
+static int on_start_map(void * ctx) { return on_start(ctx, "{"); }
+static int on_start_array(void * ctx) { return on_start(ctx, "["); }
+static int on_end_map(void * ctx) { (void) ctx; add("}", 1); return 1; }
+static int on_end_array(void * ctx) { (void) ctx; add("]", 1); return 1; }
+
+static int on_map_key(void * ctx, const unsigned char * s, size_t l) {
+  char buf[64];
+  (void) ctx;
+  snprintf(buf, sizeof(buf), "%.*s:", (int) l, (const char *) s);
+  add(buf, strlen(buf));
+  inContents = (l == 8 && !memcmp(s, "contents", 8));
+  if (l == 4 && !memcmp(s, "skip", 4)) yajl_skip_value(hand);
+  return 1;
+}
+
+static yajl_callbacks callbacks = {
+  on_null, on_boolean, NULL, NULL, on_number, on_string,
+  on_start_map, on_map_key, on_end_map, on_start_array, on_end_array
+};
+
+static const struct {
+  const char * text;
+  int allowComments;
+  /* NULL if the text should fail to parse */
+  const char * events;
+} cases[] = {
+  { "{\"a\":1,\"skip\":{\"x\":[1,2,{\"y\":\"]}\\\"\\\\\"}],\"z\":\"\\u12\"},"
+    "\"b\":true}",
+    0, "{ a: 1 skip: b: true } " },
+  { "{\"contents\":{\"x\":1,\"y\":[2]},\"c\":\"d\"}",
+    0, "{ contents: { } c: \"d\" } " },
+  { "[{\"contents\":[1,[2,3],\"]\"]}, {\"contents\" : [ ] }]",
+    0, "[ { contents: [ ] } { contents: [ ] } ] " },
+  { "{\"skip\":123,\"skip\":\"str\",\"skip\":null,\"skip\":-1.5e3 ,\"e\":0}",
+    0, "{ skip: skip: skip: skip: e: 0 } " },
+  { "{\"skip\" :\t\"\xff invalid utf8\", \"skip\": [\"\\q\"]}",
+    0, "{ skip: skip: } " },
+  { "{\"skip\": /* } */ [1, // ]\n 2], \"f\": false, "
+    "\"contents\": { /* \" */ }, \"skip\": 3 /* end */}",
+    1, "{ skip: f: false contents: { } skip: } " },
+  { "{\"skip\":}", 0, NULL },
+  { "{\"skip\":[1,2", 0, NULL },
+  { "{\"skip\":\"open", 0, NULL },
+  { "{\"contents\":[1,2", 0, NULL },
+  { "{\"skip\":1 2}", 0, NULL }
+};
+
+/* parse in chunks of the given size, returning non-zero on success */
+static int parse(const char * text, int allowComments, size_t chunk,
+                 int buffer) {
+  size_t len = strlen(text), off;
+  yajl_status stat = yajl_status_ok;
+
+  events[0] = 0;
+  inContents = 0;
+  hand = yajl_alloc(&callbacks, NULL, NULL);
+  yajl_config(hand, yajl_allow_comments, allowComments);
+
+  if (buffer) {
+    stat = yajl_parse_buffer(hand, (const unsigned char *) text, len);
+  } else {
+    for (off = 0; off < len && stat == yajl_status_ok; off += chunk) {
+      stat = yajl_parse(hand, (const unsigned char *) text + off,
+                        off + chunk > len ? len - off : chunk);
+    }
+    if (stat == yajl_status_ok) stat = yajl_complete_parse(hand);
+  }
+
+  yajl_free(hand);
+  return stat == yajl_status_ok;
+}
+
+int main(void) {
+  size_t i, chunk;
+  int failed = 0;
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    /* the whole text at once, chunks of 1 to 6 bytes, and through
+     * yajl_parse_buffer() */
+    for (chunk = 0; chunk <= 7; chunk++) {
+      int ok = parse(cases[i].text, cases[i].allowComments,
+                     chunk ? chunk : strlen(cases[i].text), chunk == 7);
+
+      if (cases[i].events == NULL ? ok :
+          !ok || strcmp(events, cases[i].events))
+      {
+        printf("%s (chunk %d): got %s\n", cases[i].text, (int) chunk,
+               ok ? events : "an error");
+        failed = 1;
+      }
+    }
+  }
+
+  return failed;
+}
@@ -0,0 +1,155 @@
+/* ensure that a parse with a budget yields as it should, and that
+ * resuming it produces the same callbacks as an unbudgeted parse */
+
+#include <yajl/yajl_parse.h>
+#include <stdio.h>
+#include <string.h>
+
+static char events[2048];
+/* the handle being parsed with, for yajl_skip_value */
+static yajl_handle current;
+static int yields;
+
+static void add(const char * name, const unsigned char * s, size_t l) {
+  size_t used = strlen(events);
+  snprintf(events + used, sizeof(events) - used, "%s(%.*s) ", name, (int) l,
+           s ? (const char *) s : "");
+}
+
+static int on_null(void * ctx) {
+  (void) ctx; add("null", NULL, 0); return 1;
+}
+static int on_boolean(void * ctx, int b) {
+  (void) ctx; add(b ? "true" : "false", NULL, 0); return 1;
+}
+static int on_number(void * ctx, const char * s, size_t l) {
+  (void) ctx; add("number", (const unsigned char *) s, l); return 1;
+}
+static int on_string(void * ctx, const unsigned char * s, size_t l) {
+  (void) ctx; add("string", s, l); return 1;
+}
+static int on_map_key(void * ctx, const unsigned char * s, size_t l) {
+  (void) ctx; add("key", s, l);
+  /* skips are cut short by the budget too */
+  if (l && *s == 's') yajl_skip_value(current);
+  return 1;
+}
+static int on_start_map(void * ctx) { (void) ctx; add("{", NULL, 0); return 1; }
+static int on_end_map(void * ctx) { (void) ctx; add("}", NULL, 0); return 1; }
+static int on_start_array(void * ctx) {
+  (void) ctx; add("[", NULL, 0); return 1;
+}
+static int on_end_array(void * ctx) {
+  (void) ctx; add("]", NULL, 0); return 1;
+}
+
+static yajl_callbacks callbacks = {
+  on_null, on_boolean, NULL, NULL, on_number, on_string,
+  on_start_map, on_map_key, on_end_map, on_start_array, on_end_array
+};
+
+static const char * docs[] = {
+  "{\"a\":[1,-2.5e3,true,false,null,\"s\\u00e9\\n\"],\"b\":{},\"c\":[]}",
+  "  123  ",
+  "{\"skip\":[1,[2,{\"x\":\"]}\"}],3,   \"long long long\"],\"k\":\"v\"}",
+  "[\"0123456789012345678901234567890\",    12345678901234567890]",
+  "[1, 2",
+  "[1 2]",
+  "{\"a\":1}}",
+  NULL
+};
+
+/* parse text in chunks with the given budget, resuming whenever it
+ * yields, or all at once with yajl_parse_buffer when chunk is zero.
+ * returns the final status, with the offset of an error in *errorAt.
+ * sets *bad if a yield didn't make the progress it should have */
+static yajl_status parse(const char * text, size_t chunk, int budget,
+                         size_t * errorAt, int * bad) {
+  yajl_handle hand = yajl_alloc(&callbacks, NULL, NULL);
+  size_t len = strlen(text), off = 0;
+  yajl_status stat = yajl_status_ok;
+
+  current = hand;
+  events[0] = 0;
+  *errorAt = 0;
+  yajl_config(hand, yajl_yield_budget, budget);
+
+  do {
+    size_t n = chunk == 0 || off + chunk > len ? len - off : chunk;
+    size_t done = 0;
+
+    if (chunk == 0) {
+      stat = yajl_parse_buffer(hand, (const unsigned char *) text, len);
+    } else {
+      stat = yajl_parse(hand, (const unsigned char *) text + off, n);
+    }
+    while (stat == yajl_status_yield) {
+      size_t now = yajl_get_bytes_consumed(hand);
+      if (!budget || now < done + (size_t) budget || now >= n) *bad = 1;
+      done = now;
+      yields++;
+      stat = yajl_resume(hand);
+    }
+    if (stat == yajl_status_error) {
+      *errorAt = off + yajl_get_bytes_consumed(hand);
+    }
+    off += n;
+  } while (off < len && stat == yajl_status_ok);
+
+  if (chunk != 0 && stat == yajl_status_ok) stat = yajl_complete_parse(hand);
+  yajl_free(hand);
+  return stat;
+}
+
+int main(void) {
+  const char ** d;
+  char want[2048];
+  int failed = 0;
+
+  for (d = docs; *d; d++) {
+    size_t wantAt, at, chunk;
+    int budget, bad = 0;
+    yajl_status wantStat = parse(*d, 0, 0, &wantAt, &bad);
+
+    strcpy(want, events);
+    for (chunk = 0; chunk <= strlen(*d); chunk += chunk < 4 ? 1 : 16) {
+      for (budget = 1; budget <= 8; budget++) {
+        yajl_status stat;
+
+        yields = 0;
+        stat = parse(*d, chunk, budget, &at, &bad);
+        /* the whole text at once must have been split up, unless a
+         * token that runs into the end of it is what spent the budget */
+        if (chunk == 0 && strlen(*d) >= 2 * (size_t) budget && !yields) {
+          bad = 1;
+        }
+
+        if (stat != wantStat || strcmp(events, want) || bad ||
+            (stat == yajl_status_error && chunk == 0 && at != wantAt))
+        {
+          printf("%s (chunk %d, budget %d):\n  got  %s%s\n  want %s%s\n", *d,
+                 (int) chunk, budget, events, yajl_status_to_string(stat),
+                 want, yajl_status_to_string(wantStat));
+          failed = 1;
+          goto next;
+        }
+      }
+    }
+  next:
+    ;
+  }
+
+  /* a resume with nothing to resume is fine, a negative budget isn't */
+  {
+    yajl_handle hand = yajl_alloc(NULL, NULL, NULL);
+    if (yajl_resume(hand) != yajl_status_ok ||
+        yajl_config(hand, yajl_yield_budget, -1))
+    {
+      printf("yajl_resume or yajl_config misbehaved\n");
+      failed = 1;
+    }
+    yajl_free(hand);
+  }
+
+  return failed;
+}
@@ -0,0 +1,163 @@
+/* ensure that the reader produces the same events as the callbacks do,
+ * however the text is split into chunks */
+
+#include <yajl/yajl_reader.h>
+#include <yajl/yajl_parse.h>
+#include <stdio.h>
+#include <string.h>
+
+static char pushed[1024];
+
+static void add(char * log, size_t size, const char * name,
+                const unsigned char * s, size_t l) {
+  size_t used = strlen(log);
+  snprintf(log + used, size - used, "%s(%.*s) ", name, (int) l,
+           s ? (const char *) s : "");
+}
+
+#define ADD(name, s, l) add(pushed, sizeof(pushed), name, s, l)
+
+static int on_null(void * ctx) {
+  (void) ctx; ADD("null", (const unsigned char *) "null", 4); return 1;
+}
+static int on_boolean(void * ctx, int b) {
+  (void) ctx;
+  ADD("boolean", (const unsigned char *) (b ? "true" : "false"), b ? 4 : 5);
+  return 1;
+}
+static int on_number(void * ctx, const char * s, size_t l) {
+  (void) ctx; ADD("number", (const unsigned char *) s, l); return 1;
+}
+static int on_string(void * ctx, const unsigned char * s, size_t l) {
+  (void) ctx; ADD("string", s, l); return 1;
+}
+static int on_map_key(void * ctx, const unsigned char * s, size_t l) {
+  (void) ctx; ADD("key", s, l); return 1;
+}
+static int on_start_map(void * ctx) { (void) ctx; ADD("{", NULL, 0); return 1; }
+static int on_end_map(void * ctx) { (void) ctx; ADD("}", NULL, 0); return 1; }
+static int on_start_array(void * ctx) {
+  (void) ctx; ADD("[", NULL, 0); return 1;
+}
+static int on_end_array(void * ctx) {
+  (void) ctx; ADD("]", NULL, 0); return 1;
+}
+
+static yajl_callbacks callbacks = {
+  on_null, on_boolean, NULL, NULL, on_number, on_string,
+  on_start_map, on_map_key, on_end_map, on_start_array, on_end_array
+};
+
+static const char * names[] = {
+  "need_more", "end", "error", "null", "boolean", "number", "string", "key",
+  "{", "}", "[", "]"
+};
+
+static const char * docs[] = {
+  "{\"a\":[1,-2.5e3,true,false,null,\"s\\u00e9\\n\"],\"b\":{},\"c\":[]}",
+  "  123  ",
+  "\"top\"",
+  "[[[[]]],{\"x\":{\"y\":{\"z\":12345678901234567890}}}]",
+  "{\"k\\\"ey\" : \"v\\\\al\" , \"long\": \"0123456789012345678901234567890\"}",
+  "[1, 2",
+  "[1 2]",
+  "{\"a\":1}}",
+  NULL
+};
+
+/* read text in chunks of the given size, logging the events.  returns
+ * the last event */
+static yajl_event read_all(const char * text, size_t chunk, char * log,
+                           size_t size) {
+  yajl_reader r = yajl_reader_alloc(0, NULL);
+  size_t len = strlen(text), off = 0;
+  const unsigned char * v;
+  size_t l;
+  yajl_event e;
+
+  log[0] = 0;
+  for (;;) {
+    e = yajl_reader_next(r, &v, &l);
+    if (e == yajl_event_need_more) {
+      if (off < len) {
+        size_t n = off + chunk > len ? len - off : chunk;
+        yajl_reader_feed(r, (const unsigned char *) text + off, n);
+        off += n;
+      } else {
+        yajl_reader_finish(r);
+      }
+      continue;
+    }
+    if (e == yajl_event_end || e == yajl_event_error) break;
+    add(log, size, names[e], v, l);
+  }
+
+  if (e == yajl_event_error) {
+    unsigned char * str = yajl_reader_get_error(r, 1);
+    if (str == NULL) e = yajl_event_need_more;
+    yajl_reader_free_error(r, str);
+  }
+  yajl_reader_free(r);
+  return e;
+}
+
+int main(void) {
+  const char ** d;
+  char log[1024];
+  int failed = 0;
+
+  for (d = docs; *d; d++) {
+    yajl_handle h = yajl_alloc(&callbacks, NULL, NULL);
+    yajl_event want;
+    size_t chunk;
+
+    pushed[0] = 0;
+    want = (yajl_parse(h, (const unsigned char *) *d, strlen(*d)) ==
+            yajl_status_ok && yajl_complete_parse(h) == yajl_status_ok) ?
+      yajl_event_end : yajl_event_error;
+    yajl_free(h);
+
+    for (chunk = 1; chunk <= strlen(*d); chunk++) {
+      if (read_all(*d, chunk, log, sizeof(log)) != want ||
+          strcmp(log, pushed))
+      {
+        printf("%s (chunk %d):\n  read %s\n  want %s\n", *d, (int) chunk,
+               log, pushed);
+        failed = 1;
+        break;
+      }
+    }
+  }
+
+  /* skipping, and reading the same text fed all at once */
+  {
+    static const char * text =
+      "{\"a\":{\"b\":[1,2]},\"c\":[3,{\"d\":4}],\"e\":{\"f\":5},\"g\":6}";
+    yajl_reader r = yajl_reader_alloc(0, NULL);
+    const unsigned char * v;
+    size_t l;
+    yajl_event e;
+
+    log[0] = 0;
+    yajl_reader_feed(r, (const unsigned char *) text, strlen(text));
+    yajl_reader_finish(r);
+    while ((e = yajl_reader_next(r, &v, &l)) > yajl_event_error) {
+      add(log, sizeof(log), names[e], v, l);
+      if ((e == yajl_event_map_key && *v == 'a') ||
+          e == yajl_event_start_array)
+      {
+        yajl_reader_skip(r);
+      }
+    }
+    if (e != yajl_event_end ||
+        strcmp(log, "{() key(a) key(c) [() ]() key(e) {() key(f) number(5) "
+                    "}() key(g) number(6) }() "))
+    {
+      printf("skipping: read %s\n", log);
+      failed = 1;
+    }
+    yajl_reader_free(r);
+  }
+
+  return failed;
+}
@@ -0,0 +1,141 @@
+/* walk a tape alongside the tree of the same document and check they
+ * agree, then check lookups and errors */
+
+#include <yajl/yajl_tape.h>
+#include <yajl/yajl_tree.h>
+#include <yajl/yajl_parse.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static const char * doc =
+  "{\"a\": [1, -2, 3.5, 1e400, 9223372036854775808, true, false, null],"
+  " \"b\": {\"c\": {}, \"d\": [], \"\": \"empty key\"},"
+  " \"e\\u0000f\": \"embedded\\u0000null\","
+  " \"g\": [[[\"deep\"]], {\"h\": [1, {\"i\": 2}]}],"
+  " \"j\": \"last\"}";
+
+static int
+same(yajl_tape t, size_t v, yajl_val tv)
+{
+  size_t i, k, len;
+  const char * s;
+
+  if (yajl_tape_type(t, v) != tv->type) return 0;
+
+  switch (tv->type) {
+    case yajl_t_string:
+      /* strings written with \u0000 are cut short in the tree */
+      s = yajl_tape_get_string(t, v, &len);
+      return len >= strlen(tv->u.string) && !strcmp(s, tv->u.string);
+    case yajl_t_number:
+      if (yajl_tape_is_integer(t, v) != YAJL_IS_INTEGER(tv)) return 0;
+      if (YAJL_IS_INTEGER(tv) &&
+          yajl_tape_get_integer(t, v) != YAJL_GET_INTEGER(tv))
+      {
+        return 0;
+      }
+      return yajl_tape_get_double(t, v) == YAJL_GET_DOUBLE(tv);
+    case yajl_t_object:
+      if (yajl_tape_len(t, v) != tv->u.object.len) return 0;
+      for (i = 0, k = yajl_tape_first(t, v); k != YAJL_TAPE_NONE;
+           i++, k = yajl_tape_next(t, yajl_tape_next(t, k)))
+      {
+        s = yajl_tape_get_string(t, k, &len);
+        if (strcmp(s, tv->u.object.keys[i]) ||
+            !same(t, yajl_tape_next(t, k), tv->u.object.values[i]))
+        {
+          return 0;
+        }
+      }
+      return i == tv->u.object.len;
+    case yajl_t_array:
+      if (yajl_tape_len(t, v) != tv->u.array.len) return 0;
+      for (i = 0, k = yajl_tape_first(t, v); k != YAJL_TAPE_NONE;
+           i++, k = yajl_tape_next(t, k))
+      {
+        if (k != yajl_tape_array_get(t, v, i) ||
+            !same(t, k, tv->u.array.values[i]))
+        {
+          return 0;
+        }
+      }
+      return i == tv->u.array.len;
+    default:
+      return 1;
+  }
+}
+
+#define CHECK(cond) \
+  if (!(cond)) { printf("line %d: %s\n", __LINE__, #cond); failed = 1; }
+
+int main(void) {
+  yajl_val tree = yajl_tree_parse(doc, NULL, 0);
+  yajl_tape t = yajl_tape_parse((const unsigned char *) doc, strlen(doc), 0,
+                                NULL, NULL, 0);
+  size_t v, len;
+  const char * s;
+  char err[256];
+  int failed = 0;
+
+  CHECK(tree != NULL && t != NULL);
+  if (tree == NULL || t == NULL) return 1;
+
+  CHECK(same(t, 0, tree));
+  CHECK(yajl_tape_next(t, 0) == YAJL_TAPE_NONE);
+
+  /* lookups */
+  v = yajl_tape_object_get(t, 0, "j", 1);
+  CHECK(v != YAJL_TAPE_NONE && !strcmp(yajl_tape_get_string(t, v, NULL),
+                                       "last"));
+  CHECK(yajl_tape_object_get(t, 0, "jj", 2) == YAJL_TAPE_NONE);
+  CHECK(yajl_tape_object_get(t, 0, "ef", 2) == YAJL_TAPE_NONE);
+  v = yajl_tape_object_get(t, 0, "e\0f", 3);
+  s = yajl_tape_get_string(t, v, &len);
+  CHECK(s != NULL && len == 13 && !memcmp(s, "embedded\0null", 14));
+
+  v = yajl_tape_object_get(t, 0, "g", 1);
+  v = yajl_tape_array_get(t, v, 1);
+  v = yajl_tape_object_get(t, v, "h", 1);
+  v = yajl_tape_array_get(t, v, 1);
+  v = yajl_tape_object_get(t, v, "i", 1);
+  CHECK(yajl_tape_get_integer(t, v) == 2);
+
+  v = yajl_tape_object_get(t, 0, "a", 1);
+  CHECK(yajl_tape_array_get(t, v, 8) == YAJL_TAPE_NONE);
+  CHECK(yajl_tape_object_get(t, v, "a", 1) == YAJL_TAPE_NONE);
+  CHECK(yajl_tape_get_string(t, v, NULL) == NULL);
+
+  v = yajl_tape_object_get(t, 0, "b", 1);
+  v = yajl_tape_object_get(t, v, "c", 1);
+  CHECK(yajl_tape_type(t, v) == yajl_t_object);
+  CHECK(yajl_tape_len(t, v) == 0 && yajl_tape_first(t, v) == YAJL_TAPE_NONE);
+
+  CHECK(yajl_tape_type(t, YAJL_TAPE_NONE) == yajl_t_any);
+  CHECK(yajl_tape_next(t, YAJL_TAPE_NONE) == YAJL_TAPE_NONE);
+
+  yajl_tape_free(t);
+  yajl_tree_free(tree);
+
+  /* a scalar document */
+  t = yajl_tape_parse((const unsigned char *) "-12", 3, 0, NULL, NULL, 0);
+  CHECK(t != NULL && yajl_tape_get_integer(t, 0) == -12 &&
+        yajl_tape_first(t, 0) == YAJL_TAPE_NONE &&
+        yajl_tape_next(t, 0) == YAJL_TAPE_NONE);
+  yajl_tape_free(t);
+
+  /* errors and parse options */
+  t = yajl_tape_parse((const unsigned char *) "[1, 2", 5, 0,
+                      NULL, err, sizeof(err));
+  CHECK(t == NULL && err[0] != 0);
+  t = yajl_tape_parse((const unsigned char *) "[1 /* two */]", 13, 0,
+                      NULL, err, sizeof(err));
+  CHECK(t == NULL && strstr(err, "comments") != NULL);
+  t = yajl_tape_parse((const unsigned char *) "[1 /* two */]", 13,
+                      yajl_allow_comments, NULL, err, sizeof(err));
+  CHECK(t != NULL && yajl_tape_len(t, 0) == 1);
+  yajl_tape_free(t);
+  yajl_tape_free(NULL);
+
+  return failed;
+}
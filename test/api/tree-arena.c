@@ -0,0 +1,120 @@
+/* ensure that trees allocated from an arena look just like those
+ * allocated on the heap, and are freed along with their root */
+
+#include <yajl/yajl_tree.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * docs[] = {
+  "{\"a\": [1, 2.5, \"three\", true, false, null], \"b\": {\"c\": {}},"
+  " \"d\": [[], [[]], {\"e\": \"\\u00e9\"}], \"\": -12345678901234567890}",
+  "\"just a string\"",
+  "42",
+  "[]",
+  NULL
+};
+
+static const char * bad[] = {
+  "{\"a\": [1, 2, {\"b\": ", "[1, 2] 3", "{\"a\" 1}",
+  "[[[1, 2, 3], {\"x\": [4, 5], \"y\": {\"z\": \"6\"", NULL
+};
+
+static int same(yajl_val a, yajl_val b) {
+  size_t i;
+
+  if (a->type != b->type) return 0;
+  switch (a->type) {
+    case yajl_t_string:
+      return !strcmp(a->u.string, b->u.string);
+    case yajl_t_number:
+      return !strcmp(a->u.number.r, b->u.number.r) &&
+        a->u.number.flags == b->u.number.flags &&
+        (!YAJL_IS_INTEGER(a) || a->u.number.i == b->u.number.i) &&
+        (!YAJL_IS_DOUBLE(a) || a->u.number.d == b->u.number.d);
+    case yajl_t_object:
+      if (a->u.object.len != b->u.object.len) return 0;
+      for (i = 0; i < a->u.object.len; i++) {
+        if (strcmp(a->u.object.keys[i], b->u.object.keys[i]) ||
+            !same(a->u.object.values[i], b->u.object.values[i]))
+          return 0;
+      }
+      return 1;
+    case yajl_t_array:
+      if (a->u.array.len != b->u.array.len) return 0;
+      for (i = 0; i < a->u.array.len; i++) {
+        if (!same(a->u.array.values[i], b->u.array.values[i])) return 0;
+      }
+      return 1;
+    default:
+      return 1;
+  }
+}
+
+static int check(const char * doc) {
+  yajl_val heap = yajl_tree_parse(doc, NULL, 0);
+  yajl_val arena = yajl_tree_parse_options(doc, yajl_tree_arena, NULL, 0);
+  int ok = heap != NULL && arena != NULL && same(heap, arena);
+
+  if (!ok) printf("%.40s: arena tree differs\n", doc);
+
+  yajl_tree_free(heap);
+  yajl_tree_free_root(arena);
+  return ok;
+}
+
+int main(void) {
+  const char ** d;
+  char err[128];
+  char * big;
+  size_t i, len = 0;
+  int failed = 0;
+
+  for (d = docs; *d; d++) failed |= !check(*d);
+
+  /* enough values to need several blocks, and arrays and objects which
+   * grow well past their first allocation */
+  big = malloc(200000);
+  len += sprintf(big + len, "[");
+  for (i = 0; i < 5000; i++)
+    len += sprintf(big + len, "%s{\"k%u\": [%u, \"s%u\"]}", i ? "," : "",
+                   (unsigned) i, (unsigned) i, (unsigned) i);
+  len += sprintf(big + len, ",{");
+  for (i = 0; i < 5000; i++)
+    len += sprintf(big + len, "%s\"%u\": %u", i ? "," : "",
+                   (unsigned) i, (unsigned) i);
+  sprintf(big + len, "}]");
+  failed |= !check(big);
+  free(big);
+
+  /* whatever was built before the error is freed, in either mode */
+  for (d = bad; *d; d++) {
+    if (yajl_tree_parse_options(*d, 0, err, sizeof(err)) || !*err ||
+        yajl_tree_parse_options(*d, yajl_tree_arena, err, sizeof(err)) ||
+        !*err)
+    {
+      printf("%s: expected an error\n", *d);
+      failed = 1;
+    }
+  }
+
+  /* values built by hand are still freed with free(), whatever lies in
+   * the members they don't use */
+  {
+    yajl_val a = malloc(sizeof(*a));
+    yajl_val s = malloc(sizeof(*s));
+    memset(a, 0xa5, sizeof(*a));
+    memset(s, 0xa5, sizeof(*s));
+    a->type = yajl_t_array;
+    a->u.array.values = malloc(sizeof(yajl_val));
+    a->u.array.values[0] = s;
+    a->u.array.len = 1;
+    s->type = yajl_t_string;
+    s->u.string = malloc(4);
+    strcpy(s->u.string, "abc");
+    yajl_tree_free(a);
+  }
+
+  return failed;
+}
@@ -0,0 +1,126 @@
+/* ensure that objects with a hash table over their keys find the same
+ * values as a linear scan would */
+
+#include <yajl/yajl_tree.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* an object of n keys "k0", "k1", ... whose values are their positions
+ * plus one, followed by a duplicate of "k0" and keys sharing prefixes */
+static char * make_object(int n) {
+  char * text = malloc(32 * n + 64);
+  size_t len = 0;
+  int i;
+
+  len += sprintf(text + len, "{");
+  for (i = 0; i < n; i++)
+    len += sprintf(text + len, "\"k%d\": %d, ", i, i + 1);
+  sprintf(text + len, "\"k0\": -1, \"\": -2, \"k\": -3, \"k00\": -4}");
+  return text;
+}
+
+/* expect is the value of key, or zero if it isn't there */
+static int check(yajl_val obj, const char * key, long long expect) {
+  const char * path[] = { NULL, NULL };
+  size_t len = strlen(key);
+  yajl_val a, b;
+
+  path[0] = key;
+  a = yajl_tree_get(obj, path, yajl_t_number);
+  b = yajl_tree_object_get(obj, key, len, yajl_tree_key_hash(key, len));
+
+  if (a != b || (a == NULL) != (expect == 0) ||
+      (a != NULL && YAJL_GET_INTEGER(a) != expect))
+  {
+    printf("\"%s\": expected %lld\n", key, expect);
+    return 1;
+  }
+  return 0;
+}
+
+int main(void) {
+  static const int sizes[] = { 0, 3, YAJL_TREE_HASH_MIN - 5,
+                               YAJL_TREE_HASH_MIN, 100, 1000 };
+  static const unsigned int options[] = {
+    0, yajl_tree_hash_keys, yajl_tree_hash_keys | yajl_tree_arena
+  };
+  char key[32];
+  int failed = 0;
+  size_t s, o;
+  int i;
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    char * text = make_object(sizes[s]);
+
+    for (o = 0; o < sizeof(options) / sizeof(options[0]); o++) {
+      yajl_val obj = yajl_tree_parse_options(text, options[o], NULL, 0);
+      int n = sizes[s];
+
+      if (!YAJL_IS_OBJECT(obj)) {
+        printf("%d keys, options %u: not an object\n", n, options[o]);
+        failed = 1;
+        continue;
+      }
+
+      /* "k0" is at position 0 and its duplicate at n, the first wins */
+      failed |= check(obj, "k0", n > 0 ? 1 : -1);
+      for (i = 1; i < n; i++) {
+        sprintf(key, "k%d", i);
+        failed |= check(obj, key, i + 1);
+      }
+      failed |= check(obj, "", -2);
+      failed |= check(obj, "k", -3);
+      failed |= check(obj, "k00", -4);
+      sprintf(key, "k%d", n + 1);
+      failed |= check(obj, key, 0);
+      failed |= check(obj, "k0 ", 0);
+
+      /* keys needn't be null terminated */
+      if (yajl_tree_object_get(obj, "k00", 2, yajl_tree_key_hash("k0", 2)) !=
+          yajl_tree_object_get(obj, "k0", 2, yajl_tree_key_hash("k0", 2)))
+      {
+        printf("%d keys: lookup read past the key length\n", n);
+        failed = 1;
+      }
+      /* nor do they end at a NUL */
+      if (yajl_tree_object_get(obj, "k\0b", 3,
+                               yajl_tree_key_hash("k\0b", 3)) != NULL)
+      {
+        printf("%d keys: lookup stopped at a NUL\n", n);
+        failed = 1;
+      }
+
+      if (options[o] & yajl_tree_arena) yajl_tree_free_root(obj);
+      else yajl_tree_free(obj);
+    }
+    free(text);
+  }
+
+  /* objects built by hand have no hash table, and are scanned */
+  {
+    static const char * keys[] = { "a", "b" };
+    struct yajl_val_s vals[2], obj;
+    yajl_val values[2];
+    const char * path[] = { "b", NULL };
+
+    memset(vals, 0, sizeof(vals));
+    memset(&obj, 0, sizeof(obj));
+    vals[0].type = vals[1].type = yajl_t_null;
+    values[0] = &vals[0];
+    values[1] = &vals[1];
+    obj.type = yajl_t_object;
+    obj.u.object.keys = keys;
+    obj.u.object.values = values;
+    obj.u.object.len = 2;
+    if (yajl_tree_object_get(&obj, "b", 1, yajl_tree_key_hash("b", 1)) !=
+        &vals[1] || yajl_tree_get(&obj, path, yajl_t_null) != &vals[1])
+    {
+      printf("hand built object: lookup failed\n");
+      failed = 1;
+    }
+  }
+
+  return failed;
+}
@@ -0,0 +1,130 @@
+/* ensure that trees parsed in place look just like those parsed from a
+ * copy, and that their strings and keys live in the input */
+
+#include <yajl/yajl_tree.h>
+#include <yajl/yajl_parse.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * docs[] = {
+  "{\"a\": [1, 2.5, \"three\", true, false, null], \"b\": {\"c\": {}},"
+  " \"\": \"\", \"d\": [[], [[]], {\"e\": \"\\u00e9\"}]}",
+  "{\"esc\\\"aped\": \"tab\\there\\\\ \\/ \\n\", \"\\u00e9\\u00e8\": "
+  "\"\\ud83d\\ude00 \\u4e2d\\u6587 \\\"\", \"plain\": \"\xe4\xb8\xad\"}",
+  "\"just a string\"",
+  "\"\\u0041\\u0042\\u0043\"",
+  "[\"\", \"\\\\\", \"\\\"\", \"x\"]",
+  NULL
+};
+
+static const char * bad[] = {
+  "{\"a\": [\"b\", {\"c\": \"d\"", "[\"a\", \"b\"] \"c\"", "{\"a\" \"b\"}",
+  NULL
+};
+
+static int same(yajl_val a, yajl_val b) {
+  size_t i;
+
+  if (a->type != b->type) return 0;
+  switch (a->type) {
+    case yajl_t_string:
+      return !strcmp(a->u.string, b->u.string);
+    case yajl_t_number:
+      return !strcmp(a->u.number.r, b->u.number.r);
+    case yajl_t_object:
+      if (a->u.object.len != b->u.object.len) return 0;
+      for (i = 0; i < a->u.object.len; i++) {
+        if (strcmp(a->u.object.keys[i], b->u.object.keys[i]) ||
+            !same(a->u.object.values[i], b->u.object.values[i]))
+          return 0;
+      }
+      return 1;
+    case yajl_t_array:
+      if (a->u.array.len != b->u.array.len) return 0;
+      for (i = 0; i < a->u.array.len; i++) {
+        if (!same(a->u.array.values[i], b->u.array.values[i])) return 0;
+      }
+      return 1;
+    default:
+      return 1;
+  }
+}
+
+static int inside(const char * s, const unsigned char * buf, size_t len) {
+  return (const unsigned char *) s >= buf &&
+    (const unsigned char *) s + strlen(s) < buf + len;
+}
+
+/* are all strings and keys of v inside buf? */
+static int in_place(yajl_val v, const unsigned char * buf, size_t len) {
+  size_t i;
+
+  switch (v->type) {
+    case yajl_t_string:
+      return inside(v->u.string, buf, len);
+    case yajl_t_object:
+      for (i = 0; i < v->u.object.len; i++) {
+        if (!inside(v->u.object.keys[i], buf, len) ||
+            !in_place(v->u.object.values[i], buf, len))
+          return 0;
+      }
+      return 1;
+    case yajl_t_array:
+      for (i = 0; i < v->u.array.len; i++) {
+        if (!in_place(v->u.array.values[i], buf, len)) return 0;
+      }
+      return 1;
+    default:
+      return 1;
+  }
+}
+
+int main(void) {
+  unsigned int options[] = { 0, yajl_tree_arena };
+  unsigned char buf[256];
+  char err[256];
+  const char ** d;
+  int failed = 0;
+  size_t i, len;
+
+  for (d = docs; *d; d++) {
+    for (i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+      yajl_val copied, insitu;
+
+      len = strlen(*d);
+      memcpy(buf, *d, len);
+      copied = yajl_tree_parse_buf(buf, len, options[i], 0, NULL,
+                                   err, sizeof(err));
+      insitu = yajl_tree_parse_insitu(buf, len, options[i], 0, NULL,
+                                      err, sizeof(err));
+
+      if (copied == NULL || insitu == NULL || !same(copied, insitu) ||
+          !in_place(insitu, buf, len))
+      {
+        printf("%.40s: in situ tree differs\n", *d);
+        failed = 1;
+      }
+      if (options[i] & yajl_tree_arena) yajl_tree_free_root(copied);
+      else yajl_tree_free(copied);
+      yajl_tree_free_root(insitu);
+    }
+  }
+
+  /* whatever was built before the error is freed, in either mode */
+  for (d = bad; *d; d++) {
+    for (i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+      len = strlen(*d);
+      memcpy(buf, *d, len);
+      if (yajl_tree_parse_insitu(buf, len, options[i], 0, NULL,
+                                 err, sizeof(err)) || !*err)
+      {
+        printf("%s: expected an error\n", *d);
+        failed = 1;
+      }
+    }
+  }
+
+  return failed;
+}
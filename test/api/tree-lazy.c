@@ -0,0 +1,85 @@
+/* ensure that numbers converted lazily end up just like those converted
+ * while parsing */
+
+#include <yajl/yajl_tree.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * doc =
+  "[0, -0, 1, -1, 42, 1.5, -2.25e-3, 1E3, 9223372036854775807,"
+  " -9223372036854775808, 9223372036854775808, -9223372036854775809,"
+  " 1e400, -1e400, 1e-400, 123456789012345678901234567890, 0.1]";
+
+int main(void) {
+  yajl_val eager = yajl_tree_parse(doc, NULL, 0);
+  yajl_val lazy = yajl_tree_parse_options(doc, yajl_tree_lazy_numbers,
+                                          NULL, 0);
+  int failed = 0;
+  size_t i;
+
+  if (!YAJL_IS_ARRAY(eager) || !YAJL_IS_ARRAY(lazy)) {
+    printf("parse failed\n");
+    return 1;
+  }
+
+  for (i = 0; i < lazy->u.array.len; i++) {
+    yajl_val a = eager->u.array.values[i];
+    yajl_val b = lazy->u.array.values[i];
+    long long ai = 0, bi = 0;
+    double ad = 0, bd = 0;
+    int aiv, biv, adv, bdv;
+
+    /* until it's asked for, there's nothing to see, and looking through
+     * the macros changes nothing */
+    if (b->u.number.flags != 0 || YAJL_IS_INTEGER(b) || YAJL_IS_DOUBLE(b) ||
+        b->u.number.flags != 0)
+    {
+      printf("%s: converted while parsing\n", b->u.number.r);
+      failed = 1;
+    }
+
+    /* converting leaves errno alone */
+    errno = EINTR;
+    aiv = yajl_tree_get_integer(a, &ai);
+    biv = yajl_tree_get_integer(b, &bi);
+    adv = yajl_tree_get_double(a, &ad);
+    bdv = yajl_tree_get_double(b, &bd);
+    if (aiv != biv || ai != bi || adv != bdv ||
+        memcmp(&ad, &bd, sizeof(double)) ||
+        aiv != YAJL_IS_INTEGER(a) || adv != YAJL_IS_DOUBLE(a) ||
+        a->u.number.flags != b->u.number.flags ||
+        errno != EINTR)
+    {
+      printf("%s: converted differently\n", b->u.number.r);
+      failed = 1;
+    }
+
+    /* the conversion is kept for the macros */
+    if (YAJL_IS_INTEGER(b) != biv || YAJL_IS_DOUBLE(b) != bdv ||
+        (biv && YAJL_GET_INTEGER(b) != bi) ||
+        (bdv && memcmp(&YAJL_GET_DOUBLE(b), &bd, sizeof(double))))
+    {
+      printf("%s: conversion not kept\n", b->u.number.r);
+      failed = 1;
+    }
+
+    /* one which converts to nothing valid isn't written to */
+    if (b->u.number.flags == 0 && (b->u.number.i != 0 || b->u.number.d != 0)) {
+      printf("%s: written to without a valid value\n", b->u.number.r);
+      failed = 1;
+    }
+  }
+
+  if (yajl_tree_get_integer(lazy, NULL) || yajl_tree_get_double(NULL, NULL)) {
+    printf("converted something other than a number\n");
+    failed = 1;
+  }
+
+  yajl_tree_free(eager);
+  yajl_tree_free(lazy);
+
+  return failed;
+}
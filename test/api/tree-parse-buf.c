@@ -0,0 +1,115 @@
+/* parse documents lying inside larger buffers, and check that trees built
+ * with caller supplied allocation functions give back all they took */
+
+#include <yajl/yajl_tree.h>
+#include <yajl/yajl_parse.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static long outstanding;
+
+static void * count_malloc(void * ctx, size_t sz) {
+  (void) ctx;
+  outstanding++;
+  return malloc(sz);
+}
+
+static void * count_realloc(void * ctx, void * ptr, size_t sz) {
+  (void) ctx;
+  if (ptr == NULL) outstanding++;
+  return realloc(ptr, sz);
+}
+
+static void count_free(void * ctx, void * ptr) {
+  (void) ctx;
+  if (ptr != NULL) outstanding--;
+  free(ptr);
+}
+
+static yajl_alloc_funcs counting = {
+  count_malloc, count_realloc, count_free, NULL
+};
+
+/* three documents back to back, none of them terminated */
+static const char frames[] =
+  "{\"id\": 1, \"tags\": [\"a\", \"b\"]}"
+  "[1, 2.5, {\"x\": null}]"
+  "\"tail\"";
+
+static int check(const char * what, int ok) {
+  if (!ok) printf("%s: failed\n", what);
+  return !ok;
+}
+
+int main(void) {
+  const unsigned char * buf = (const unsigned char *) frames;
+  unsigned int options[] = { 0, yajl_tree_arena };
+  const char * path[] = { "tags", NULL };
+  char err[256];
+  int failed = 0;
+  yajl_val v;
+  size_t i;
+
+  for (i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+    v = yajl_tree_parse_buf(buf, 29, options[i], 0, &counting,
+                            err, sizeof(err));
+    failed |= check("first frame", v != NULL &&
+                    YAJL_IS_ARRAY(yajl_tree_get(v, path, yajl_t_array)) &&
+                    YAJL_GET_ARRAY(yajl_tree_get(v, path, yajl_t_any))
+                        ->len == 2);
+    yajl_tree_free_root(v);
+    failed |= check("first frame freed", outstanding == 0);
+
+    v = yajl_tree_parse_buf(buf + 29, 21, options[i], 0, &counting,
+                            err, sizeof(err));
+    failed |= check("second frame", YAJL_IS_ARRAY(v) &&
+                    YAJL_GET_ARRAY(v)->len == 3);
+    yajl_tree_free_root(v);
+
+    v = yajl_tree_parse_buf(buf + 50, 6, options[i], 0, &counting,
+                            err, sizeof(err));
+    failed |= check("third frame", YAJL_IS_STRING(v) &&
+                    !strcmp(v->u.string, "tail"));
+    yajl_tree_free_root(v);
+    failed |= check("all frames freed", outstanding == 0);
+
+    /* the rest of the buffer is an error, unless asked to ignore it */
+    v = yajl_tree_parse_buf(buf, sizeof(frames) - 1, options[i], 0,
+                            &counting, err, sizeof(err));
+    failed |= check("trailing garbage", v == NULL && *err);
+    failed |= check("trailing garbage freed", outstanding == 0);
+
+    v = yajl_tree_parse_buf(buf, sizeof(frames) - 1, options[i],
+                            yajl_allow_trailing_garbage, &counting,
+                            err, sizeof(err));
+    failed |= check("allowed trailing garbage", YAJL_IS_OBJECT(v));
+    yajl_tree_free_root(v);
+
+    /* half a document fails and leaves nothing behind */
+    v = yajl_tree_parse_buf(buf, 20, options[i], 0, &counting,
+                            err, sizeof(err));
+    failed |= check("truncated frame", v == NULL && *err);
+    failed |= check("truncated frame freed", outstanding == 0);
+  }
+
+  /* comments and invalid utf8 only when asked for */
+  v = yajl_tree_parse_buf((const unsigned char *) "/* c */ 1", 9, 0, 0,
+                          NULL, err, sizeof(err));
+  failed |= check("comment rejected", v == NULL);
+  v = yajl_tree_parse_buf((const unsigned char *) "/* c */ 1", 9, 0,
+                          yajl_allow_comments, NULL, err, sizeof(err));
+  failed |= check("comment allowed", YAJL_IS_NUMBER(v));
+  yajl_tree_free(v);
+
+  v = yajl_tree_parse_buf((const unsigned char *) "\"\xff\"", 3, 0, 0,
+                          NULL, err, sizeof(err));
+  failed |= check("bad utf8 rejected", v == NULL);
+  v = yajl_tree_parse_buf((const unsigned char *) "\"\xff\"", 3, 0,
+                          yajl_dont_validate_strings, NULL, err, sizeof(err));
+  failed |= check("bad utf8 allowed", YAJL_IS_STRING(v));
+  yajl_tree_free(v);
+
+  return failed;
+}
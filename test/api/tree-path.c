@@ -0,0 +1,96 @@
+/* evaluate compiled JSON Pointers, starting with the examples of RFC 6901
+ * section 5 */
+
+#include <yajl/yajl_tree.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * doc =
+  "{\"foo\": [\"bar\", \"baz\"], \"\": 0, \"a/b\": 1, \"c%d\": 2, \"e^f\": 3,"
+  " \"g|h\": 4, \"i\\\\j\": 5, \"k\\\"l\": 6, \" \": 7, \"m~n\": 8,"
+  " \"01\": 9, \"nested\": {\"list\": [10, [11, {\"x\": 12}]]}}";
+
+static const struct {
+  const char * pointer;
+  long long value; /* -1 when the pointer refers to nothing */
+} cases[] = {
+  { "/", 0 }, { "/a~1b", 1 }, { "/c%d", 2 }, { "/e^f", 3 }, { "/g|h", 4 },
+  { "/i\\j", 5 }, { "/k\"l", 6 }, { "/ ", 7 }, { "/m~0n", 8 },
+  { "/01", 9 },
+  { "/nested/list/0", 10 }, { "/nested/list/1/0", 11 },
+  { "/nested/list/1/1/x", 12 },
+  /* array indices are decimal, with no leading zeros or signs */
+  { "/nested/list/00", -1 }, { "/nested/list/-", -1 },
+  { "/nested/list/+1", -1 }, { "/nested/list/2", -1 },
+  { "/nested/list/99999999999999999999999", -1 },
+  { "/foo/0/x", -1 }, { "/missing", -1 }, { "/m~1n", -1 }, { "//", -1 },
+  { NULL, 0 }
+};
+
+static const char * invalid[] = { "foo", "/~", "/a~2b", "/a~", NULL };
+
+int main(void) {
+  unsigned int options[] = { 0, yajl_tree_hash_keys };
+  char err[256];
+  int failed = 0;
+  size_t o;
+  int i;
+
+  for (o = 0; o < sizeof(options) / sizeof(options[0]); o++) {
+    yajl_val root = yajl_tree_parse_options(doc, options[o], err, sizeof(err));
+    yajl_path path;
+    yajl_val v;
+
+    if (root == NULL) {
+      printf("parse error: %s\n", err);
+      return 1;
+    }
+
+    path = yajl_path_compile("", NULL, 0);
+    if (yajl_tree_get_compiled(root, path, yajl_t_object) != root) {
+      printf("\"\": expected the whole document\n");
+      failed = 1;
+    }
+    yajl_path_free(path);
+
+    path = yajl_path_compile("/foo/1", NULL, 0);
+    v = yajl_tree_get_compiled(root, path, yajl_t_string);
+    if (v == NULL || strcmp(v->u.string, "baz") ||
+        yajl_tree_get_compiled(root, path, yajl_t_number) != NULL)
+    {
+      printf("/foo/1: expected \"baz\"\n");
+      failed = 1;
+    }
+    yajl_path_free(path);
+
+    for (i = 0; cases[i].pointer; i++) {
+      path = yajl_path_compile(cases[i].pointer, err, sizeof(err));
+      if (path == NULL) {
+        printf("%s: %s\n", cases[i].pointer, err);
+        failed = 1;
+        continue;
+      }
+      v = yajl_tree_get_compiled(root, path, yajl_t_any);
+      if (cases[i].value < 0 ? v != NULL
+          : !YAJL_IS_INTEGER(v) || YAJL_GET_INTEGER(v) != cases[i].value)
+      {
+        printf("%s: expected %lld\n", cases[i].pointer, cases[i].value);
+        failed = 1;
+      }
+      yajl_path_free(path);
+    }
+
+    yajl_tree_free(root);
+  }
+
+  for (i = 0; invalid[i]; i++) {
+    if (yajl_path_compile(invalid[i], err, sizeof(err)) != NULL || !*err) {
+      printf("%s: expected an error\n", invalid[i]);
+      failed = 1;
+    }
+  }
+
+  return failed;
+}
@@ -69,9 +69,7 @@ for file in cases/*.json ; do
   while [ $iter -lt 32  ] && [ $success = "SUCCESS" ] ; do
     $testBin $allowPartials $allowComments $allowGarbage $allowMultiple -b $iter < $file > ${file}.test  2>&1
     diff ${DIFF_FLAGS} ${file}.gold ${file}.test > ${file}.out
-    if [ $? -eq 0 ] ; then
-      if [ $iter -eq 31 ] ; then testsSucceeded=$(( $testsSucceeded + 1 )) ; fi
-    else
+    if [ $? -ne 0 ] ; then
       success="FAILURE"
       iter=32
       ${ECHO}
@@ -81,6 +79,20 @@ for file in cases/*.json ; do
     rm ${file}.test ${file}.out
   done
 
+  # and once more, handing the whole input to yajl_parse_buffer
+  if [ $success = "SUCCESS" ] ; then
+    $testBin $allowPartials $allowComments $allowGarbage $allowMultiple -w < $file > ${file}.test  2>&1
+    diff ${DIFF_FLAGS} ${file}.gold ${file}.test > ${file}.out
+    if [ $? -eq 0 ] ; then
+      testsSucceeded=$(( $testsSucceeded + 1 ))
+    else
+      success="FAILURE"
+      ${ECHO}
+      cat ${file}.out
+    fi
+    rm ${file}.test ${file}.out
+  fi
+
   ${ECHO} $success
   testsTotal=$(( testsTotal + 1 ))
 done
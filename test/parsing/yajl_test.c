@@ -159,7 +159,8 @@ static void usage(const char * progname)
             "   -g  allow *g*arbage after valid JSON text\n"
             "   -m  allows the parser to consume multiple JSON values\n"
             "       from a single string separated by whitespace\n"
-            "   -p  partial JSON documents should not cause errors\n",
+            "   -p  partial JSON documents should not cause errors\n"
+            "   -w  read all input, then parse it with yajl_parse_buffer\n",
             progname);
     exit(1);
 }
@@ -175,6 +176,7 @@ main(int argc, char ** argv)
     yajl_status stat;
     size_t rd;
     int i, j;
+    int wholeBuffer = 0;
 
     /* memory allocation debugging: allocate a structure which collects
      * statistics */
@@ -220,6 +222,8 @@ main(int argc, char ** argv)
             yajl_config(hand, yajl_allow_multiple_values, 1);
         } else if (!strcmp("-p", argv[i])) {
             yajl_config(hand, yajl_allow_partial_values, 1);
+        } else if (!strcmp("-w", argv[i])) {
+            wholeBuffer = 1;
         } else {
             fileName = argv[i];
             break;
@@ -244,22 +248,39 @@ main(int argc, char ** argv)
     {
         file = stdin;
     }
-    for (;;) {
-        rd = fread((void *) fileData, 1, bufSize, file);
-
-        if (rd == 0) {
-            if (!feof(stdin)) {
-                fprintf(stderr, "error reading from '%s'\n", fileName);
+    if (wholeBuffer) {
+        /* slurp everything, growing the buffer as needed */
+        size_t len = 0;
+        while ((rd = fread((void *) (fileData + len), 1, bufSize - len,
+                           file)) > 0)
+        {
+            len += rd;
+            if (len == bufSize) {
+                bufSize *= 2;
+                fileData = (unsigned char *) realloc(fileData, bufSize);
             }
-            break;
         }
-        /* read file data, now pass to parser */
-        stat = yajl_parse(hand, fileData, rd);
+        rd = len;
+        stat = yajl_parse_buffer(hand, fileData, rd);
+    } else {
+        for (;;) {
+            rd = fread((void *) fileData, 1, bufSize, file);
+
+            if (rd == 0) {
+                if (!feof(stdin)) {
+                    fprintf(stderr, "error reading from '%s'\n", fileName);
+                }
+                break;
+            }
+            /* read file data, now pass to parser */
+            stat = yajl_parse(hand, fileData, rd);
+
+            if (stat != yajl_status_ok) break;
+        }
 
-        if (stat != yajl_status_ok) break;
+        stat = yajl_complete_parse(hand);
     }
 
-    stat = yajl_complete_parse(hand);
     if (stat != yajl_status_ok)
     {
         unsigned char * str = yajl_get_error(hand, 0, fileData, rd);